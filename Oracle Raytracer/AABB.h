@@ -2,21 +2,27 @@
 // Assuming "point3.h" and "ray.h" (which would include "vec3.h") are also included elsewhere or via "Interval.h"
 // For point3 and ray definitions. For clarity, explicit includes are better if not transitive.
 // #include "point3.h"
-// #include "ray.h"
+// #include "Ray.h"
 
 #ifndef AABB_H
 #define AABB_H
 
-class aabb {
+template <typename T>
+class aabb_t {
 public:
+    using interval = interval_t<T>;
+    using point3 = vec3_t<T>;
+    using vec3 = vec3_t<T>;
+    using ray = ray_t<T>;
+
     interval x, y, z;
 
-    aabb() {} // The default AABB is empty, since intervals are empty by default.
+    constexpr aabb_t() {} // The default AABB is empty, since intervals are empty by default.
 
-    aabb(const interval& x, const interval& y, const interval& z)
+    constexpr aabb_t(const interval& x, const interval& y, const interval& z)
         : x(x), y(y), z(z) {}
 
-    aabb(const point3& a, const point3& b) {
+    aabb_t(const point3& a, const point3& b) {
         // Treat the two points a and b as extrema for the bounding box, so we don't require a
         // particular minimum/maximum coordinate order.
 
@@ -26,12 +32,8 @@ public:
         z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
     }
 
-    aabb(const aabb& box0, const aabb& box1) {
-        // Assuming interval has a constructor that takes two other intervals to form a surrounding interval
-        x = interval(box0.x, box1.x);
-        y = interval(box0.y, box1.y);
-        z = interval(box0.z, box1.z);
-    }
+    constexpr aabb_t(const aabb_t& box0, const aabb_t& box1)
+        : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z) {}
 
     const interval& axis_interval(int n) const {
         if (n == 1) return y;
@@ -47,7 +49,7 @@ public:
             const interval& ax = axis_interval(axis);
             // Assuming ray_dir components are accessible via operator[]
             // Assuming interval members 'min' and 'max' are public or have accessors
-            const double adinv = 1.0 / ray_dir[axis];
+            const T adinv = T(1) / ray_dir[axis];
 
             // Using ax.min and ax.max, which are used in your original code's hit function.
             // This implies 'min' and 'max' are accessible members of the interval class.
@@ -69,14 +71,42 @@ public:
         return true;
     }
 
+    bool hit(const point3& ray_orig, const vec3& inv_dir, interval ray_t) const {
+        // Slab test with the reciprocal ray direction precomputed by the caller, for traversals
+        // that test the same ray against many boxes.
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& ax = axis_interval(axis);
+            auto t0 = (ax.min - ray_orig[axis]) * inv_dir[axis];
+            auto t1 = (ax.max - ray_orig[axis]) * inv_dir[axis];
+            if (t0 > t1) std::swap(t0, t1);
+
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+    double surface_area() const {
+        // Surface area of the box, used by the SAH builder. An empty box has zero area.
+        double dx = x.max - x.min;
+        double dy = y.max - y.min;
+        double dz = z.max - z.min;
+        if (dx < 0 || dy < 0 || dz < 0)
+            return 0;
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
     int longest_axis() const {
         // Returns the index of the longest axis of the bounding box.
         // Assuming interval has public members 'min' and 'max' to calculate its length.
         // The error E0135 indicates 'interval' has no member 'size'.
         // We calculate the length as max - min.
-        double x_len = x.max - x.min;
-        double y_len = y.max - y.min;
-        double z_len = z.max - z.min;
+        T x_len = x.max - x.min;
+        T y_len = y.max - y.min;
+        T z_len = z.max - z.min;
 
         if (x_len > y_len)
             return x_len > z_len ? 0 : 2;
@@ -85,8 +115,16 @@ public:
     }
 
     // Declare static members here
-    static const aabb empty;
-    static const aabb universe;
+    static const aabb_t empty;
+    static const aabb_t universe;
 };
 
+// constexpr like interval_t's, so these never see its statics before they are initialized.
+template <typename T>
+constexpr aabb_t<T> aabb_t<T>::empty = aabb_t<T>(interval_t<T>::empty, interval_t<T>::empty, interval_t<T>::empty);
+template <typename T>
+constexpr aabb_t<T> aabb_t<T>::universe = aabb_t<T>(interval_t<T>::universe, interval_t<T>::universe, interval_t<T>::universe);
+
+using aabb = aabb_t<real>;
+
 #endif
\ No newline at end of file
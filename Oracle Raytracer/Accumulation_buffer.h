@@ -0,0 +1,243 @@
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include "Color.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Running per-pixel sample sums for progressive rendering.
+// Every pixel keeps the sum of its samples, the sum of their squared luminance (for variance
+// estimates) and how many samples have been taken. Because every sample is seeded from
+// (pixel, sample index, frame), continuing from a stored buffer adds exactly the samples an
+// uninterrupted render would have, and the result is the same.
+//
+// The sums are doubles, in memory and in checkpoints: the variance is the small difference of
+// two large sums, which floats lose to cancellation after a few thousand samples, and adaptive
+// sampling stops pixels on it.
+
+// Sums of the samples a pixel received in one pass.
+struct sample_sum {
+    color sum;
+    double luminance_sq = 0;
+    int count = 0;
+
+    void add(const color& c) {
+        sum += c;
+        double y = luminance(c);
+        luminance_sq += y * y;
+        count++;
+    }
+};
+
+class accumulation_buffer {
+public:
+    accumulation_buffer() = default;
+
+    // `key` identifies the render settings the samples belong to; load() refuses checkpoints
+    // written with a different key.
+    accumulation_buffer(int width, int height, uint64_t key)
+        : w(width), h(height), settings_key(key),
+          sums(pixel_count() * 3, 0.0), luminance_sq(pixel_count(), 0.0), counts(pixel_count(), 0) {}
+
+    int width() const { return w; }
+    int height() const { return h; }
+    uint64_t key() const { return settings_key; }
+
+    void add(int x, int y, const sample_sum& s) {
+        size_t i = index(x, y);
+        sums[i * 3 + 0] += s.sum.x();
+        sums[i * 3 + 1] += s.sum.y();
+        sums[i * 3 + 2] += s.sum.z();
+        luminance_sq[i] += s.luminance_sq;
+        counts[i] += static_cast<uint32_t>(s.count);
+    }
+
+    int samples(int x, int y) const { return static_cast<int>(counts[index(x, y)]); }
+
+    color mean(int x, int y) const {
+        size_t i = index(x, y);
+        if (counts[i] == 0)
+            return color(0, 0, 0);
+        return color(sums[i * 3 + 0], sums[i * 3 + 1], sums[i * 3 + 2]) / counts[i];
+    }
+
+    // Sample variance of the pixel's luminance; 0 until it has two samples.
+    double luminance_variance(int x, int y) const {
+        size_t i = index(x, y);
+        double n = counts[i];
+        if (n < 2)
+            return 0;
+        double mean_y = luminance(color(sums[i * 3 + 0], sums[i * 3 + 1], sums[i * 3 + 2])) / n;
+        double variance = (luminance_sq[i] - n * mean_y * mean_y) / (n - 1);
+        return variance > 0 ? variance : 0;
+    }
+
+    int min_samples() const {
+        uint32_t lowest = counts.empty() ? 0 : counts[0];
+        for (auto c : counts)
+            lowest = c < lowest ? c : lowest;
+        return static_cast<int>(lowest);
+    }
+
+    uint64_t total_samples() const {
+        uint64_t total = 0;
+        for (auto c : counts)
+            total += c;
+        return total;
+    }
+
+    // The current estimate of every pixel.
+    image resolve() const {
+        image img(w, h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++)
+                img.set(x, y, mean(x, y));
+        }
+        return img;
+    }
+
+    // False-color map of the per-pixel sample counts, from dark blue (no samples) through cyan,
+    // green and yellow to red (`max_samples` or more).
+    image sample_heatmap(int max_samples) const {
+        image img(w, h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++)
+                img.set(x, y, heatmap_color(max_samples > 0 ? static_cast<double>(samples(x, y)) / max_samples : 0.0));
+        }
+        return img;
+    }
+
+    // Checkpoint layout, little-endian: "OACC", version, width, height, settings key, then the
+    // per-pixel sample counts as 32-bit integers and the RGB sums and luminance-square sums as
+    // raw doubles. Version 1 checkpoints, which hold the sums as floats, still load.
+    bool save(const std::string& path) const {
+        std::vector<uint8_t> out;
+        out.reserve(header_size + pixel_count() * (4 + 4 * 8));
+        out.insert(out.end(), { 'O', 'A', 'C', 'C' });
+        put32(out, version);
+        put32(out, static_cast<uint32_t>(w));
+        put32(out, static_cast<uint32_t>(h));
+        put32(out, static_cast<uint32_t>(settings_key));
+        put32(out, static_cast<uint32_t>(settings_key >> 32));
+        for (auto c : counts)
+            put32(out, c);
+        for (auto v : sums)
+            put64(out, double_bits(v));
+        for (auto v : luminance_sq)
+            put64(out, double_bits(v));
+
+        // Write next to the target and rename, so a crash mid-write never leaves a torn checkpoint.
+        std::string temp = path + ".tmp";
+        if (!write_file(temp, out))
+            return false;
+#if defined(_WIN32)
+        std::remove(path.c_str());
+#endif
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::cerr << "Error: Could not replace checkpoint " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Replaces the buffer with the checkpoint at `path` if it exists and was written for the same
+    // image size and settings key.
+    bool load(const std::string& path, int width, int height, uint64_t key) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        std::vector<uint8_t> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint32_t stored_version = in.size() >= header_size ? get32(in, 4) : 0;
+        if (in.size() < header_size || std::memcmp(in.data(), "OACC", 4) != 0 || stored_version < 1 || stored_version > version) {
+            std::cerr << "Error: " << path << " is not a checkpoint" << std::endl;
+            return false;
+        }
+        uint64_t stored_key = get32(in, 16) | static_cast<uint64_t>(get32(in, 20)) << 32;
+        if (static_cast<int>(get32(in, 8)) != width || static_cast<int>(get32(in, 12)) != height || stored_key != key) {
+            std::cerr << "Error: Checkpoint " << path << " was written for different render settings" << std::endl;
+            return false;
+        }
+
+        accumulation_buffer loaded(width, height, key);
+        size_t value_size = stored_version == 1 ? 4 : 8;
+        if (in.size() != header_size + loaded.pixel_count() * (4 + 4 * value_size)) {
+            std::cerr << "Error: Checkpoint " << path << " is truncated" << std::endl;
+            return false;
+        }
+
+        size_t at = header_size;
+        for (auto& c : loaded.counts) { c = get32(in, at); at += 4; }
+        auto value = [&](size_t at) { return value_size == 4 ? double(bits_float(get32(in, at))) : bits_double(get64(in, at)); };
+        for (auto& v : loaded.sums) { v = value(at); at += value_size; }
+        for (auto& v : loaded.luminance_sq) { v = value(at); at += value_size; }
+        *this = std::move(loaded);
+        return true;
+    }
+
+private:
+    static constexpr uint32_t version = 2;
+    static constexpr size_t header_size = 24;
+
+    int w = 0;
+    int h = 0;
+    uint64_t settings_key = 0;
+    std::vector<double> sums;
+    std::vector<double> luminance_sq;
+    std::vector<uint32_t> counts;
+
+    size_t pixel_count() const { return static_cast<size_t>(w) * h; }
+
+    size_t index(int x, int y) const { return static_cast<size_t>(y) * w + x; }
+
+    static uint64_t double_bits(double v) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    static double bits_double(uint64_t bits) {
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    static float bits_float(uint32_t bits) {
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    static void put32(std::vector<uint8_t>& out, uint32_t v) {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v >> 16));
+        out.push_back(static_cast<uint8_t>(v >> 24));
+    }
+
+    static void put64(std::vector<uint8_t>& out, uint64_t v) {
+        put32(out, static_cast<uint32_t>(v));
+        put32(out, static_cast<uint32_t>(v >> 32));
+    }
+
+    static uint32_t get32(const std::vector<uint8_t>& in, size_t at) {
+        return static_cast<uint32_t>(in[at]) | static_cast<uint32_t>(in[at + 1]) << 8
+            | static_cast<uint32_t>(in[at + 2]) << 16 | static_cast<uint32_t>(in[at + 3]) << 24;
+    }
+
+    static uint64_t get64(const std::vector<uint8_t>& in, size_t at) {
+        return get32(in, at) | static_cast<uint64_t>(get32(in, at + 4)) << 32;
+    }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef AOV_BUFFERS_H
+#define AOV_BUFFERS_H
+
+#include "Color.h"
+#include "Image.h"
+#include "Vector.h"
+
+#include <vector>
+
+// Arbitrary output variables: per-pixel data about the first surface each camera ray hits,
+// averaged over the pixel's samples like the color. A denoiser uses them as guides, since they
+// are nearly noise-free after a handful of samples while the color is not.
+//
+// Camera rays that miss the scene record the sky color as albedo, the reversed ray direction as
+// normal (so neighbouring sky pixels look alike to the denoiser) and a depth of 0.
+
+struct aov_buffers {
+    image albedo;                  // Surface color at the first hit: material albedo, white for dielectrics
+    image normal;                  // Unit shading normal at the first hit, facing the camera
+    std::vector<float> depth;      // Distance from the camera to the first hit
+    std::vector<float> variance;   // Variance of the pixel's mean luminance, estimated from its samples
+    int samples = 0;               // Samples behind every pixel
+
+    void resize(int width, int height) {
+        albedo = image(width, height);
+        normal = image(width, height);
+        depth.assign(static_cast<size_t>(width) * height, 0.0f);
+        variance.assign(static_cast<size_t>(width) * height, 0.0f);
+    }
+
+    int width() const { return albedo.width(); }
+    int height() const { return albedo.height(); }
+
+    // Depth in all three channels, for writing as a float image next to the albedo and normal.
+    image depth_image() const {
+        image img(width(), height());
+        for (int y = 0; y < height(); y++) {
+            for (int x = 0; x < width(); x++) {
+                double d = depth[static_cast<size_t>(y) * width() + x];
+                img.set(x, y, color(d, d, d));
+            }
+        }
+        return img;
+    }
+};
+
+// First-hit sums of one pixel's samples.
+struct aov_sum {
+    color albedo = color(0, 0, 0);
+    vec3 normal = vec3(0, 0, 0);
+    double depth = 0;
+
+    void add(const color& a, const vec3& n, double d) {
+        albedo += a;
+        normal += n;
+        depth += d;
+    }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Scene-lifetime bump allocator.
+// Objects are carved out of large blocks one after another, so a scene built in one go ends up
+// packed together in memory instead of spread over thousands of small heap blocks. Nothing is freed
+// individually: the destructor runs the destructors of non-trivial objects in reverse order and
+// releases every block at once.
+//
+// make_shared() hands out shared_ptrs for APIs that take them (hittable_list, bvh_node). They all
+// share one control block owned by the arena, so creating one costs no allocation; they must not
+// outlive the arena.
+
+struct arena_stats {
+    size_t blocks = 0;          // Blocks obtained from the heap
+    size_t bytes_reserved = 0;  // Total size of those blocks
+    size_t bytes_used = 0;      // Bytes handed out, including alignment padding
+    size_t allocations = 0;     // Objects and arrays handed out
+};
+
+class arena {
+public:
+    static constexpr size_t default_block_size = 256 * 1024;
+
+    explicit arena(size_t block_size = default_block_size)
+        : block_size(block_size), lifetime(this, [](arena*) {}) {}
+
+    ~arena() { release(); }
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    // `alignment` must be a power of two.
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = aligned_offset(alignment);
+        if (blocks.empty() || offset + bytes > capacity) {
+            // Start a new block; requests larger than a block get one sized to fit.
+            add_block(std::max(block_size, bytes + alignment));
+            offset = aligned_offset(alignment);
+        }
+
+        stats.bytes_used += offset + bytes - used;
+        stats.allocations++;
+        used = offset + bytes;
+        return blocks.back().get() + offset;
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            destructors.push_back({ object, [](void* p) { static_cast<T*>(p)->~T(); } });
+        return object;
+    }
+
+    // Uninitialized storage for `count` trivially constructible values.
+    template <typename T>
+    T* allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make_shared(Args&&... args) {
+        return std::shared_ptr<T>(lifetime, create<T>(std::forward<Args>(args)...));
+    }
+
+    // Destroys every object and frees every block; the arena can be reused afterwards.
+    void release() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+            it->destroy(it->object);
+        destructors.clear();
+        // Pointers held by objects inside the arena are gone now; any left are held from outside.
+        if (lifetime.use_count() > 1)
+            std::cerr << "Error: " << lifetime.use_count() - 1 << " shared_ptrs outlive their arena" << std::endl;
+        blocks.clear();
+        used = capacity = 0;
+        stats = arena_stats();
+    }
+
+    const arena_stats& statistics() const { return stats; }
+
+private:
+    struct destructor_entry {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    size_t block_size;
+    std::vector<std::unique_ptr<unsigned char[]>> blocks;
+    size_t used = 0;      // Bytes taken from the newest block
+    size_t capacity = 0;  // Size of the newest block
+    std::vector<destructor_entry> destructors;
+    std::shared_ptr<arena> lifetime;  // Control block shared by every make_shared() result
+    arena_stats stats;
+
+    size_t aligned_offset(size_t alignment) const {
+        if (blocks.empty())
+            return 0;
+        auto base = reinterpret_cast<uintptr_t>(blocks.back().get());
+        return ((base + used + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - base;
+    }
+
+    void add_block(size_t bytes) {
+        blocks.emplace_back(new unsigned char[bytes]);
+        used = 0;
+        capacity = bytes;
+        stats.blocks++;
+        stats.bytes_reserved += bytes;
+    }
+};
+
+#endif
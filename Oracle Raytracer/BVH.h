@@ -1,9 +1,11 @@
 #ifndef BVH_H
 #define BVH_H
 
-#include "aabb.h"        // For aabb
-#include "hittable.h"    // For hittable, shared_ptr, make_shared (likely via common_headers or hittable itself)
-#include "hittable_list.h" // For hittable_list and its members
+#include "AABB.h"        // For aabb
+#include "Hittable.h"    // For hittable, shared_ptr, make_shared (likely via common_headers or hittable itself)
+#include "Hittable_list.h" // For hittable_list and its members
+#include "Arena.h"
+#include "Render_stats.h"
 
 #include <algorithm>     // For std::sort
 #include <vector>        // For std::vector
@@ -15,19 +17,20 @@
 
 class bvh_node : public hittable {
 public:
-    // Constructor that takes the initial list of objects
-    bvh_node(hittable_list list)
+    // Constructor that takes the initial list of objects. With an arena, every interior node is
+    // allocated from it and the tree must not outlive it.
+    bvh_node(hittable_list list, arena* node_storage = nullptr)
 
     {
    
         std::vector<std::shared_ptr<hittable>> local_objects = list.objects; // Make a mutable copy
-        build_bvh(local_objects, 0, local_objects.size());
+        build_bvh(local_objects, 0, local_objects.size(), node_storage);
     }
 
     
 
     // Recursive helper function or a constructor that takes objects by reference
-    bvh_node(std::vector<std::shared_ptr<hittable>>& local_objects, size_t start, size_t end) {
+    bvh_node(std::vector<std::shared_ptr<hittable>>& local_objects, size_t start, size_t end, arena* node_storage = nullptr) {
         // Build the bounding box of the span of source objects.
         // This part was originally in the second constructor and is correctly placed.
         bbox = aabb::empty;
@@ -61,13 +64,15 @@ public:
             std::sort(local_objects.begin() + start, local_objects.begin() + end, comparator);
 
             auto mid = start + object_span / 2;
-            left = std::make_shared<bvh_node>(local_objects, start, mid);
-            right = std::make_shared<bvh_node>(local_objects, mid, end);
+            left = make_child(local_objects, start, mid, node_storage);
+            right = make_child(local_objects, mid, end, node_storage);
         }
     }
 
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        ORACLE_STAT(render_counters::local().bvh_nodes++);
+        ORACLE_STAT(render_counters::local().aabb_tests++);
         if (!bbox.hit(r, ray_t))
             return false;
 
@@ -92,7 +97,7 @@ public:
 private:
     // Helper to encapsulate the recursive construction if preferred
     // This is an alternative to having the second constructor public or directly called.
-    void build_bvh(std::vector<std::shared_ptr<hittable>>& build_objects, size_t start, size_t end) {
+    void build_bvh(std::vector<std::shared_ptr<hittable>>& build_objects, size_t start, size_t end, arena* node_storage) {
         // Calculate overall bounding box for the current node's primitives
         bbox = aabb::empty;
         for (size_t i = start; i < end; ++i) {
@@ -121,11 +126,17 @@ private:
         else {
             std::sort(build_objects.begin() + start, build_objects.begin() + end, comparator);
             auto mid = start + object_span / 2;
-            left = std::make_shared<bvh_node>(build_objects, start, mid); // Pass the vector by reference
-            right = std::make_shared<bvh_node>(build_objects, mid, end);  // Pass the vector by reference
+            left = make_child(build_objects, start, mid, node_storage); // Pass the vector by reference
+            right = make_child(build_objects, mid, end, node_storage);  // Pass the vector by reference
         }
     }
 
+    static std::shared_ptr<hittable> make_child(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end, arena* node_storage) {
+        if (node_storage)
+            return node_storage->make_shared<bvh_node>(objects, start, end, node_storage);
+        return std::make_shared<bvh_node>(objects, start, end);
+    }
+
   
 
     std::shared_ptr<hittable> left;
@@ -134,7 +145,7 @@ private:
 
     // Static comparison functions remain the same
     static bool box_compare(
-        const std::shared_ptr<hittable> a, const std::shared_ptr<hittable> b, int axis_index
+        const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b, int axis_index
     ) {
         // Ensure bounding_box() is const and axis_interval() is const
         aabb box_a = a->bounding_box();
@@ -144,15 +155,15 @@ private:
         return a_axis_interval.min < b_axis_interval.min;
     }
 
-    static bool box_x_compare(const std::shared_ptr<hittable> a, const std::shared_ptr<hittable> b) {
+    static bool box_x_compare(const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b) {
         return box_compare(a, b, 0);
     }
 
-    static bool box_y_compare(const std::shared_ptr<hittable> a, const std::shared_ptr<hittable> b) {
+    static bool box_y_compare(const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b) {
         return box_compare(a, b, 1);
     }
 
-    static bool box_z_compare(const std::shared_ptr<hittable> a, const std::shared_ptr<hittable> b) {
+    static bool box_z_compare(const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b) {
         return box_compare(a, b, 2);
     }
 
@@ -0,0 +1,1129 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Utilities.h"
+#include "Arena.h"
+#include "Vector.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "Demo_scenes.h"
+#include "Denoiser.h"
+#include "Image.h"
+#include "Lights.h"
+#include "Linear_BVH.h"
+#include "Material.h"
+#include "Obj_file.h"
+#include "Scene_file.h"
+#include "Scene_geometry.h"
+#include "Sphere.h"
+#include "Sphere_list.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Micro benchmarks, run with: "Oracle Raytracer" --bench <name>
+
+class benchmark_timer {
+public:
+    benchmark_timer() : start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Keeps results alive so the optimizer can't drop the measured work.
+volatile double benchmark_sink = 0;
+
+void report_benchmark(const std::string& name, double seconds, double ops) {
+    std::cout << name << ": " << (seconds * 1e9 / ops) << " ns/op, "
+        << (ops / seconds / 1e6) << " Mops/s\n";
+}
+
+// Draws `count` doubles from `next` on each of `threads` threads and reports the aggregate rate.
+template <typename Make>
+void bench_rng_threads(const std::string& name, int threads, long count, Make make_next) {
+    benchmark_timer timer;
+    std::vector<std::thread> workers;
+    std::vector<double> sums(threads, 0.0);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            auto next = make_next(t);
+            double sum = 0;
+            for (long k = 0; k < count; k++)
+                sum += next();
+            sums[t] = sum;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    for (double s : sums)
+        benchmark_sink = benchmark_sink + s;
+    report_benchmark(name + " x" + std::to_string(threads) + " threads", timer.seconds(), double(count) * threads);
+}
+
+void bench_rng() {
+    const long count = 20000000;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads < 1) threads = 1;
+
+    std::vector<int> thread_counts = { 1 };
+    if (threads > 1)
+        thread_counts.push_back(threads);
+
+    for (int n : thread_counts) {
+        bench_rng_threads("rand()", n, count, [](int) {
+            return [] { return rand() / (RAND_MAX + 1.0); };
+        });
+        bench_rng_threads("mt19937 + uniform_real_distribution", n, count, [](int t) {
+            return [gen = std::mt19937(t), dist = std::uniform_real_distribution<double>(0.0, 1.0)]() mutable {
+                return dist(gen);
+            };
+        });
+        bench_rng_threads("pcg32", n, count, [](int t) {
+            pcg32 rng;
+            rng.seed(t);
+            return [rng]() mutable { return rng.next_double(); };
+        });
+        bench_rng_threads("xoshiro256+", n, count, [](int t) {
+            xoshiro256plus rng;
+            rng.seed(t);
+            return [rng]() mutable { return rng.next_double(); };
+        });
+    }
+
+    // Per-sample reseeding is on the camera's hot path too.
+    {
+        benchmark_timer timer;
+        double sum = 0;
+        for (long k = 0; k < count / 10; k++) {
+            seed_sample(k, k & 127, 0);
+            sum += random_double();
+        }
+        benchmark_sink = benchmark_sink + sum;
+        report_benchmark("seed_sample + random_double", timer.seconds(), double(count / 10));
+    }
+
+    // What the scatter code actually calls.
+    {
+        benchmark_timer timer;
+        vec3 sum;
+        for (long k = 0; k < count / 10; k++)
+            sum += random_unit_vector();
+        benchmark_sink = benchmark_sink + sum.x();
+        report_benchmark("random_unit_vector", timer.seconds(), double(count / 10));
+    }
+}
+
+hittable_list random_sphere_scene(int count, uint64_t seed = 1, arena* storage = nullptr) {
+    // Spheres scattered through a 100^3 box, with radii small enough that most rays travel a while.
+    // With `storage`, the spheres are allocated from that arena instead of one by one on the heap.
+    seed_random(seed);
+    const uint32_t mat = 0;  // Only geometry is traced; no material table needed.
+    hittable_list scene;
+    scene.objects.reserve(count);
+    for (int k = 0; k < count; k++) {
+        point3 center = vec3::random(-50, 50);
+        double radius = random_double(0.05, 0.5);
+        if (storage)
+            scene.add(storage->make_shared<sphere>(center, radius, mat));
+        else
+            scene.add(make_shared<sphere>(center, radius, mat));
+    }
+    return scene;
+}
+
+std::vector<ray> random_rays(int count, uint64_t seed = 2) {
+    seed_random(seed);
+    std::vector<ray> rays;
+    rays.reserve(count);
+    for (int k = 0; k < count; k++)
+        rays.emplace_back(vec3::random(-60, 60), random_unit_vector());
+    return rays;
+}
+
+// Traces every ray against `world` and reports the rate; returns the number of hits.
+size_t bench_trace(const std::string& name, const hittable& world, const std::vector<ray>& rays) {
+    benchmark_timer timer;
+    size_t hits = 0;
+    hit_record rec;
+    for (const auto& r : rays) {
+        if (world.hit(r, interval(0.001, infinity), rec))
+            hits++;
+    }
+    double seconds = timer.seconds();
+    std::cout << name << ": " << (rays.size() / seconds / 1e6) << " Mrays/s, "
+        << (seconds * 1e9 / rays.size()) << " ns/ray, " << hits << " hits\n";
+    return hits;
+}
+
+hittable_list clustered_sphere_scene(int count, uint64_t seed = 3) {
+    // A huge ground sphere plus tight clusters of small spheres: the uneven layout median splits handle badly.
+    seed_random(seed);
+    const uint32_t mat = 0;  // Only geometry is traced; no material table needed.
+    hittable_list scene;
+    scene.add(make_shared<sphere>(point3(0, -1000, 0), 1000, mat));
+
+    std::vector<point3> clusters;
+    for (int k = 0; k < 8; k++)
+        clusters.push_back(vec3::random(-40, 40) + vec3(0, 40, 0));
+    for (int k = 0; k < count - 1; k++) {
+        point3 center = clusters[k % clusters.size()] + 3 * random_in_unit_sphere();
+        scene.add(make_shared<sphere>(center, random_double(0.02, 0.2), mat));
+    }
+    return scene;
+}
+
+void report_build(const std::string& name, const linear_bvh& bvh) {
+    const auto& stats = bvh.build_stats();
+    std::cout << name << " build: " << stats.build_ms << " ms, SAH cost " << stats.sah_cost
+        << ", " << stats.node_count << " nodes, " << stats.leaf_count << " leaves, depth " << stats.depth << "\n";
+}
+
+void bench_bvh() {
+    const int ray_count = 500000;
+    auto rays = random_rays(ray_count);
+
+    bvh_build_options median_options;
+    median_options.split_method = bvh_split_method::median;
+    median_options.max_leaf_size = 2;
+
+    struct scenario { std::string name; hittable_list scene; };
+    std::vector<scenario> scenarios;
+    scenarios.push_back({ "1000 random spheres", random_sphere_scene(1000) });
+    scenarios.push_back({ "100000 random spheres", random_sphere_scene(100000) });
+    scenarios.push_back({ "100000 clustered spheres", clustered_sphere_scene(100000) });
+
+    for (const auto& sc : scenarios) {
+        std::cout << sc.name << "\n";
+
+        benchmark_timer tree_timer;
+        bvh_node tree(sc.scene);
+        std::cout << "  bvh_node build: " << tree_timer.seconds() * 1e3 << " ms\n";
+
+        linear_bvh median(sc.scene, median_options);
+        report_build("  linear_bvh (median)", median);
+        linear_bvh sah(sc.scene);
+        report_build("  linear_bvh (SAH)", sah);
+
+        size_t tree_hits = bench_trace("  bvh_node", tree, rays);
+        size_t median_hits = bench_trace("  linear_bvh (median)", median, rays);
+        size_t sah_hits = bench_trace("  linear_bvh (SAH)", sah, rays);
+        if (tree_hits != median_hits || tree_hits != sah_hits)
+            std::cout << "  WARNING: hit counts differ\n";
+    }
+}
+
+void bench_bvh_build() {
+    // Build-only scaling, serial against parallel, where tracing would take too long to be useful.
+    for (int count : { 100000, 1000000 }) {
+        auto scene = random_sphere_scene(count);
+        std::cout << count << " random spheres\n";
+
+        bvh_build_options serial;
+        serial.thread_count = 1;
+        report_build("  SAH serial", linear_bvh(scene, serial));
+        report_build("  SAH parallel", linear_bvh(scene));
+
+        bvh_build_options median;
+        median.split_method = bvh_split_method::median;
+        report_build("  median parallel", linear_bvh(scene, median));
+    }
+}
+
+std::vector<simd_level> supported_simd_levels() {
+    std::vector<simd_level> levels;
+    for (auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512 }) {
+        if (level <= simd_support())
+            levels.push_back(level);
+    }
+    return levels;
+}
+
+void bench_spheres() {
+    std::cout << "CPU supports: " << simd_level_name(simd_support()) << "\n";
+    auto rays = random_rays(200000);
+
+    // Flat lists: the virtual per-sphere loop against the SoA kernels.
+    for (int count : { 8, 64, 1024 }) {
+        auto scene = random_sphere_scene(count);
+        std::cout << count << " spheres, flat list\n";
+
+        sphere_list soa;
+        for (const auto& object : scene.objects)
+            soa.add(*std::static_pointer_cast<sphere>(object));
+
+        size_t reference = bench_trace("  hittable_list", scene, rays);
+        for (auto level : supported_simd_levels()) {
+            soa.set_simd_level(level);
+            if (bench_trace(std::string("  sphere_list ") + simd_level_name(level), soa, rays) != reference)
+                std::cout << "  WARNING: hit counts differ\n";
+        }
+    }
+
+    // BVH leaves use the same kernels; larger leaves give them more to chew on.
+    auto scene = random_sphere_scene(100000);
+    for (int leaf_size : { 4, 8, 16 }) {
+        bvh_build_options options;
+        options.max_leaf_size = leaf_size;
+        options.intersection_cost = 0.25;
+        linear_bvh bvh(scene, options);
+        std::cout << "100000 spheres, linear_bvh, max leaf size " << leaf_size << "\n";
+        for (auto level : supported_simd_levels()) {
+            bvh.set_simd_level(level);
+            bench_trace(std::string("  ") + simd_level_name(level), bvh, rays);
+        }
+    }
+}
+
+// Traces rays in full packets through hit_packet; returns the number of hits.
+size_t bench_trace_packets(const std::string& name, const hittable& world, const std::vector<ray>& rays) {
+    benchmark_timer timer;
+    size_t hits = 0;
+    for (size_t first = 0; first < rays.size(); first += ray_packet::max_size) {
+        ray_packet packet;
+        size_t last = std::min(rays.size(), first + ray_packet::max_size);
+        for (size_t k = first; k < last; k++)
+            packet.add(rays[k], interval(0.001, infinity));
+        packet_hits result;
+        world.hit_packet(packet, result);
+        for (int k = 0; k < packet.count; k++)
+            hits += result.hit[k] ? 1 : 0;
+    }
+    double seconds = timer.seconds();
+    std::cout << name << ": " << (rays.size() / seconds / 1e6) << " Mrays/s, "
+        << (seconds * 1e9 / rays.size()) << " ns/ray, " << hits << " hits\n";
+    return hits;
+}
+
+void bench_packets() {
+    // A block of spheres seen through a pinhole: primary rays in scanline order are coherent,
+    // the diffuse bounces off whatever they hit are not.
+    seed_random(4);
+    const uint32_t mat = 0;  // Only geometry is traced; no material table needed.
+    hittable_list scene;
+    for (int k = 0; k < 20000; k++)
+        scene.add(make_shared<sphere>(vec3::random(-10, 10), random_double(0.1, 0.4), mat));
+    linear_bvh bvh(scene);
+
+    const int width = 512, height = 512;
+    point3 eye(0, 0, 40);
+    std::vector<ray> primary;
+    primary.reserve(width * height);
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            vec3 target(20.0 * i / width - 10, 10 - 20.0 * j / height, 10);
+            primary.emplace_back(eye, target - eye);
+        }
+    }
+
+    std::vector<ray> secondary;
+    hit_record rec;
+    for (const auto& r : primary) {
+        if (bvh.hit(r, interval(0.001, infinity), rec))
+            secondary.emplace_back(rec.p, rec.normal + random_unit_vector());
+    }
+
+    std::cout << "primary rays (" << primary.size() << ")\n";
+    size_t single = bench_trace("  single", bvh, primary);
+    if (bench_trace_packets("  packets of " + std::to_string(ray_packet::max_size), bvh, primary) != single)
+        std::cout << "  WARNING: hit counts differ\n";
+
+    std::cout << "secondary rays (" << secondary.size() << ")\n";
+    single = bench_trace("  single", bvh, secondary);
+    if (bench_trace_packets("  packets of " + std::to_string(ray_packet::max_size), bvh, secondary) != single)
+        std::cout << "  WARNING: hit counts differ\n";
+}
+
+void bench_image() {
+    // A smooth gradient with noise on top, roughly what a converging render looks like.
+    const int width = 800, height = 450;
+    image img(width, height);
+    seed_random(5);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double noise = 0.05 * random_double();
+            img.set(x, y, color(double(x) / width + noise, double(y) / height, 0.5 + noise));
+        }
+    }
+
+    struct format_case { const char* name; image_format format; };
+    for (auto c : { format_case{ "P3 ascii", image_format::ppm_ascii }, format_case{ "P6 binary", image_format::ppm },
+                    format_case{ "PFM", image_format::pfm }, format_case{ "QOI", image_format::qoi } }) {
+        const int repeats = 10;
+        size_t bytes = 0;
+        benchmark_timer timer;
+        for (int k = 0; k < repeats; k++)
+            bytes = encode_image(img, c.format).size();
+        double ms = timer.seconds() * 1e3 / repeats;
+        std::cout << c.name << ": " << ms << " ms/image, " << bytes << " bytes\n";
+    }
+}
+
+hittable_list material_scene(material_table& materials) {
+    // Diffuse ground with a diffuse, a metal and a glass sphere: paths bounce a lot between them.
+    hittable_list scene;
+    scene.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.5, 0.5, 0.5)))));
+    scene.add(make_shared<sphere>(point3(-1.2, 1, 0), 1, materials.add(lambertian(color(0.7, 0.3, 0.3)))));
+    scene.add(make_shared<sphere>(point3(0, 1, -0.5), 1, materials.add(metal(color(0.8, 0.8, 0.8), 0.05))));
+    scene.add(make_shared<sphere>(point3(1.2, 1, 0.5), 1, materials.add(dielectric(1.5))));
+    return scene;
+}
+
+camera material_scene_camera(int width, int samples) {
+    camera cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = width;
+    cam.samples_per_pixel = samples;
+    cam.max_depth = 50;
+    cam.vfov = 50;
+    cam.lookfrom = point3(0, 2, 6);
+    cam.lookat = point3(0, 1, 0);
+    return cam;
+}
+
+double mean_squared_error(const image& a, const image& b) {
+    double sum = 0;
+    size_t n = static_cast<size_t>(a.width()) * a.height() * 3;
+    for (size_t k = 0; k < n; k++) {
+        double d = static_cast<double>(a.data()[k]) - b.data()[k];
+        sum += d * d;
+    }
+    return sum / n;
+}
+
+void bench_integrators() {
+    // Error against a high sample count reference versus render time. Efficiency is 1/(MSE * time):
+    // higher is better, and it does not depend on the sample count used.
+    const int width = 128, samples = 16, reference_samples = 1024;
+    material_table materials;
+    auto scene = material_scene(materials);
+    linear_bvh world(scene);
+    std::clog.setstate(std::ios::failbit);  // Silence per-tile progress.
+
+    camera reference_cam = material_scene_camera(width, reference_samples);
+    reference_cam.frame = 1;  // Independent noise from the measured renders.
+    benchmark_timer reference_timer;
+    image reference = reference_cam.render_image(world, materials);
+    std::cout << "Reference: " << reference_samples << " spp, " << reference_timer.seconds() << " s\n";
+
+    struct integrator_case { const char* name; integrator_type type; int roulette_depth; };
+    for (auto c : { integrator_case{ "recursive", integrator_type::recursive, 0 },
+                    integrator_case{ "iterative, no roulette", integrator_type::iterative, 1000 },
+                    integrator_case{ "iterative, roulette after 3", integrator_type::iterative, 3 },
+                    integrator_case{ "iterative, roulette after 1", integrator_type::iterative, 1 } }) {
+        camera cam = material_scene_camera(width, samples);
+        cam.integrator = c.type;
+        cam.roulette_depth = c.roulette_depth;
+        benchmark_timer timer;
+        image img = cam.render_image(world, materials);
+        double seconds = timer.seconds();
+        double mse = mean_squared_error(img, reference);
+        double sample_count = static_cast<double>(img.width()) * img.height() * samples;
+        std::cout << c.name << ": " << seconds * 1e9 / sample_count << " ns/sample, MSE " << mse
+                  << ", efficiency " << 1 / (mse * seconds) << "\n";
+    }
+    std::clog.clear();
+}
+
+void bench_denoise() {
+    // Time to quality: error against a high sample count reference of plain renders at rising
+    // sample counts, and of denoised ones. For each denoised render, the plain render that first
+    // reaches the same error shows what the denoiser saves.
+    const int width = 256, reference_samples = 4096;
+    material_table materials;
+    auto scene = material_scene(materials);
+    linear_bvh world(scene);
+    std::clog.setstate(std::ios::failbit);  // Silence per-tile progress.
+
+    camera reference_cam = material_scene_camera(width, reference_samples);
+    reference_cam.frame = 1;  // Independent noise from the measured renders.
+    benchmark_timer reference_timer;
+    image reference = reference_cam.render_image(world, materials);
+    std::cout << "Reference: " << reference_samples << " spp, " << reference_timer.seconds() << " s\n";
+
+    struct result { int samples; double seconds; double mse; };
+    std::vector<result> plain, denoised;
+    for (int samples : { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 }) {
+        camera cam = material_scene_camera(width, samples);
+        aov_buffers aovs;
+        cam.aovs = &aovs;
+        benchmark_timer timer;
+        image img = cam.render_image(world, materials);
+        double render_seconds = timer.seconds();
+        plain.push_back({ samples, render_seconds, mean_squared_error(img, reference) });
+
+        // The first filtered image is kept for the comparison; the others only time the kernels.
+        image filtered;
+        std::cout << samples << " spp: render " << render_seconds * 1e3 << " ms, MSE " << plain.back().mse << "; denoise";
+        for (simd_level level : { simd_support(), simd_level::scalar }) {
+            denoiser filter;
+            filter.level = level;
+            benchmark_timer denoise_timer;
+            image out = filter.denoise(img, aovs);
+            std::cout << " " << denoise_timer.seconds() * 1e3 << " ms (" << simd_level_name(filter.kernel()) << ")";
+            if (filtered.width() == 0) {
+                filtered = std::move(out);
+                denoised.push_back({ samples, render_seconds + denoise_timer.seconds(), mean_squared_error(filtered, reference) });
+            }
+        }
+        std::cout << ", MSE " << denoised.back().mse << "\n";
+    }
+
+    std::cout << "Time to quality:\n";
+    for (const auto& d : denoised) {
+        auto match = std::find_if(plain.begin(), plain.end(), [&](const result& p) { return p.mse <= d.mse; });
+        std::cout << "  " << d.samples << " spp + denoise, " << d.seconds * 1e3 << " ms: ";
+        if (match == plain.end())
+            std::cout << "better than every plain render (up to " << plain.back().samples << " spp, " << plain.back().seconds * 1e3 << " ms)\n";
+        else
+            std::cout << "matched by " << match->samples << " spp, " << match->seconds * 1e3 << " ms (x" << match->seconds / d.seconds << ")\n";
+    }
+    std::clog.clear();
+}
+
+void bench_lights() {
+    // Error at equal render time, against a light-sampled reference with many samples, of finding
+    // the small emissive spheres of light_field_scene by BSDF sampling alone and of next-event
+    // estimation with uniform and with light-tree selection. At equal time, the ratio of the errors
+    // is the ratio of the variances (all three are unbiased).
+    const int width = 160, reference_samples = 1024;
+    const double budget = 1.0;   // Seconds per measured render
+    std::clog.setstate(std::ios::failbit);  // Silence per-tile progress.
+
+    for (int count : { 1, 64, 4096 }) {
+        scene_description scene;
+        light_field_scene(scene, count);
+        linear_bvh world(scene.geometry);
+        light_list tree_lights(scene.geometry, scene.materials);
+        light_list uniform_lights = tree_lights;
+        uniform_lights.selection = light_selection::uniform;
+
+        // Cost of one pick and cone sample, over shading points spread like the lights.
+        {
+            std::vector<point3> points(4096);
+            for (auto& p : points)
+                p = point3(random_double(-10, 10), random_double(0, 2), random_double(-10, 10));
+            for (const light_list* lights : { &uniform_lights, &tree_lights }) {
+                const int samples = 1000000;
+                light_sample s;
+                double sum = 0;
+                benchmark_timer timer;
+                for (int k = 0; k < samples; k++) {
+                    if (lights->sample(points[k & 4095], 0.5, s))
+                        sum += s.pdf;
+                }
+                benchmark_sink = sum;
+                std::cout << count << " lights, " << (lights == &tree_lights ? "tree" : "uniform") << " pick: "
+                    << timer.seconds() * 1e9 / samples << " ns\n";
+            }
+        }
+
+        camera reference_cam = scene.cam;
+        reference_cam.image_width = width;
+        reference_cam.samples_per_pixel = reference_samples;
+        reference_cam.lights = &tree_lights;
+        reference_cam.frame = 1;  // Independent noise from the measured renders.
+        benchmark_timer reference_timer;
+        image reference = reference_cam.render_image(world, scene.materials);
+        std::cout << count << " lights, reference: " << reference_samples << " spp, " << reference_timer.seconds() << " s\n";
+
+        struct method { const char* name; const light_list* lights; bool sample; };
+        double bsdf_cost = 0;
+        for (auto m : { method{ "BSDF sampling", &tree_lights, false },
+                        method{ "NEE + MIS, uniform pick", &uniform_lights, true },
+                        method{ "NEE + MIS, light tree", &tree_lights, true } }) {
+            camera cam = scene.cam;
+            cam.image_width = width;
+            cam.lights = m.lights;
+            cam.sample_lights = m.sample;
+            // Time a few samples, then take as many as fit the budget.
+            cam.samples_per_pixel = 4;
+            benchmark_timer probe;
+            cam.render_image(world, scene.materials);
+            cam.samples_per_pixel = std::max(1, static_cast<int>(4 * budget / probe.seconds()));
+            benchmark_timer timer;
+            image img = cam.render_image(world, scene.materials);
+            double seconds = timer.seconds();
+            double mse = mean_squared_error(img, reference);
+            // Variance falls as 1 / time, so error times time compares methods at equal time.
+            if (!m.sample)
+                bsdf_cost = mse * seconds;
+            std::cout << "  " << m.name << ": " << cam.samples_per_pixel << " spp in " << seconds << " s, MSE " << mse
+                << ", variance vs BSDF sampling at equal time x" << mse * seconds / bsdf_cost << "\n";
+        }
+    }
+    std::clog.clear();
+}
+
+void bench_trace_threads(const std::string& name, const hittable& world, const std::vector<ray>& rays, int threads) {
+    // Every thread traces the whole ray set, so hits on shared spheres overlap in time.
+    benchmark_timer timer;
+    std::vector<std::thread> workers;
+    std::vector<size_t> hits(threads, 0);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            hit_record rec;
+            for (const auto& r : rays) {
+                if (world.hit(r, interval(0.001, infinity), rec))
+                    hits[t]++;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    double seconds = timer.seconds();
+    double total = double(rays.size()) * threads;
+    std::cout << name << " x" << threads << " threads: " << (total / seconds / 1e6) << " Mrays/s, "
+        << (seconds * 1e9 / total) << " ns/ray\n";
+}
+
+void bench_materials() {
+    // Cost of scatter() per material type, on hit records spread over a unit sphere.
+    const int count = 1000000;
+    material_table materials;
+    uint32_t ids[] = { materials.add(lambertian(color(0.5, 0.5, 0.5))), materials.add(metal(color(0.8, 0.8, 0.8), 0.1)),
+                       materials.add(dielectric(1.5)) };
+    const char* names[] = { "lambertian", "metal", "dielectric" };
+
+    seed_random(6);
+    std::vector<hit_record> records(1024);
+    std::vector<ray> incoming(records.size());
+    for (size_t k = 0; k < records.size(); k++) {
+        vec3 n = random_unit_vector();
+        ray r(point3(0, 0, 0) - 2 * n + random_unit_vector() * 0.5, n);
+        records[k].p = n;
+        records[k].t = 1;
+        records[k].set_face_normal(r, n);
+        incoming[k] = r;
+    }
+
+    for (int m = 0; m < 3; m++) {
+        const material& mat = materials[ids[m]];
+        benchmark_timer timer;
+        double sum = 0;
+        for (int k = 0; k < count; k++) {
+            size_t i = static_cast<size_t>(k) & (records.size() - 1);
+            color attenuation;
+            ray scattered;
+            if (mat.scatter(incoming[i], records[i], attenuation, scattered))
+                sum += scattered.direction().x();
+        }
+        benchmark_sink = benchmark_sink + sum;
+        report_benchmark(std::string("scatter ") + names[m], timer.seconds(), count);
+    }
+
+    // Hit records used to take a shared_ptr<material> on every accepted candidate, an atomic
+    // reference count update on a control block shared by all threads. With material ids a hit is
+    // plain stores; the per-thread throughput should no longer drop as threads are added.
+    // Rays aimed into a cluster of spheres, so most of them pass through several candidate hits.
+    seed_random(7);
+    hittable_list scene;
+    for (int k = 0; k < 64; k++)
+        scene.add(make_shared<sphere>(vec3::random(-10, 10), random_double(1.0, 2.0), 0));
+    std::vector<ray> rays;
+    for (int k = 0; k < 200000; k++) {
+        point3 origin = 40 * random_unit_vector();
+        rays.emplace_back(origin, vec3::random(-10, 10) - origin);
+    }
+    linear_bvh bvh(scene);
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= hardware; threads *= 2) {
+        bench_trace_threads("64 spheres, hittable_list", scene, rays, threads);
+        bench_trace_threads("64 spheres, linear_bvh", bvh, rays, threads);
+    }
+}
+
+// A user-defined shape as the scene sees it: an opaque hittable. Wrapping spheres this way sends
+// them through the custom bucket and its virtual calls, the path every primitive used to take.
+class boxed_sphere : public hittable {
+public:
+    explicit boxed_sphere(const sphere& s) : inner(s) {}
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override { return inner.hit(r, ray_t, rec); }
+    aabb bounding_box() const override { return inner.bounding_box(); }
+
+private:
+    sphere inner;
+};
+
+void bench_geometry() {
+    auto rays = random_rays(200000);
+    for (int count : { 1000, 100000 }) {
+        for (bool clustered : { false, true }) {
+            auto scene = clustered ? clustered_sphere_scene(count) : random_sphere_scene(count);
+            std::cout << count << (clustered ? " clustered" : " random") << " spheres\n";
+
+            scene_geometry typed(scene);
+            scene_geometry boxed;
+            for (const auto& object : scene.objects)
+                boxed.add(make_shared<boxed_sphere>(*std::static_pointer_cast<sphere>(object)));
+
+            for (int leaf_size : { 4, 16 }) {
+                bvh_build_options options;
+                options.max_leaf_size = leaf_size;
+                linear_bvh typed_bvh(typed, options);
+                linear_bvh boxed_bvh(boxed, options);
+                std::string leaf = " (leaf " + std::to_string(leaf_size) + ")";
+                size_t typed_hits = bench_trace("  sphere bucket" + leaf, typed_bvh, rays);
+                size_t boxed_hits = bench_trace("  custom hittables" + leaf, boxed_bvh, rays);
+                if (typed_hits != boxed_hits)
+                    std::cout << "  WARNING: hit counts differ\n";
+            }
+        }
+    }
+}
+
+void report_arena(const std::string& name, const arena& storage, const char* unit) {
+    const arena_stats& st = storage.statistics();
+    std::cout << name << ": " << st.allocations << " allocations in " << st.blocks << " blocks, "
+        << st.bytes_used / 1024 << " KiB used of " << st.bytes_reserved / 1024 << " KiB, "
+        << double(st.bytes_used) / st.allocations << " bytes/" << unit << "\n";
+}
+
+void bench_memory() {
+    const int count = 250000;
+    auto rays = random_rays(200000);
+
+    // Pointer-based scene and tree: heap blocks one by one versus the same objects from arenas.
+    // make_shared places the object and its control block in one heap block per object.
+    {
+        std::cout << count << " spheres, hittable_list + bvh_node\n";
+        benchmark_timer scene_timer;
+        auto scene = random_sphere_scene(count);
+        double scene_ms = scene_timer.seconds() * 1e3;
+        benchmark_timer tree_timer;
+        bvh_node tree(scene);
+        double tree_ms = tree_timer.seconds() * 1e3;
+        std::cout << "  heap: scene " << scene_ms << " ms, tree " << tree_ms << " ms, one block per sphere (~"
+            << sizeof(sphere) + 16 << " bytes) and per node (~" << sizeof(bvh_node) + 16 << " bytes)\n";
+        bench_trace("  heap", tree, rays);
+    }
+    {
+        arena sphere_storage, node_storage;
+        benchmark_timer scene_timer;
+        auto scene = random_sphere_scene(count, 1, &sphere_storage);
+        double scene_ms = scene_timer.seconds() * 1e3;
+        benchmark_timer tree_timer;
+        bvh_node tree(scene, &node_storage);
+        double tree_ms = tree_timer.seconds() * 1e3;
+        std::cout << "  arena: scene " << scene_ms << " ms, tree " << tree_ms << " ms\n";
+        report_arena("  arena spheres", sphere_storage, "primitive");
+        report_arena("  arena nodes", node_storage, "node");
+        bench_trace("  arena", tree, rays);
+    }
+
+    // The flattened BVH keeps its nodes in one array and its spheres in the SoA mirror.
+    for (int n : { 250000, 1000000 }) {
+        arena sphere_storage;
+        auto scene = random_sphere_scene(n, 1, &sphere_storage);
+        scene_geometry geometry(scene);
+        linear_bvh bvh(geometry);
+        const auto& st = bvh.build_stats();
+        std::cout << n << " spheres, linear_bvh: build " << st.build_ms << " ms, "
+            << double(st.primitive_bytes) / n << " bytes/primitive, "
+            << double(st.node_bytes) / st.node_count << " bytes/node, "
+            << double(st.node_bytes + st.primitive_bytes) / n << " bytes/primitive in total\n";
+        if (n == count)
+            bench_trace("  linear_bvh", bvh, rays);
+    }
+}
+
+void bench_scene_load() {
+    // Scene construction for a large sphere count: per-object make_shared plus conversion to the
+    // typed buckets, against loading the same scene from the text and binary scene files.
+    const int count = 5000000;
+    const std::string text_path = "bench_scene.scene", binary_path = "bench_scene.oscn";
+    {
+        benchmark_timer timer;
+        auto list = random_sphere_scene(count);
+        scene_geometry geometry(list);
+        double seconds = timer.seconds();
+        std::cout << count << " spheres via make_shared: " << seconds << " s, "
+            << count / seconds / 1e6 << " M spheres/s\n";
+    }
+    {
+        scene_description scene;
+        scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+        // Coordinates rounded to 4 decimals, like a scene written by hand or by an exporter; full
+        // 17-digit values take the slower strtod path in the text parser.
+        auto rounded = [](double v) { return std::round(v * 1e4) / 1e4; };
+        seed_random(1);
+        for (int k = 0; k < count; k++) {
+            vec3 c = vec3::random(-50, 50);
+            scene.geometry.add_sphere(point3(rounded(c.x()), rounded(c.y()), rounded(c.z())), vec3(0, 0, 0),
+                rounded(random_double(0.05, 0.5)), 0);
+        }
+        if (!save_scene(scene, text_path) || !save_scene(scene, binary_path))
+            return;
+    }
+    for (const std::string& path : { text_path, binary_path }) {
+        size_t file_bytes = 0;
+        {
+            mapped_file file(path);
+            file_bytes = file.size();
+        }
+        benchmark_timer timer;
+        scene_description scene;
+        if (!load_scene(path, scene))
+            return;
+        double seconds = timer.seconds();
+        std::cout << path << ": " << file_bytes / (1024.0 * 1024.0) << " MiB, load " << seconds << " s, "
+            << count / seconds / 1e6 << " M spheres/s, " << file_bytes / seconds / (1024.0 * 1024.0) << " MiB/s, "
+            << double(scene.geometry.spheres.memory_bytes()) / count << " bytes/sphere in memory\n";
+    }
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+}
+
+// Writes a torus of rings x segments quads with vertex normals as an OBJ file.
+bool write_torus_obj(const std::string& path, int rings, int segments, double major_radius, double minor_radius) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not create file " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "# Torus, %d x %d quads\n", rings, segments);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < rings; i++) {
+            double u = 2 * pi * i / rings;
+            for (int j = 0; j < segments; j++) {
+                double v = 2 * pi * j / segments;
+                vec3 normal(std::cos(u) * std::cos(v), std::sin(v), std::sin(u) * std::cos(v));
+                if (pass == 0) {
+                    point3 p = major_radius * vec3(std::cos(u), 0, std::sin(u)) + minor_radius * normal;
+                    std::fprintf(file, "v %.6f %.6f %.6f\n", p.x(), p.y(), p.z());
+                }
+                else {
+                    std::fprintf(file, "vn %.5f %.5f %.5f\n", normal.x(), normal.y(), normal.z());
+                }
+            }
+        }
+    }
+    for (int i = 0; i < rings; i++) {
+        for (int j = 0; j < segments; j++) {
+            int a = i * segments + j + 1;
+            int b = i * segments + (j + 1) % segments + 1;
+            int c = (i + 1) % rings * segments + (j + 1) % segments + 1;
+            int d = (i + 1) % rings * segments + j + 1;
+            std::fprintf(file, "f %d//%d %d//%d %d//%d %d//%d\n", a, a, b, b, c, c, d, d);
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+void bench_mesh_load() {
+    // A torus of 1000 x 500 quads: a million triangles over half a million vertices with normals,
+    // about the size of a scanned model. Loaded from OBJ and from the binary scene file, then
+    // built and traced.
+    const int rings = 1000, segments = 500;
+    const std::string obj_path = "bench_mesh.obj", binary_path = "bench_mesh.oscn";
+    if (!write_torus_obj(obj_path, rings, segments, 40, 15))
+        return;
+
+    scene_description scene;
+    scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    size_t file_bytes = 0;
+    {
+        mapped_file file(obj_path);
+        file_bytes = file.size();
+    }
+    benchmark_timer obj_timer;
+    if (!load_obj(obj_path, scene.geometry, 0))
+        return;
+    double obj_seconds = obj_timer.seconds();
+
+    const triangle_mesh& mesh = scene.geometry.triangles;
+    double n = static_cast<double>(mesh.size());
+    double triangle_bytes = mesh.triangle_bytes() / n;
+    double vertex_bytes = mesh.vertex_bytes() / n;
+    double ref_bytes = sizeof(primitive_ref);
+    std::cout << obj_path << ": " << file_bytes / (1024.0 * 1024.0) << " MiB, " << mesh.size() << " triangles, "
+        << mesh.vertex_count() << " vertices, load " << obj_seconds << " s, " << n / obj_seconds / 1e6
+        << " M triangles/s, " << file_bytes / obj_seconds / (1024.0 * 1024.0) << " MiB/s\n";
+    std::cout << "  scene memory: " << triangle_bytes << " bytes/triangle (indices, material) + " << vertex_bytes
+        << " (vertices, normals) + " << ref_bytes << " (primitive ref) = " << triangle_bytes + vertex_bytes + ref_bytes
+        << " bytes/triangle\n";
+
+    if (!save_scene(scene, binary_path))
+        return;
+    {
+        mapped_file file(binary_path);
+        file_bytes = file.size();
+    }
+    benchmark_timer binary_timer;
+    scene_description loaded;
+    if (!load_scene(binary_path, loaded))
+        return;
+    double binary_seconds = binary_timer.seconds();
+    std::cout << binary_path << ": " << file_bytes / (1024.0 * 1024.0) << " MiB, load " << binary_seconds << " s, "
+        << n / binary_seconds / 1e6 << " M triangles/s\n";
+
+    linear_bvh bvh(scene.geometry);
+    const auto& st = bvh.build_stats();
+    std::cout << "linear_bvh: build " << st.build_ms << " ms, " << double(st.node_bytes) / n << " bytes/triangle nodes + "
+        << double(st.primitive_bytes) / n << " (leaf refs, triangle mirror); the vertex buffer is shared\n";
+    bench_trace("  trace", bvh, random_rays(500000));
+
+    std::remove(obj_path.c_str());
+    std::remove(binary_path.c_str());
+}
+
+void bench_instances() {
+    // A crowd of humanoids, once as one flat BVH over every sphere and once as instances of a
+    // single figure BVH under a top-level BVH. Both trace the same rays; hit counts must agree.
+    scene_geometry figure;
+    add_humanoid(figure, 0);
+    auto figure_bvh = make_shared<linear_bvh>(figure);
+    const sphere_soa& figure_spheres = figure.spheres;
+
+    for (int count : { 1000, 10000, 100000 }) {
+        seed_random(3);
+        int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        std::vector<transform> placements;
+        std::vector<real> scales;
+        for (int k = 0; k < count; k++) {
+            vec3 position((k % columns) * 3.0, 0, -(k / columns) * 3.0);
+            real size = real(random_double(0.85, 1.1));
+            placements.push_back(transform::translate(position) * transform::rotate(vec3(0, 1, 0), random_double(-45, 45))
+                * transform::scale(size));
+            scales.push_back(size);
+        }
+
+        scene_geometry flat;
+        flat.reserve(figure_spheres.size() * count);
+        for (int k = 0; k < count; k++) {
+            for (size_t i = 0; i < figure_spheres.size(); i++)
+                flat.add_sphere(placements[k].point(figure_spheres.start_center(i)), vec3(0, 0, 0),
+                    figure_spheres.get_radius(i) * scales[k], 0);
+        }
+        scene_geometry crowd;
+        crowd.instances.reserve(count);
+        for (int k = 0; k < count; k++)
+            crowd.add(instance(figure_bvh, placements[k]));
+
+        linear_bvh flat_bvh(flat);
+        linear_bvh crowd_bvh(crowd);
+        const auto& flat_stats = flat_bvh.build_stats();
+        const auto& crowd_stats = crowd_bvh.build_stats();
+        const auto& figure_stats = figure_bvh->build_stats();
+        double flat_bytes = double(flat.spheres.memory_bytes() + flat_stats.node_bytes + flat_stats.primitive_bytes);
+        double crowd_bytes = double(crowd.instances.capacity() * sizeof(instance) + crowd_stats.node_bytes
+            + crowd_stats.primitive_bytes + figure_stats.node_bytes + figure_stats.primitive_bytes);
+        std::cout << count << " humanoids (" << flat.size() << " spheres)\n";
+        std::cout << "  flat: build " << flat_stats.build_ms << " ms, " << flat_bytes / (1024 * 1024) << " MiB, "
+            << flat_bytes / count << " bytes/figure\n";
+        std::cout << "  instanced: top-level build " << crowd_stats.build_ms << " ms, " << crowd_bytes / (1024 * 1024)
+            << " MiB, " << crowd_bytes / count << " bytes/figure (" << sizeof(instance) << " per instance record)\n";
+
+        // Rays from just above the crowd, in every direction.
+        seed_random(5);
+        double extent = columns * 3.0;
+        std::vector<ray> rays;
+        for (int k = 0; k < 200000; k++) {
+            point3 origin(random_double(0, extent), random_double(1, 8), -random_double(0, extent));
+            rays.emplace_back(origin, random_unit_vector());
+        }
+        size_t flat_hits = bench_trace("  flat", flat_bvh, rays);
+        size_t crowd_hits = bench_trace("  instanced", crowd_bvh, rays);
+        // Grazing rays may round differently in object space; anything beyond that is a bug.
+        size_t difference = flat_hits > crowd_hits ? flat_hits - crowd_hits : crowd_hits - flat_hits;
+        if (difference > rays.size() / 10000)
+            std::cout << "  WARNING: hit counts differ by " << difference << "\n";
+    }
+}
+
+void bench_motion_blur() {
+    // Moving spheres traced with swept node boxes only, with node bounds always interpolated to the
+    // ray's time, and with whatever the build picks on its own (the default), at increasing speeds.
+    // Every ray has its own time, as camera rays do; hit counts must agree.
+    seed_random(6);
+    std::vector<ray> rays;
+    for (int k = 0; k < 100000; k++)
+        rays.emplace_back(vec3::random(-60, 60), random_unit_vector(), random_double());
+
+    bvh_build_options swept;
+    swept.motion_bounds = false;
+    swept.max_time_segments = 1;
+    bvh_build_options interpolated;
+    interpolated.motion_cost_ratio = infinity;
+    interpolated.max_time_segments = 1;
+    for (bool coherent : { false, true }) {
+        for (double speed : { 0.0, 1.0, 5.0, 20.0 }) {
+            scene_description scene;
+            moving_spheres_scene(scene, 100000, speed, coherent);
+            std::cout << "100000 spheres moving " << speed << " units " << (coherent ? "along +x" : "in random directions") << "\n";
+            linear_bvh swept_bvh(scene.geometry, swept);
+            linear_bvh interpolated_bvh(scene.geometry, interpolated);
+            linear_bvh automatic_bvh(scene.geometry);
+            const auto& st = automatic_bvh.build_stats();
+            std::cout << "  automatic: " << (st.motion_sah_cost > 0 ? "interpolated bounds, " : "")
+                << automatic_bvh.time_segment_count() << " time segment(s), build " << st.build_ms << " ms (swept "
+                << swept_bvh.build_stats().build_ms << " ms), " << double(st.node_bytes + st.primitive_bytes) / (1024 * 1024)
+                << " MiB; SAH cost swept " << swept_bvh.build_stats().sah_cost << ", interpolated "
+                << interpolated_bvh.build_stats().motion_sah_cost << "\n";
+            size_t swept_hits = bench_trace("  swept bounds", swept_bvh, rays);
+            size_t interpolated_hits = bench_trace("  interpolated bounds", interpolated_bvh, rays);
+            size_t automatic_hits = bench_trace("  automatic", automatic_bvh, rays);
+            // Interpolated bounds round differently from the moved sphere; only grazing rays may differ.
+            for (size_t hits : { interpolated_hits, automatic_hits }) {
+                size_t difference = swept_hits > hits ? swept_hits - hits : hits - swept_hits;
+                if (difference > rays.size() / 10000)
+                    std::cout << "  WARNING: hit counts differ by " << difference << "\n";
+            }
+        }
+    }
+}
+
+void bench_animation() {
+    // Twelve seconds of a walking crowd, sampled at 4 frames per second so the figures walk far
+    // enough past each other to wear the tree down. Every frame the tree is built from scratch,
+    // refitted without ever rebuilding, and refitted with partial rebuilds (the default); all three
+    // trace the same rays, which must hit the same spheres.
+    const int frames = 48;
+    bvh_build_options refit_only;
+    refit_only.refit_rebuild_ratio = infinity;
+
+    for (int count : { 1000, 10000 }) {
+        scene_description scene;
+        walking_crowd crowd(scene, count);
+        std::cout << count << " walking figures (" << scene.geometry.size() << " spheres), " << frames << " frames\n";
+
+        seed_random(8);
+        double extent = std::ceil(std::sqrt(static_cast<double>(count))) * 3;
+        std::vector<ray> rays;
+        for (int k = 0; k < 100000; k++) {
+            point3 origin(random_double(-extent / 2, extent / 2), random_double(1, 8), -random_double(0, extent));
+            rays.emplace_back(origin, random_unit_vector());
+        }
+
+        linear_bvh refitted(scene.geometry, refit_only);
+        linear_bvh adaptive(scene.geometry);
+        double build_ms = 0, refit_ms = 0, adaptive_ms = 0, worst_adaptive_ms = 0;
+        double rebuilt_trace = 0, refitted_trace = 0, adaptive_trace = 0, final_ratio = 1;
+        size_t subtrees = 0, primitives = 0, full_rebuilds = 0, mismatches = 0;
+        for (int frame = 1; frame <= frames; frame++) {
+            crowd.pose(scene.geometry, frame / 4.0);
+
+            benchmark_timer build_timer;
+            linear_bvh rebuilt(scene.geometry);
+            build_ms += build_timer.seconds() * 1e3;
+            bvh_refit_stats r = refitted.refit(scene.geometry);
+            refit_ms += r.refit_ms;
+            final_ratio = r.sah_ratio;
+            bvh_refit_stats a = adaptive.refit(scene.geometry);
+            adaptive_ms += a.refit_ms;
+            worst_adaptive_ms = std::max(worst_adaptive_ms, a.refit_ms);
+            subtrees += a.rebuilt_subtrees;
+            primitives += a.full_rebuild ? 0 : a.rebuilt_primitives;
+            full_rebuilds += a.full_rebuild;
+
+            size_t hits[3] = {};
+            const linear_bvh* trees[3] = { &rebuilt, &refitted, &adaptive };
+            double* trace_ms[3] = { &rebuilt_trace, &refitted_trace, &adaptive_trace };
+            for (int t = 0; t < 3; t++) {
+                benchmark_timer trace_timer;
+                hit_record rec;
+                for (const auto& ray : rays)
+                    hits[t] += trees[t]->hit(ray, interval(0.001, infinity), rec);
+                *trace_ms[t] += trace_timer.seconds() * 1e3;
+            }
+            mismatches += hits[1] != hits[0] || hits[2] != hits[0];
+        }
+
+        double mrays = rays.size() / 1e3;
+        std::cout << "  rebuild every frame: " << build_ms / frames << " ms build, "
+            << mrays / (rebuilt_trace / frames) << " Mrays/s\n";
+        std::cout << "  refit only: " << refit_ms / frames << " ms refit, " << mrays / (refitted_trace / frames)
+            << " Mrays/s, SAH cost x" << final_ratio << " by the last frame\n";
+        std::cout << "  refit + partial rebuild: " << adaptive_ms / frames << " ms (worst frame " << worst_adaptive_ms
+            << " ms), " << mrays / (adaptive_trace / frames) << " Mrays/s; " << subtrees << " subtrees / "
+            << primitives << " primitives rebuilt in place, " << full_rebuilds << " full rebuilds\n";
+        if (mismatches > 0)
+            std::cout << "  WARNING: hit counts differ in " << mismatches << " frames\n";
+    }
+}
+
+int run_benchmark(const std::string& name) {
+    if (name == "rng") {
+        bench_rng();
+        return 0;
+    }
+    if (name == "bvh") {
+        bench_bvh();
+        return 0;
+    }
+    if (name == "spheres") {
+        bench_spheres();
+        return 0;
+    }
+    if (name == "packets") {
+        bench_packets();
+        return 0;
+    }
+    if (name == "image") {
+        bench_image();
+        return 0;
+    }
+    if (name == "memory") {
+        bench_memory();
+        return 0;
+    }
+    if (name == "geometry") {
+        bench_geometry();
+        return 0;
+    }
+    if (name == "materials") {
+        bench_materials();
+        return 0;
+    }
+    if (name == "integrators") {
+        bench_integrators();
+        return 0;
+    }
+    if (name == "lights") {
+        bench_lights();
+        return 0;
+    }
+    if (name == "denoise") {
+        bench_denoise();
+        return 0;
+    }
+    if (name == "scene-load") {
+        bench_scene_load();
+        return 0;
+    }
+    if (name == "mesh-load") {
+        bench_mesh_load();
+        return 0;
+    }
+    if (name == "instances") {
+        bench_instances();
+        return 0;
+    }
+    if (name == "motion-blur") {
+        bench_motion_blur();
+        return 0;
+    }
+    if (name == "animation") {
+        bench_animation();
+        return 0;
+    }
+    if (name == "bvh-build") {
+        bench_bvh_build();
+        return 0;
+    }
+
+    std::cerr << "Unknown benchmark: " << name << "\n";
+    return 1;
+}
+
+#endif
@@ -3,14 +3,31 @@
 
 #include "Utilities.h"
 
+#include "Accumulation_buffer.h"
+#include "Aov_buffers.h"
 #include "Color.h"
 #include "Hittable.h"
+#include "Image.h"
+#include "Image_writer.h"
+#include "Lights.h"
 #include "Material.h"
-#include <fstream>
 #include <iostream>
 #include <string>
 #include "Ray.h"
-#include <iostream>
+#include "Render_stats.h"
+#include "Thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+enum class integrator_type {
+    recursive,  // ray_color() recursion up to max_depth bounces
+    iterative   // Loop carrying the path throughput, with Russian roulette after roulette_depth bounces
+};
 
 class camera {
 public:
@@ -25,45 +42,222 @@ public:
     double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
     int    samples_per_pixel = 10;   // Count of random samples for each pixel
 
+    int    thread_count = 0;     // Render threads (0 = all hardware threads, 1 = render on the calling thread)
+    int    tile_size = 32;       // Edge length in pixels of the square tiles handed to render threads
+    int    frame = 0;            // Frame index, folded into every sample's RNG seed
+    bool   use_packets = true;   // Trace primary rays as ray_packets; bounces are traced one by one
+    image_writer* writer = nullptr;  // If set, the image is encoded and written on the writer's thread
+    render_stats* stats = nullptr;   // If set, tile times, trace and output time and the counters are recorded here
+    thread_pool* pool = nullptr;     // If set, tiles run on this pool instead of one started for every render
+    // If set, render_image() calls this with the framebuffer and the bounds of every finished tile,
+    // from the thread that rendered it: callbacks for different tiles may run at the same time.
+    std::function<void(const image& framebuffer, int x0, int y0, int x1, int y1)> on_tile;
+    aov_buffers* aovs = nullptr;     // If set, render_image() also fills these with first-hit albedo, normal, depth and noise
+    integrator_type integrator = integrator_type::recursive;  // How the light along each camera ray is estimated
+    int    roulette_depth = 3;   // Iterative integrator: bounces before Russian roulette may end a path
+    const light_list* lights = nullptr;  // The scene's lights; if set and not empty, diffuse hits also sample them directly
+    bool   sample_lights = true;  // Clear to find lights by BSDF sampling alone, even with `lights` set
+    double roulette_threshold = 0.25;  // Iterative integrator: paths with a throughput above this always survive roulette
 
+    int    pass_samples = 8;          // Progressive renders: samples added to each pixel per pass
+    double checkpoint_seconds = 30;   // Progressive renders: minimum time between two checkpoints
+    const std::atomic<bool>* stop_request = nullptr;  // Progressive renders stop after the current pass once set
+
+    bool   adaptive = false;           // Stop sampling pixels whose noise estimate is below noise_threshold
+    int    adaptive_min_samples = 16;  // Adaptive: samples every pixel takes before its noise estimate is trusted
+    double noise_threshold = 0.004;    // Adaptive: target standard error of a pixel after gamma, in [0,1] display units
+    std::string heatmap_file;          // Adaptive: if set, an image of the per-pixel sample counts is written here
 
 
-    void render(const hittable& world, const std::string& filename = "output.ppm") {
-        initialize();
 
-        // Create output file stream
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not create file " << filename << std::endl;
+    // Renders the scene and writes it to `filename`; the extension picks the format
+    // (.ppm binary P6, .pfm float, .qoi compressed). Hit records index into `materials`.
+    void render(const hittable& world, const material_table& materials, const std::string& filename = "output.ppm") {
+        if (adaptive) {
+            render_progressive(world, materials, filename);
             return;
         }
+        save(render_image(world, materials), filename);
+    }
 
-        // Write PPM header to file instead of cout
-        file << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-        for (int j = 0; j < image_height; ++j) {
-            std::clog << "Scanlines remaining: " << (image_height - j) << "\n";
-            for (int i = 0; i < image_width; ++i) {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    // auto offset = sample_square();
-                    auto offset = vec3(0, 0, 0);
-                    auto pixel_center = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
-                    auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
-                    auto ray_direction = pixel_center - ray_origin;
-                    ray r(ray_origin, ray_direction);
-                    pixel_color += ray_color(r, max_depth, world);
-
-                    auto ray_time = random_double(); // Assumes random_double() returns a value in [0,1) or appropriate range
-                    ray r(ray_origin, ray_direction, ray_time);
+    // Renders every tile into a linear float framebuffer.
+    image render_image(const hittable& world, const material_table& materials) {
+        initialize();
+        scene_materials = &materials;
+        image framebuffer(image_width, image_height);
+        if (aovs) {
+            aovs->resize(image_width, image_height);
+            aovs->samples = samples_per_pixel;
+        }
+        render_tiles([&](const tile& t) {
+            int first[ray_packet::max_size] = {};
+            int count[ray_packet::max_size];
+            std::fill(count, count + ray_packet::max_size, samples_per_pixel);
+            sample_sum sums[ray_packet::max_size];
+            aov_sum first_hits[ray_packet::max_size];
+
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; i += ray_packet::max_size) {
+                    int n = std::min(ray_packet::max_size, t.x1 - i);
+                    render_pixel_group(i, n, j, first, count, world, sums, aovs ? first_hits : nullptr);
+                    for (int k = 0; k < n; k++)
+                        framebuffer.set(i + k, j, sums[k].sum / samples_per_pixel);
+                    if (aovs) {
+                        for (int k = 0; k < n; k++)
+                            store_aovs(i + k, j, sums[k], first_hits[k]);
+                    }
                 }
-                // Write color to file instead of cout
-                write_color(file, pixel_color / samples_per_pixel);
+            }
+            if (on_tile)
+                on_tile(framebuffer, t.x0, t.y0, t.x1, t.y1);
+        }, true);
+        return framebuffer;
+    }
+
+    // Renders in passes of `pass_samples` into an accumulation buffer until every pixel has
+    // `samples_per_pixel` samples (or, with `adaptive`, until every pixel has converged), then
+    // writes the image to `filename`. With a checkpoint path, a checkpoint written for the same
+    // settings is resumed from, and progress is saved back to it every `checkpoint_seconds`, when
+    // `stop_request` is raised, and at the end. Raising samples_per_pixel and rendering again
+    // continues from the finished checkpoint.
+    void render_progressive(const hittable& world, const material_table& materials, const std::string& filename,
+                            const std::string& checkpoint_path = "") {
+        initialize();
+        accumulation_buffer accum(image_width, image_height, settings_key());
+        if (!checkpoint_path.empty() && accum.load(checkpoint_path, image_width, image_height, settings_key()))
+            std::clog << "Resuming " << checkpoint_path << " at " << accum.min_samples() << " samples per pixel\n";
+
+        auto last_checkpoint = std::chrono::steady_clock::now();
+        std::vector<int> targets;
+        int active;
+        while ((active = next_targets(accum, targets)) > 0) {
+            if (stop_request && *stop_request) {
+                std::clog << "Stopping at " << accum.min_samples() << " samples per pixel\n";
+                break;
+            }
+
+            render_pass(world, materials, accum, targets);
+            if (adaptive)
+                std::clog << "Pixels sampled this pass: " << active << ", mean samples per pixel: " << mean_samples(accum) << "\n";
+            else
+                std::clog << "Samples per pixel: " << accum.min_samples() << "/" << samples_per_pixel << "\n";
+
+            auto now = std::chrono::steady_clock::now();
+            if (!checkpoint_path.empty() && std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_seconds) {
+                accum.save(checkpoint_path);
+                last_checkpoint = now;
             }
         }
 
-        file.close();
-        std::clog << "Done. Image saved as " << filename << "\n";
+        if (!checkpoint_path.empty() && accum.save(checkpoint_path))
+            std::clog << "Checkpoint saved as " << checkpoint_path << "\n";
+
+        if (adaptive) {
+            uint64_t budget = static_cast<uint64_t>(image_width) * image_height * samples_per_pixel;
+            std::clog << "Samples spent: " << accum.total_samples() << " of " << budget << " ("
+                      << 100.0 * accum.total_samples() / budget << "%), mean " << mean_samples(accum)
+                      << " per pixel\n";
+            if (!heatmap_file.empty())
+                save(accum.sample_heatmap(samples_per_pixel), heatmap_file);
+        }
+        save(accum.resolve(), filename);
+    }
+
+    // Adds samples to every pixel of `accum` until it has targets[y * width + x] of them. The
+    // buffer must have been created for this camera's image size.
+    void render_pass(const hittable& world, const material_table& materials, accumulation_buffer& accum,
+                     const std::vector<int>& targets) {
+        initialize();
+        scene_materials = &materials;
+        render_tiles([&](const tile& t) {
+            int first[ray_packet::max_size];
+            int count[ray_packet::max_size];
+            sample_sum sums[ray_packet::max_size];
+
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; i += ray_packet::max_size) {
+                    int n = std::min(ray_packet::max_size, t.x1 - i);
+                    for (int k = 0; k < n; k++) {
+                        first[k] = accum.samples(i + k, j);
+                        count[k] = std::max(0, targets[static_cast<size_t>(j) * image_width + i + k] - first[k]);
+                    }
+                    render_pixel_group(i, n, j, first, count, world, sums);
+                    for (int k = 0; k < n; k++)
+                        accum.add(i + k, j, sums[k]);
+                }
+            }
+        }, false);
+    }
+
+    // Height in pixels of the images this camera renders.
+    int output_height() const {
+        int height = static_cast<int>(image_width / aspect_ratio);
+        return height < 1 ? 1 : height;
+    }
+
+    // Why the image and view settings can't be rendered, or empty if they can. Scene loaders and
+    // the render server check settings from files and clients here before rendering with them.
+    std::string settings_error() const {
+        auto outside = [](double v, double lo, double hi) { return !(v >= lo && v <= hi); };
+        if (outside(aspect_ratio, 1e-3, 1e3))      return "aspect_ratio must be between 0.001 and 1000";
+        if (outside(image_width, 1, 16384))        return "image_width must be 1 to 16384";
+        if (outside(image_width / aspect_ratio, 0, 16384)) return "image_width / aspect_ratio, the image height, must be at most 16384";
+        if (outside(samples_per_pixel, 1, 1 << 20)) return "samples_per_pixel must be 1 to 1048576";
+        if (outside(max_depth, 0, 1 << 10))        return "max_depth must be 0 to 1024";
+        if (outside(vfov, 1e-3, 179.9))            return "vfov must be between 0.001 and 179.9";
+        if (outside(defocus_angle, 0, 180))        return "defocus_angle must be 0 to 180";
+        if (outside(focus_dist, 1e-6, 1e12))       return "focus_dist must be positive";
+        if (outside(tile_size, 1, 4096))           return "tile_size must be 1 to 4096";
+        return "";
+    }
+
+    // Takes samples [first_sample, first_sample + sample_count) of every pixel in [x0,x1) x [y0,y1)
+    // and returns their sums, row by row. The region is rendered in tiles like a whole image, and
+    // every sum is the one render_image() (all samples) or a render_pass() over the same samples
+    // computes for that pixel, so regions rendered anywhere merge into the same image.
+    std::vector<sample_sum> render_region(const hittable& world, const material_table& materials,
+                                          int x0, int y0, int x1, int y1, int first_sample, int sample_count) {
+        initialize();
+        scene_materials = &materials;
+        tile region = { std::max(x0, 0), std::max(y0, 0), std::min(x1, image_width), std::min(y1, image_height) };
+        if (region.x0 >= region.x1 || region.y0 >= region.y1)
+            return {};
+        int region_width = region.x1 - region.x0;
+        std::vector<sample_sum> sums(static_cast<size_t>(region_width) * (region.y1 - region.y0));
+        render_tiles([&](const tile& t) {
+            int first[ray_packet::max_size];
+            int count[ray_packet::max_size];
+            std::fill(first, first + ray_packet::max_size, first_sample);
+            std::fill(count, count + ray_packet::max_size, sample_count);
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; i += ray_packet::max_size) {
+                    int n = std::min(ray_packet::max_size, t.x1 - i);
+                    render_pixel_group(i, n, j, first, count, world,
+                        &sums[static_cast<size_t>(j - region.y0) * region_width + (i - region.x0)]);
+                }
+            }
+        }, false, region);
+        return sums;
+    }
+
+    // Hash of every setting that changes what a given sample computes. The scene itself is not
+    // covered, so resuming a checkpoint against an edited scene is the caller's responsibility.
+    uint64_t settings_key() const {
+        uint64_t key = splitmix64(static_cast<uint64_t>(frame));
+        auto mix = [&key](double v) {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            key = splitmix64(key ^ bits);
+        };
+        mix(aspect_ratio); mix(image_width); mix(max_depth); mix(vfov);
+        mix(lookfrom.x()); mix(lookfrom.y()); mix(lookfrom.z());
+        mix(lookat.x()); mix(lookat.y()); mix(lookat.z());
+        mix(vup.x()); mix(vup.y()); mix(vup.z());
+        mix(defocus_angle); mix(focus_dist);
+        mix(static_cast<double>(integrator)); mix(roulette_depth); mix(roulette_threshold);
+        if (light_sampling())
+            mix(static_cast<double>(lights->size()));
+        return key;
     }
 
 private:
@@ -75,10 +269,293 @@ private:
     vec3   u, v, w;              // Camera frame basis vectors
     vec3   defocus_disk_u;       // Defocus disk horizontal radius
     vec3   defocus_disk_v;       // Defocus disk vertical radius
-    
+    const material_table* scene_materials = nullptr;  // Materials of the scene being rendered
+
+    // Where a ray left a lambertian surface whose lights were sampled: what MIS needs to weigh
+    // light the ray finds.
+    struct diffuse_bounce {
+        point3 p;
+        double bsdf_pdf = 0;   // Solid-angle density of the scattered direction (cosine-weighted)
+
+        diffuse_bounce() = default;
+        diffuse_bounce(const hit_record& rec, const ray& scattered)
+            : p(rec.p), bsdf_pdf(std::max(0.0, double(dot(rec.normal, unit_vector(scattered.direction())))) / pi) {}
+    };
+
+    struct tile {
+        int x0, y0, x1, y1;  // Pixel bounds, half-open: [x0,x1) x [y0,y1)
+    };
+
+    int tile_edge() const { return tile_size > 0 ? tile_size : 32; }
+
+    std::vector<tile> make_tiles(const tile& region) const {
+        int edge = tile_edge();
+        std::vector<tile> tiles;
+        for (int y = region.y0; y < region.y1; y += edge) {
+            for (int x = region.x0; x < region.x1; x += edge) {
+                tiles.push_back({ x, y, std::min(x + edge, region.x1), std::min(y + edge, region.y1) });
+            }
+        }
+        return tiles;
+    }
+
+    // Runs `render_tile` for every tile of the image.
+    void render_tiles(const std::function<void(const tile&)>& render_tile, bool report_tiles) const {
+        render_tiles(render_tile, report_tiles, { 0, 0, image_width, image_height });
+    }
+
+    // Runs `render_tile` for every tile of `region`, on the calling thread or spread over a thread
+    // pool (`pool`, or one started for this call).
+    void render_tiles(const std::function<void(const tile&)>& render_tile, bool report_tiles, const tile& region) const {
+        auto tiles = make_tiles(region);
+        std::atomic<int> tiles_remaining{ static_cast<int>(tiles.size()) };
+        std::mutex log_mutex;
+        auto start_time = std::chrono::steady_clock::now();
+        if (stats)
+            stats->begin(image_width, image_height, tile_edge());
+
+        auto run_tile = [&](const tile& t) {
+            if (stats) {
+                // The thread's counters only ever grow; what they gained during the tile is its share.
+                render_counters before = render_counters::local();
+                auto tile_start = std::chrono::steady_clock::now();
+                render_tile(t);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count();
+                render_counters gained = render_counters::local();
+                gained.merge(before, -1);
+                stats->add_tile(t.x0, t.y0, t.x1, t.y1, seconds, gained);
+            }
+            else {
+                render_tile(t);
+            }
+            int remaining = --tiles_remaining;
+            if (report_tiles) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::clog << "Tiles remaining: " << remaining << "\n";
+            }
+        };
+
+        if (pool) {
+            task_group group(*pool);
+            for (const auto& t : tiles)
+                group.run([&run_tile, t] { run_tile(t); });
+            group.wait();
+        }
+        else if (thread_count == 1) {
+            for (const auto& t : tiles)
+                run_tile(t);
+        }
+        else {
+            thread_pool render_pool(thread_count);
+            for (const auto& t : tiles)
+                render_pool.submit([&run_tile, t] { run_tile(t); });
+            render_pool.wait_idle();
+        }
+
+        if (stats)
+            stats->trace_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    // Takes samples [first[k], first[k] + count[k]) of pixel (i0 + k, j) for each of the `n` pixels.
+    // With `first_hits`, the first-hit data of the samples is summed there as well.
+    void render_pixel_group(int i0, int n, int j, const int* first, const int* count,
+                            const hittable& world, sample_sum* out, aov_sum* first_hits = nullptr) const {
+        for (int k = 0; k < n; k++) {
+            out[k] = sample_sum();
+            if (first_hits)
+                first_hits[k] = aov_sum();
+        }
+
+        if (!use_packets) {
+            for (int k = 0; k < n; k++)
+                out[k] = render_pixel(i0 + k, j, first[k], count[k], world, first_hits ? &first_hits[k] : nullptr);
+            return;
+        }
+        render_packet_group(i0, n, j, first, count, world, out, first_hits);
+    }
+
+    sample_sum render_pixel(int i, int j, int first, int count, const hittable& world, aov_sum* first_hit = nullptr) const {
+        auto pixel_index = static_cast<uint64_t>(j) * image_width + i;
+
+        sample_sum pixel;
+        for (int sample = first; sample < first + count; sample++) {
+            // Seed per sample so the image is identical no matter which thread renders which tile.
+            seed_sample(pixel_index, sample, frame);
+            ray r = get_ray(i, j);
+            if (first_hit) {
+                // An extra intersection; it draws no random numbers, so the color is unchanged.
+                hit_record rec;
+                bool hit = max_depth > 0 && world.hit(r, trace_interval(), rec);
+                add_first_hit(*first_hit, r, hit, rec);
+            }
+            pixel.add(trace(r, world));
+        }
+        return pixel;
+    }
+
+    void add_first_hit(aov_sum& sum, const ray& r, bool hit, const hit_record& rec) const {
+        if (!hit) {
+            sum.add(background(r), -unit_vector(r.direction()), 0);
+            return;
+        }
+        const material& m = (*scene_materials)[rec.material_id];
+        bool white = m.type() == material_type::dielectric || m.type() == material_type::diffuse_light;
+        color albedo = white ? color(1, 1, 1) : m.get_albedo();
+        sum.add(albedo, rec.normal, rec.t * r.direction().length());
+    }
+
+    void store_aovs(int i, int j, const sample_sum& pixel, const aov_sum& first_hit) const {
+        double n = pixel.count;
+        size_t index = static_cast<size_t>(j) * image_width + i;
+        aovs->albedo.set(i, j, first_hit.albedo / n);
+        vec3 normal = first_hit.normal;
+        aovs->normal.set(i, j, normal.length_squared() > 0 ? unit_vector(normal) : normal);
+        aovs->depth[index] = static_cast<float>(first_hit.depth / n);
+        // Variance of the mean: the sample variance over the sample count.
+        double variance = 0;
+        if (pixel.count > 1) {
+            double mean_y = luminance(pixel.sum) / n;
+            variance = std::max(0.0, (pixel.luminance_sq - n * mean_y * mean_y) / (n - 1)) / n;
+        }
+        aovs->variance[index] = static_cast<float>(variance);
+    }
+
+    // Same as render_pixel() for up to ray_packet::max_size neighbouring pixels, tracing the
+    // primary rays of each sample round as one packet. Every lane keeps its own RNG stream, so the
+    // result matches render_pixel() exactly.
+    void render_packet_group(int i0, int n, int j, const int* first, const int* count,
+                             const hittable& world, sample_sum* out, aov_sum* first_hits = nullptr) const {
+        rng_engine streams[ray_packet::max_size];
+        int rounds = 0;
+        for (int k = 0; k < n; k++)
+            rounds = std::max(rounds, count[k]);
+
+        for (int s = 0; s < rounds; s++) {
+            ray_packet packet;
+            int lane_pixel[ray_packet::max_size];
+            for (int k = 0; k < n; k++) {
+                if (s >= count[k])
+                    continue;
+                seed_sample(static_cast<uint64_t>(j) * image_width + i0 + k, first[k] + s, frame);
+                lane_pixel[packet.count] = k;
+                packet.add(get_ray(i0 + k, j), trace_interval());
+                streams[packet.count - 1] = thread_rng();
+            }
+
+            packet_hits hits;
+            if (max_depth > 0) {
+                ORACLE_STAT(render_counters::local().rays[0] += packet.count);
+                world.hit_packet(packet, hits);
+            }
+
+            for (int lane = 0; lane < packet.count; lane++) {
+                thread_rng() = streams[lane];
+                if (first_hits)
+                    add_first_hit(first_hits[lane_pixel[lane]], packet.rays[lane], max_depth > 0 && hits.hit[lane], hits.rec[lane]);
+                if (max_depth <= 0) {
+                    ORACLE_STAT(render_counters::local().max_depth_paths++);
+                    out[lane_pixel[lane]].add(color(0, 0, 0));
+                    continue;
+                }
+                out[lane_pixel[lane]].add(hits.hit[lane]
+                    ? trace_hit(packet.rays[lane], hits.rec[lane], world)
+                    : background(packet.rays[lane]));
+            }
+        }
+    }
+
+    // Fills `targets` with the sample count each pixel should reach in the next pass and returns
+    // how many pixels need more samples. Without `adaptive` every pixel advances by pass_samples up
+    // to samples_per_pixel. With it, a pixel first takes adaptive_min_samples and then keeps
+    // sampling only while it or one of its eight neighbours is above the noise threshold; the
+    // neighbourhood keeps isolated unlucky pixels from stopping early.
+    int next_targets(const accumulation_buffer& accum, std::vector<int>& targets) const {
+        targets.assign(static_cast<size_t>(image_width) * image_height, 0);
+
+        std::vector<uint8_t> noisy;
+        if (adaptive) {
+            noisy.resize(targets.size());
+            for (int j = 0; j < image_height; j++) {
+                for (int i = 0; i < image_width; i++)
+                    noisy[static_cast<size_t>(j) * image_width + i] = !pixel_converged(accum, i, j);
+            }
+        }
+
+        int active = 0;
+        for (int j = 0; j < image_height; j++) {
+            for (int i = 0; i < image_width; i++) {
+                int have = accum.samples(i, j);
+                int want = std::min(samples_per_pixel, have + pass_samples);
+
+                if (adaptive) {
+                    if (have < adaptive_min_samples) {
+                        want = std::min(samples_per_pixel, adaptive_min_samples);
+                    }
+                    else {
+                        bool sample = false;
+                        for (int y = std::max(0, j - 1); y <= std::min(image_height - 1, j + 1) && !sample; y++) {
+                            for (int x = std::max(0, i - 1); x <= std::min(image_width - 1, i + 1); x++)
+                                sample |= noisy[static_cast<size_t>(y) * image_width + x] != 0;
+                        }
+                        if (!sample)
+                            want = have;
+                    }
+                }
+
+                targets[static_cast<size_t>(j) * image_width + i] = std::max(want, have);
+                active += want > have;
+            }
+        }
+        return active;
+    }
+
+    bool pixel_converged(const accumulation_buffer& accum, int i, int j) const {
+        int n = accum.samples(i, j);
+        if (n < adaptive_min_samples)
+            return false;
+        // Standard error of the mean luminance, carried through the display gamma: the error the
+        // viewer sees in a dark pixel is much larger than the same absolute error in a bright one.
+        double mean = std::max(0.0, luminance(accum.mean(i, j)));
+        double error = std::sqrt(accum.luminance_variance(i, j) / n);
+        return linear_to_gamma(mean + error) - linear_to_gamma(mean) < noise_threshold;
+    }
+
+    static double mean_samples(const accumulation_buffer& accum) {
+        return static_cast<double>(accum.total_samples()) / (static_cast<double>(accum.width()) * accum.height());
+    }
+
+    void save(image framebuffer, const std::string& filename) const {
+        if (writer) {
+            writer->submit(std::move(framebuffer), filename);
+            std::clog << "Done. Queued " << filename << " for writing\n";
+        }
+        else {
+            auto start = std::chrono::steady_clock::now();
+            bool written = write_image(framebuffer, filename);
+            if (stats)
+                stats->output_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (written)
+                std::clog << "Done. Image saved as " << filename << "\n";
+        }
+    }
+
+    ray get_ray(int i, int j) const {
+        // auto offset = sample_square();
+        auto offset = vec3(0, 0, 0);
+        auto pixel_center = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
+        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+        auto ray_direction = pixel_center - ray_origin;
+        auto ray_time = random_double(); // Assumes random_double() returns a value in [0,1) or appropriate range
+        return ray(ray_origin, ray_direction, ray_time);
+    }
+
+    static interval trace_interval() {
+        // Valid hit distances for every ray; the small minimum (see Precision.h) avoids self-intersection.
+        return interval(precision<real>::ray_t_min, infinity);
+    }
+
     void initialize() {
-        image_height = static_cast<int>(image_width / aspect_ratio);
-        image_height = (image_height < 1) ? 1 : image_height;
+        image_height = output_height();
 
         center = lookfrom;
 
@@ -126,24 +603,152 @@ private:
         return vec3(random_double() - 0.5, random_double() - 0.5, 0);
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const {
+    // Light arriving along a camera ray, estimated with the selected integrator.
+    color trace(const ray& r, const hittable& world) const {
+        if (integrator == integrator_type::iterative)
+            return trace_path(r, nullptr, world);
+        return ray_color(r, max_depth, world);
+    }
+
+    // Same as trace() for a camera ray whose first hit is already known.
+    color trace_hit(const ray& r, const hit_record& rec, const hittable& world) const {
+        if (integrator == integrator_type::iterative)
+            return trace_path(r, &rec, world);
+        return shade_hit(r, rec, max_depth, world);
+    }
+
+    // Iterative path tracer. Instead of multiplying attenuations on the way back up a recursion, the
+    // product of all attenuations so far (the throughput) is carried forward. From roulette_depth
+    // bounces on, a path whose brightest throughput channel has dropped below roulette_threshold
+    // survives each bounce with probability throughput / threshold and is reweighted by 1/p when
+    // it does, which ends dim paths early without bias. Killing paths more eagerly (survival equal
+    // to the throughput itself) quadrupled the error at equal time in sky-lit scenes, where most
+    // of the light arrives at the end of a path. Without roulette it takes the same bounces and
+    // random numbers as ray_color().
+    color trace_path(ray r, const hit_record* first_hit, const hittable& world) const {
+        color throughput(1, 1, 1);
+        color radiance(0, 0, 0);
+        diffuse_bounce from;
+        bool from_diffuse = false;
+
+        for (int bounce = 0; bounce < max_depth; bounce++) {
+            hit_record rec;
+            if (bounce == 0 && first_hit) {
+                rec = *first_hit;
+            }
+            else {
+                ORACLE_STAT(render_counters::local().count_ray(bounce));
+                if (!world.hit(r, trace_interval(), rec))
+                    return radiance + throughput * background(r);
+            }
+
+            const material& m = (*scene_materials)[rec.material_id];
+            radiance += throughput * emitted(r, rec, m, from_diffuse ? &from : nullptr);
+            ray scattered;
+            color attenuation;
+            if (!m.scatter(r, rec, attenuation, scattered))
+                return radiance;
+            from_diffuse = light_sampling() && m.type() == material_type::lambertian;
+            if (from_diffuse) {
+                radiance += throughput * direct_light(r, rec, attenuation, world);
+                from = diffuse_bounce(rec, scattered);
+            }
+            throughput = throughput * attenuation;
+            r = scattered;
+
+            if (bounce + 1 >= roulette_depth) {
+                double brightest = std::max(throughput.x(), std::max(throughput.y(), throughput.z()));
+                double survive = std::min(1.0, brightest / roulette_threshold);
+                if (random_double() >= survive)
+                    return radiance;
+                throughput = throughput / survive;
+            }
+        }
+        ORACLE_STAT(render_counters::local().max_depth_paths++);
+        return radiance;
+    }
+
+    color ray_color(const ray& r, int depth, const hittable& world, const diffuse_bounce* from = nullptr) const {
         hit_record rec;
 
         if (depth == 0) {
+            ORACLE_STAT(render_counters::local().max_depth_paths++);
             return color(0, 0, 0);
         }
 
-        if (world.hit(r, interval(0.000001, infinity), rec)) {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered)) {
-                return attenuation * ray_color(scattered, depth - 1, world);
-            }
-            else {
-                return color(0, 0, 0);
+        ORACLE_STAT(render_counters::local().count_ray(max_depth - depth));
+        if (world.hit(r, trace_interval(), rec)) {
+            return shade_hit(r, rec, depth, world, from);
+        }
+
+        return background(r);
+    }
+
+    color shade_hit(const ray& r, const hit_record& rec, int depth, const hittable& world, const diffuse_bounce* from = nullptr) const {
+        const material& m = (*scene_materials)[rec.material_id];
+        color emission = emitted(r, rec, m, from);
+        ray scattered;
+        color attenuation;
+        if (m.scatter(r, rec, attenuation, scattered)) {
+            if (light_sampling() && m.type() == material_type::lambertian) {
+                diffuse_bounce here(rec, scattered);
+                color direct = direct_light(r, rec, attenuation, world);
+                return emission + direct + attenuation * ray_color(scattered, depth - 1, world, &here);
             }
+            return emission + attenuation * ray_color(scattered, depth - 1, world);
         }
+        return emission;
+    }
+
+    // Next-event estimation. Light reaches a diffuse surface either along the scattered ray (BSDF
+    // sampling) or along a shadow ray toward a light picked from `lights`. Both are kept and
+    // weighted with the power heuristic of multiple importance sampling (Veach 1997): each
+    // estimate counts in proportion to its squared density, so small, bright lights are found
+    // by shadow rays and large ones (or glossy bounces toward them) by the BSDF, without either
+    // being counted twice.
+    bool light_sampling() const {
+        return sample_lights && lights && !lights->empty();
+    }
+
+    // Light emitted at `rec` toward the ray. After a diffuse bounce whose lights were sampled, the
+    // part a shadow ray could have found as well is weighted down.
+    color emitted(const ray& r, const hit_record& rec, const material& m, const diffuse_bounce* from) const {
+        if (m.type() != material_type::diffuse_light)
+            return color(0, 0, 0);
+        color emission = m.emitted();
+        if (!from)
+            return emission;
+        double light_pdf = lights->pdf(from->p, r.time(), rec.p);
+        return emission * static_cast<real>(power_heuristic(from->bsdf_pdf, light_pdf));
+    }
+
+    // One shadow ray toward a light picked for the lambertian hit `rec` with albedo `albedo`.
+    color direct_light(const ray& r, const hit_record& rec, const color& albedo, const hittable& world) const {
+        light_sample s;
+        if (!lights->sample(rec.p, r.time(), s))
+            return color(0, 0, 0);
+        double cos_theta = dot(rec.normal, s.direction);
+        if (cos_theta <= 0 || !(s.pdf > 0))
+            return color(0, 0, 0);
+        ORACLE_STAT(render_counters::local().shadow_rays++);
+        hit_record blocker;
+        ray shadow(rec.p, s.direction, r.time());
+        // Stop just short of the light, so its own surface doesn't count as a blocker.
+        double reach = s.distance * (1 - 1e-4);
+        if (world.hit(shadow, interval(precision<real>::ray_t_min, static_cast<real>(reach)), blocker))
+            return color(0, 0, 0);
+        double bsdf_pdf = cos_theta / pi;
+        // Lambertian BSDF albedo/pi times the cosine, over the light's density.
+        double weight = power_heuristic(s.pdf, bsdf_pdf) * bsdf_pdf / s.pdf;
+        return albedo * s.emission * static_cast<real>(weight);
+    }
+
+    static double power_heuristic(double pdf, double other_pdf) {
+        double a = pdf * pdf, b = other_pdf * other_pdf;
+        return a + b > 0 ? a / (a + b) : 0;
+    }
 
+    static color background(const ray& r) {
         vec3 unit_direction = unit_vector(r.direction());
         auto a = 0.5 * (unit_direction.y() + 1.0);
         return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
@@ -10,12 +10,37 @@ double linear_to_gamma(double linear_component)
     return sqrt(linear_component);
 }
 
+inline int component_to_byte(double linear_component) {
+    // Translates a linear color component to the gamma-encoded [0,255] range.
+    static const interval intensity(0.000, 0.999);
+    return static_cast<int>(256 * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
+inline double luminance(const color& c) {
+    // Rec. 709 weights on linear RGB.
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// False-color ramp for t in [0,1], from dark blue through cyan, green and yellow to red. The
+// result is linear: it shows the ramp colors once an encoder has gamma-encoded it.
+inline color heatmap_color(double t) {
+    static const color ramp[] = {
+        color(0.0, 0.0, 0.2), color(0.0, 0.6, 1.0), color(0.1, 0.9, 0.2), color(1.0, 0.9, 0.0), color(1.0, 0.1, 0.0)
+    };
+    const int last = static_cast<int>(sizeof(ramp) / sizeof(ramp[0])) - 1;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    int k = static_cast<int>(t * last);
+    k = k < last - 1 ? k : last - 1;
+    double f = t * last - k;
+    color c = (1 - f) * ramp[k] + f * ramp[k + 1];
+    return c * c;
+}
+
 void write_color(std::ostream& out, color pixel_color) {
     // Write the translated [0,255] value of each color component.
-    static const interval intensity(0.000, 0.999);
-    out << static_cast<int>(256 * intensity.clamp(linear_to_gamma(pixel_color.x()))) << ' '
-        << static_cast<int>(256 * intensity.clamp(linear_to_gamma(pixel_color.y()))) << ' '
-        << static_cast<int>(256 * intensity.clamp(linear_to_gamma(pixel_color.z()))) << '\n';
+    out << component_to_byte(pixel_color.x()) << ' '
+        << component_to_byte(pixel_color.y()) << ' '
+        << component_to_byte(pixel_color.z()) << '\n';
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,356 @@
+#ifndef DEMO_SCENES_H
+#define DEMO_SCENES_H
+
+#include "Camera.h"
+#include "Instance.h"
+#include "Linear_BVH.h"
+#include "Material.h"
+#include "Scene_file.h"
+#include "Sphere.h"
+#include "Utilities.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Scenes built in code: the renderer's default scene and the scenarios of the benchmark suite.
+// Each one fills an empty scene_description, camera included.
+
+// The humanoid figure of the built-in scene: 12 spheres around the y axis, torso at y = 1.5.
+inline void add_humanoid(scene_geometry& geometry, uint32_t humanoid_material) {
+    // Scale factor to make the humanoid larger
+    double scale = 2.5;
+
+    // Base center of the humanoid, raised to be more central in the view
+    point3 base_center(0, 1.5, 0);
+
+    // Head (scaled radius)
+    geometry.add(sphere(base_center + vec3(0, 0.6, 0) * scale, 0.25 * scale, humanoid_material));
+
+    // Torso (combined into one larger sphere for simplicity)
+    geometry.add(sphere(base_center, 0.4 * scale, humanoid_material));
+
+    // --- MODIFICATIONS START ---
+
+    // --- Arms ---
+    // Using a three-sphere structure for more connected limbs.
+    // Base z-offset for arms to bring them forward toward the camera.
+    double arm_z_offset_base = 0.1;
+
+    // Left arm (Shoulder -> Bicep -> Forearm)
+    geometry.add(sphere(base_center + (vec3(-0.30, 0.20, arm_z_offset_base) * scale), 0.12 * scale, humanoid_material)); // Shoulder
+    geometry.add(sphere(base_center + (vec3(-0.32, 0.04, arm_z_offset_base) * scale), 0.11 * scale, humanoid_material)); // Bicep
+    geometry.add(sphere(base_center + (vec3(-0.35, -0.15, arm_z_offset_base) * scale), 0.10 * scale, humanoid_material)); // Forearm
+
+    // Right arm (Shoulder -> Bicep -> Forearm)
+    geometry.add(sphere(base_center + (vec3(0.30, 0.20, arm_z_offset_base) * scale), 0.12 * scale, humanoid_material));  // Shoulder
+    geometry.add(sphere(base_center + (vec3(0.32, 0.04, arm_z_offset_base) * scale), 0.11 * scale, humanoid_material));  // Bicep
+    geometry.add(sphere(base_center + (vec3(0.35, -0.15, arm_z_offset_base) * scale), 0.10 * scale, humanoid_material));  // Forearm
+
+    // --- Legs ---
+    // Added a z-offset to bring legs forward
+    double leg_z_offset_base = 0.05;
+
+    // Left leg
+    geometry.add(sphere(base_center + (vec3(-0.15, -0.5, leg_z_offset_base) * scale), 0.15 * scale, humanoid_material)); // Thigh
+    geometry.add(sphere(base_center + (vec3(-0.15, -0.9, leg_z_offset_base) * scale), 0.14 * scale, humanoid_material)); // Shin
+
+    // Right leg
+    geometry.add(sphere(base_center + (vec3(0.15, -0.5, leg_z_offset_base) * scale), 0.15 * scale, humanoid_material));  // Thigh
+    geometry.add(sphere(base_center + (vec3(0.15, -0.9, leg_z_offset_base) * scale), 0.14 * scale, humanoid_material)); // Shin
+  /*  auto center2 = center + vec3(0, random_double(0, .5), 0);
+    geometry.add(sphere(center, center2, 0.2, sphere_material)); */// for move spheres
+    // --- MODIFICATIONS END ---
+}
+
+// The built-in scene: a metal humanoid on a large ground sphere, seen from the front.
+inline void humanoid_scene(scene_description& scene) {
+    auto ground_material = scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    scene.geometry.add(sphere(point3(0, -1000, 0), 1000, ground_material));
+
+    point3 base_center(0, 1.5, 0);
+    auto humanoid_material = scene.materials.add(metal(color(0.8, 0.6, 0.4), 0.1));
+    add_humanoid(scene.geometry, humanoid_material);
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 800; // Using the image width from your latest code
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 50;
+
+    cam.vfov = 60; // Widened field of view to see the whole humanoid
+    cam.lookfrom = point3(0, 1.5, 4); // Moved camera closer and centered
+    cam.lookat = base_center; // Look directly at the humanoid's torso
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.1;
+    cam.focus_dist = (cam.lookfrom - cam.lookat).length(); // Set focus distance to the humanoid
+}
+
+// A crowd of `count` humanoids on a grid. The figure is built once into a bottom-level BVH and
+// placed by instances with their own turn, size and material, so the scene holds `count` small
+// instance records rather than 12 spheres per figure.
+inline void crowd_scene(scene_description& scene, int count, uint64_t seed = 3) {
+    seed_random(seed);
+    uint32_t ground = scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    scene.geometry.add(sphere(point3(0, -1000, 0), 1000, ground));
+
+    scene_geometry figure;
+    add_humanoid(figure, scene.materials.add(metal(color(0.8, 0.6, 0.4), 0.1)));
+    auto figure_bvh = make_shared<linear_bvh>(figure);
+
+    uint32_t palette[6];
+    for (int k = 0; k < 4; k++)
+        palette[k] = scene.materials.add(lambertian(color::random(0.2, 0.9)));
+    palette[4] = scene.materials.add(metal(color(0.8, 0.6, 0.4), 0.1));
+    palette[5] = scene.materials.add(metal(color(0.8, 0.8, 0.8), 0.05));
+
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    int rows = (count + columns - 1) / columns;
+    double spacing = 3;
+    for (int k = 0; k < count; k++) {
+        int row = k / columns, column = k % columns;
+        vec3 position((column - (columns - 1) / 2.0) * spacing + random_double(-0.5, 0.5), 0,
+            -row * spacing + random_double(-0.5, 0.5));
+        transform placement = transform::translate(position) * transform::rotate(vec3(0, 1, 0), random_double(-45, 45))
+            * transform::scale(real(random_double(0.85, 1.1)));
+        scene.geometry.add(instance(figure_bvh, placement, palette[random_int(0, 5)]));
+    }
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 16;
+    cam.vfov = 50;
+    cam.lookfrom = point3(0, 4 + rows * 0.25, 10);
+    cam.lookat = point3(0, 1.5, -rows * spacing / 3);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+}
+
+// A crowd of humanoids walking across the ground: the animated scene. The figures are plain
+// spheres rather than instances, so every limb is a primitive of the scene's BVH. pose() puts the
+// spheres where they are at a given time: arms and legs swing about the shoulders and hips while
+// each figure walks along its own heading, so figures pass each other and the neighbourhoods the
+// BVH grouped them by slowly break up.
+class walking_crowd {
+public:
+    walking_crowd(scene_description& scene, int count, uint64_t seed = 7) {
+        seed_random(seed);
+        uint32_t ground = scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+        scene.geometry.add(sphere(point3(0, -1000, 0), 1000, ground));
+
+        add_humanoid(figure, 0);
+        uint32_t palette[6];
+        for (int k = 0; k < 4; k++)
+            palette[k] = scene.materials.add(lambertian(color::random(0.2, 0.9)));
+        palette[4] = scene.materials.add(metal(color(0.8, 0.6, 0.4), 0.1));
+        palette[5] = scene.materials.add(metal(color(0.8, 0.8, 0.8), 0.05));
+
+        int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        int rows = (count + columns - 1) / columns;
+        first_sphere = scene.geometry.spheres.size();
+        scene.geometry.reserve(scene.geometry.size() + count * figure.spheres.size());
+        for (int k = 0; k < count; k++) {
+            walker w;
+            w.start = vec3((k % columns - (columns - 1) / 2.0) * spacing, 0, -(k / columns) * spacing);
+            w.heading = random_double(0, 360);
+            w.phase = random_double();
+            w.material = palette[random_int(0, 5)];
+            walkers.push_back(w);
+            for (size_t i = 0; i < figure.spheres.size(); i++)
+                scene.geometry.add_sphere(point3(0, 0, 0), vec3(0, 0, 0), figure.spheres.get_radius(i), w.material);
+        }
+        pose(scene.geometry, 0);
+
+        camera& cam = scene.cam;
+        cam.aspect_ratio = 16.0 / 9.0;
+        cam.image_width = 400;
+        cam.samples_per_pixel = 16;
+        cam.max_depth = 16;
+        cam.vfov = 50;
+        cam.lookfrom = point3(0, 4 + rows * 0.25, 10);
+        cam.lookat = point3(0, 1.5, -rows * spacing / 3);
+        cam.vup = vec3(0, 1, 0);
+        cam.defocus_angle = 0;
+    }
+
+    // Moves every figure's spheres to their places at `time`, in seconds.
+    void pose(scene_geometry& geometry, double time) const {
+        const double pi = 3.14159265358979323846;
+        for (size_t k = 0; k < walkers.size(); k++) {
+            const walker& w = walkers[k];
+            double swing = 30 * std::sin(2 * pi * (stride_rate * time + w.phase));
+            transform placement = transform::translate(w.start) * transform::rotate(vec3(0, 1, 0), w.heading)
+                * transform::translate(vec3(0, 0, walk_speed * time));
+            // Arms swing against the leg on their side.
+            transform limbs[4] = {
+                swing_about(shoulder(-1), swing), swing_about(shoulder(1), -swing),
+                swing_about(hip(-1), -swing), swing_about(hip(1), swing)
+            };
+            for (size_t i = 0; i < figure.spheres.size(); i++) {
+                point3 center = figure.spheres.start_center(i);
+                if (i >= 2)
+                    center = limbs[i < 5 ? 0 : i < 8 ? 1 : i < 10 ? 2 : 3].point(center);
+                size_t index = first_sphere + k * figure.spheres.size() + i;
+                geometry.spheres.set(index, placement.point(center), vec3(0, 0, 0), figure.spheres.get_radius(i), w.material);
+            }
+        }
+    }
+
+private:
+    struct walker {
+        vec3 start;
+        double heading;     // Degrees about +y; 0 walks toward +z
+        double phase;       // Offset into the stride cycle
+        uint32_t material;
+    };
+
+    static constexpr double spacing = 3;
+    static constexpr double walk_speed = 1.2;   // Units per second
+    static constexpr double stride_rate = 0.8;  // Stride cycles per second
+
+    scene_geometry figure;     // add_humanoid's spheres: head, torso, left arm (3), right arm (3), left leg (2), right leg (2)
+    size_t first_sphere = 0;
+    std::vector<walker> walkers;
+
+    static point3 shoulder(int side) { return point3(side * 0.75, 2.0, 0.25); }
+    static point3 hip(int side) { return point3(side * 0.375, 0.75, 0.125); }
+
+    static transform swing_about(const point3& pivot, double degrees) {
+        return transform::translate(pivot) * transform::rotate(vec3(1, 0, 0), degrees) * transform::translate(-pivot);
+    }
+};
+
+// `count` spheres scattered through a 100^3 box, seen from outside the box. Mostly diffuse with
+// some metal; a stress test for BVH build and traversal at scale.
+inline void random_spheres_scene(scene_description& scene, int count, uint64_t seed = 1) {
+    seed_random(seed);
+    uint32_t palette[10];
+    for (int k = 0; k < 8; k++)
+        palette[k] = scene.materials.add(lambertian(color::random(0.2, 0.9)));
+    palette[8] = scene.materials.add(metal(color(0.8, 0.8, 0.8), 0.05));
+    palette[9] = scene.materials.add(metal(color(0.9, 0.6, 0.3), 0.3));
+
+    scene.geometry.reserve(count);
+    for (int k = 0; k < count; k++) {
+        point3 center = vec3::random(-50, 50);
+        scene.geometry.add_sphere(center, vec3(0, 0, 0), random_double(0.05, 0.5), palette[random_int(0, 9)]);
+    }
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 16;
+    cam.vfov = 60;
+    cam.lookfrom = point3(0, 0, 110);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+}
+
+// The random_spheres_scene layout with every sphere moving `speed` units over the shutter
+// interval, each in its own random direction or, with `coherent`, all along +x. Random directions
+// are the hard case for motion blur: the swept boxes of the BVH overlap heavily.
+inline void moving_spheres_scene(scene_description& scene, int count, double speed, bool coherent = false,
+    uint64_t seed = 4)
+{
+    seed_random(seed);
+    uint32_t palette[10];
+    for (int k = 0; k < 8; k++)
+        palette[k] = scene.materials.add(lambertian(color::random(0.2, 0.9)));
+    palette[8] = scene.materials.add(metal(color(0.8, 0.8, 0.8), 0.05));
+    palette[9] = scene.materials.add(metal(color(0.9, 0.6, 0.3), 0.3));
+
+    scene.geometry.reserve(count);
+    for (int k = 0; k < count; k++) {
+        point3 center = vec3::random(-50, 50);
+        vec3 motion = speed * (coherent ? vec3(1, 0, 0) : random_unit_vector());
+        scene.geometry.add_sphere(center, motion, random_double(0.05, 0.5), palette[random_int(0, 9)]);
+    }
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 16;
+    cam.vfov = 60;
+    cam.lookfrom = point3(0, 0, 110);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+}
+
+// Three large spheres (diffuse, metal and glass) among `count` small emissive spheres scattered
+// over an area that grows with the count, so the light density stays the same. A black emitter
+// encloses everything and blocks the sky: all light comes from the small spheres, which BSDF
+// sampling alone rarely finds.
+inline void light_field_scene(scene_description& scene, int count, uint64_t seed = 5) {
+    seed_random(seed);
+    uint32_t ground = scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    scene.geometry.add(sphere(point3(0, -1000, 0), 1000, ground));
+    scene.geometry.add(sphere(point3(0, 0, 0), 5000, scene.materials.add(diffuse_light(color(0, 0, 0)))));
+    scene.geometry.add(sphere(point3(-2.2, 1, 0), 1, scene.materials.add(lambertian(color(0.7, 0.3, 0.3)))));
+    scene.geometry.add(sphere(point3(0, 1, -0.5), 1, scene.materials.add(metal(color(0.8, 0.8, 0.8), 0.05))));
+    scene.geometry.add(sphere(point3(2.2, 1, 0.5), 1, scene.materials.add(dielectric(1.5))));
+
+    // The first light hangs above the large spheres, so even a single one lights them.
+    uint32_t palette[8];
+    for (int k = 0; k < 8; k++)
+        palette[k] = scene.materials.add(diffuse_light(20 * color::random(0.4, 1)));
+    scene.geometry.add(sphere(point3(0, 5, 2), 0.3, scene.materials.add(diffuse_light(color(30, 30, 30)))));
+    double half_width = 3 + 0.5 * std::sqrt(static_cast<double>(count));
+    for (int k = 1; k < count; k++) {
+        point3 center(random_double(-half_width, half_width), random_double(0.5, 4), random_double(-half_width, half_width));
+        scene.geometry.add(sphere(center, random_double(0.05, 0.15), palette[random_int(0, 7)]));
+    }
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 16;
+    cam.vfov = 50;
+    cam.lookfrom = point3(0, 3, 9);
+    cam.lookat = point3(0, 1, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+}
+
+// A grid of glass spheres on a diffuse ground, some with a colored diffuse core: almost every path
+// refracts through several interfaces before it escapes.
+inline void dielectric_scene(scene_description& scene, uint64_t seed = 2) {
+    seed_random(seed);
+    uint32_t ground = scene.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    uint32_t glass = scene.materials.add(dielectric(1.5));
+    uint32_t dense_glass = scene.materials.add(dielectric(2.4));
+    scene.geometry.add(sphere(point3(0, -1000, 0), 1000, ground));
+
+    for (int a = -6; a <= 6; a++) {
+        for (int b = -6; b <= 6; b++) {
+            point3 center(a + 0.8 * random_double(), 0.4, b + 0.8 * random_double());
+            scene.geometry.add(sphere(center, 0.4, random_double() < 0.3 ? dense_glass : glass));
+            if (random_double() < 0.4) {
+                uint32_t core = scene.materials.add(lambertian(color::random(0.2, 0.9)));
+                scene.geometry.add(sphere(center, 0.15, core));
+            }
+        }
+    }
+    scene.geometry.add(sphere(point3(0, 1.2, 0), 1.2, glass));
+
+    camera& cam = scene.cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 50;
+    cam.vfov = 30;
+    cam.lookfrom = point3(10, 4, 10);
+    cam.lookat = point3(0, 0.5, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+    cam.focus_dist = 10;
+}
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "Aov_buffers.h"
+#include "Color.h"
+#include "Image.h"
+#include "Simd.h"
+#include "Thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Edge-avoiding à-trous wavelet denoiser, after Dammertz et al. (HPG 2010) with the
+// variance-guided luminance weight of SVGF (Schied et al., HPG 2017), without the temporal part.
+//
+// The color is first divided by the first-hit albedo, so texture-free lighting is filtered and
+// surface detail is put back afterwards. Each iteration blurs with a 5x5 B3-spline kernel whose
+// taps are spread 2^i pixels apart, so five iterations cover a 125-pixel footprint with 25 taps
+// per pixel each. A tap's weight falls off with
+//  - the luminance difference, in units of the pixel's estimated noise (sigma_luminance standard
+//    deviations), so edges in the lighting survive while noise is averaged away;
+//  - the angle between the normals (cosine to the 128th power), which keeps creases sharp;
+//  - the relative depth difference, which keeps silhouettes sharp.
+// The noise estimate is filtered along with the color (with squared weights), so later,
+// coarser iterations blur less strongly than the first.
+//
+// Rows are split over a thread pool. The per-tap row loop has an AVX2 kernel next to the
+// scalar one; both evaluate the same polynomial exp in the same order, so they agree exactly.
+
+namespace denoiser_detail {
+
+using plane = std::vector<float, aligned_allocator<float, 64>>;
+
+// B3-spline weights of the 5x5 kernel, per axis.
+constexpr float b3_weights[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+// exp(x) for x <= 0 from 2^x = 2^floor * p(fraction), with p a degree-5 fit of 2^f on [0,1)
+// (relative error about 4e-6). Arguments below -80 are clamped; their weight is ~0 anyway.
+inline float fast_exp(float x) {
+    x = std::max(x, -80.0f);
+    float t = x * 1.44269504f;
+    float whole = std::floor(t);
+    float f = t - whole;
+    float p = 1.33335581e-3f;
+    p = p * f + 9.61812911e-3f;
+    p = p * f + 5.55041086e-2f;
+    p = p * f + 2.40226507e-1f;
+    p = p * f + 6.93147182e-1f;
+    p = p * f + 1.0f;
+    int32_t bits = (static_cast<int32_t>(whole) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// The center pixels of a run of one row: what every tap is compared against.
+struct center_row {
+    const float* luminance;
+    const float* inv_sigma;   // 1 / (sigma_luminance * noise standard deviation)
+    const float* nx;
+    const float* ny;
+    const float* nz;
+    const float* depth;
+    const float* inv_depth;   // 1 / (sigma_depth * step * depth)
+};
+
+// The neighbours of one tap, indexed like the center row: entry i is the neighbour of center i.
+struct tap_row {
+    const float* r;
+    const float* g;
+    const float* b;
+    const float* variance;
+    const float* luminance;
+    const float* nx;
+    const float* ny;
+    const float* nz;
+    const float* depth;
+};
+
+// Weighted sums of the center pixels.
+struct row_sums {
+    float* r;
+    float* g;
+    float* b;
+    float* weight;
+    float* variance;   // Squared weights times variance
+};
+
+inline void accumulate_scalar(int x0, int x1, float h, const center_row& p, const tap_row& q, const row_sums& out) {
+    for (int x = x0; x < x1; x++) {
+        float cos_angle = std::max(0.0f, p.nx[x] * q.nx[x] + p.ny[x] * q.ny[x] + p.nz[x] * q.nz[x]);
+        float w_normal = cos_angle;
+        for (int i = 0; i < 7; i++)
+            w_normal = w_normal * w_normal;
+        float e = std::fabs(p.luminance[x] - q.luminance[x]) * p.inv_sigma[x] + std::fabs(p.depth[x] - q.depth[x]) * p.inv_depth[x];
+        float w = h * w_normal * fast_exp(-e);
+        out.r[x] += w * q.r[x];
+        out.g[x] += w * q.g[x];
+        out.b[x] += w * q.b[x];
+        out.weight[x] += w;
+        out.variance[x] += w * w * q.variance[x];
+    }
+}
+
+#if defined(ORACLE_SIMD_X86)
+ORACLE_TARGET_AVX2
+inline __m256 fast_exp_avx2(__m256 x) {
+    x = _mm256_max_ps(x, _mm256_set1_ps(-80.0f));
+    __m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504f));
+    __m256 whole = _mm256_floor_ps(t);
+    __m256 f = _mm256_sub_ps(t, whole);
+    __m256 p = _mm256_set1_ps(1.33335581e-3f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.61812911e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.55041086e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.40226507e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.93147182e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+    __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+ORACLE_TARGET_AVX2
+inline void accumulate_avx2(int x0, int x1, float h, const center_row& p, const tap_row& q, const row_sums& out) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 hv = _mm256_set1_ps(h);
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        __m256 cos_angle = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(_mm256_loadu_ps(p.nx + x), _mm256_loadu_ps(q.nx + x)),
+            _mm256_mul_ps(_mm256_loadu_ps(p.ny + x), _mm256_loadu_ps(q.ny + x))),
+            _mm256_mul_ps(_mm256_loadu_ps(p.nz + x), _mm256_loadu_ps(q.nz + x)));
+        __m256 w_normal = _mm256_max_ps(zero, cos_angle);
+        for (int i = 0; i < 7; i++)
+            w_normal = _mm256_mul_ps(w_normal, w_normal);
+        __m256 dl = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(p.luminance + x), _mm256_loadu_ps(q.luminance + x)));
+        __m256 dz = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(p.depth + x), _mm256_loadu_ps(q.depth + x)));
+        __m256 e = _mm256_add_ps(_mm256_mul_ps(dl, _mm256_loadu_ps(p.inv_sigma + x)), _mm256_mul_ps(dz, _mm256_loadu_ps(p.inv_depth + x)));
+        __m256 w = _mm256_mul_ps(_mm256_mul_ps(hv, w_normal), fast_exp_avx2(_mm256_sub_ps(zero, e)));
+        _mm256_storeu_ps(out.r + x, _mm256_add_ps(_mm256_loadu_ps(out.r + x), _mm256_mul_ps(w, _mm256_loadu_ps(q.r + x))));
+        _mm256_storeu_ps(out.g + x, _mm256_add_ps(_mm256_loadu_ps(out.g + x), _mm256_mul_ps(w, _mm256_loadu_ps(q.g + x))));
+        _mm256_storeu_ps(out.b + x, _mm256_add_ps(_mm256_loadu_ps(out.b + x), _mm256_mul_ps(w, _mm256_loadu_ps(q.b + x))));
+        _mm256_storeu_ps(out.weight + x, _mm256_add_ps(_mm256_loadu_ps(out.weight + x), w));
+        _mm256_storeu_ps(out.variance + x, _mm256_add_ps(_mm256_loadu_ps(out.variance + x),
+            _mm256_mul_ps(_mm256_mul_ps(w, w), _mm256_loadu_ps(q.variance + x))));
+    }
+    accumulate_scalar(x, x1, h, p, q, out);
+}
+#endif
+
+}  // namespace denoiser_detail
+
+class denoiser {
+public:
+    int    iterations = 5;           // À-trous passes; pass i spaces its taps 2^i pixels apart
+    float  sigma_luminance = 4;      // Luminance differences of this many noise standard deviations weigh 1/e
+    float  sigma_depth = 0.02f;      // Relative depth difference per pixel of tap distance that weighs 1/e
+    int    thread_count = 0;         // 0 = all hardware threads, 1 = filter on the calling thread
+    thread_pool* pool = nullptr;     // If set, rows are filtered on this pool
+    simd_level level = simd_support();  // Kernel to use; levels the CPU lacks fall back to the best it has
+
+    // The kernel denoise() runs: AVX2 where `level` and the CPU allow it, otherwise scalar.
+    simd_level kernel() const {
+#if defined(ORACLE_SIMD_X86)
+        if (std::min(level, simd_support()) >= simd_level::avx2)
+            return simd_level::avx2;
+#endif
+        return simd_level::scalar;
+    }
+
+    // Filters `noisy`, rendered together with `aovs`, and returns the result.
+    image denoise(const image& noisy, const aov_buffers& aovs) const {
+        using namespace denoiser_detail;
+        int w = noisy.width(), h = noisy.height();
+        if (aovs.width() != w || aovs.height() != h) {
+            std::cerr << "Error: The AOV buffers do not match the image size" << std::endl;
+            return noisy;
+        }
+        size_t count = static_cast<size_t>(w) * h;
+
+        // Guides, and the demodulated color of the current iteration.
+        plane nx(count), ny(count), nz(count), depth(count), albedo(count * 3);
+        plane r(count), g(count), b(count), variance(count);
+        const float* c = noisy.data();
+        const float* a = aovs.albedo.data();
+        const float* n = aovs.normal.data();
+        for (size_t i = 0; i < count; i++) {
+            for (int k = 0; k < 3; k++)
+                albedo[3 * i + k] = a[3 * i + k] + albedo_epsilon;
+            r[i] = c[3 * i] / albedo[3 * i];
+            g[i] = c[3 * i + 1] / albedo[3 * i + 1];
+            b[i] = c[3 * i + 2] / albedo[3 * i + 2];
+            nx[i] = n[3 * i];
+            ny[i] = n[3 * i + 1];
+            nz[i] = n[3 * i + 2];
+            depth[i] = aovs.depth[i];
+            float y = luminance_of(albedo[3 * i], albedo[3 * i + 1], albedo[3 * i + 2]);
+            variance[i] = aovs.variance[i] / (y * y);
+        }
+        // A handful of samples says little about a pixel's variance (with one, nothing at all);
+        // the spread of its neighbourhood stands in for it.
+        if (aovs.samples < min_variance_samples)
+            spatial_variance(w, h, r, g, b, variance);
+
+        plane out_r(count), out_g(count), out_b(count), out_variance(count);
+        plane luminance(count), inv_sigma(count), inv_depth(count);
+
+        std::unique_ptr<thread_pool> local_pool;
+        if (!pool && thread_count != 1)
+            local_pool = std::make_unique<thread_pool>(thread_count);
+        thread_pool* workers = pool ? pool : local_pool.get();
+
+        bool avx2 = kernel() == simd_level::avx2;
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            int step = 1 << iteration;
+            for_rows(workers, h, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    for (int x = 0; x < w; x++) {
+                        size_t i = static_cast<size_t>(y) * w + x;
+                        luminance[i] = luminance_of(r[i], g[i], b[i]);
+                        float sigma = sigma_luminance * std::sqrt(blurred_variance(w, h, x, y, variance));
+                        inv_sigma[i] = 1.0f / (sigma + 1e-4f);
+                        inv_depth[i] = 1.0f / (sigma_depth * step * depth[i] + 1e-4f);
+                    }
+                }
+            });
+
+            for_rows(workers, h, [&](int y0, int y1) {
+                plane sums(static_cast<size_t>(w) * 5);
+                float* sum_r = &sums[0];
+                float* sum_g = &sums[w];
+                float* sum_b = &sums[2 * static_cast<size_t>(w)];
+                float* sum_weight = &sums[3 * static_cast<size_t>(w)];
+                float* sum_variance = &sums[4 * static_cast<size_t>(w)];
+                for (int y = y0; y < y1; y++) {
+                    std::fill(sums.begin(), sums.end(), 0.0f);
+                    size_t row = static_cast<size_t>(y) * w;
+                    for (int ty = -2; ty <= 2; ty++) {
+                        int qy = y + ty * step;
+                        if (qy < 0 || qy >= h)
+                            continue;
+                        for (int tx = -2; tx <= 2; tx++) {
+                            // Centers [x0,x1) of the row have this tap inside the image.
+                            int dx = tx * step;
+                            int x0 = std::max(0, -dx), x1 = std::min(w, w - dx);
+                            if (x0 >= x1)
+                                continue;
+                            size_t c0 = row + x0;
+                            size_t q0 = static_cast<size_t>(qy) * w + x0 + dx;
+                            center_row p = { &luminance[c0], &inv_sigma[c0], &nx[c0], &ny[c0], &nz[c0], &depth[c0], &inv_depth[c0] };
+                            tap_row q = { &r[q0], &g[q0], &b[q0], &variance[q0], &luminance[q0], &nx[q0], &ny[q0], &nz[q0], &depth[q0] };
+                            row_sums out = { sum_r + x0, sum_g + x0, sum_b + x0, sum_weight + x0, sum_variance + x0 };
+                            float weight = b3_weights[tx + 2] * b3_weights[ty + 2];
+#if defined(ORACLE_SIMD_X86)
+                            if (avx2) {
+                                accumulate_avx2(0, x1 - x0, weight, p, q, out);
+                                continue;
+                            }
+#endif
+                            accumulate_scalar(0, x1 - x0, weight, p, q, out);
+                        }
+                    }
+                    for (int x = 0; x < w; x++) {
+                        // Only a pixel whose samples' normals cancel out can lose its own tap.
+                        if (sum_weight[x] <= 0) {
+                            out_r[row + x] = r[row + x];
+                            out_g[row + x] = g[row + x];
+                            out_b[row + x] = b[row + x];
+                            out_variance[row + x] = variance[row + x];
+                            continue;
+                        }
+                        float inv = 1.0f / sum_weight[x];
+                        out_r[row + x] = sum_r[x] * inv;
+                        out_g[row + x] = sum_g[x] * inv;
+                        out_b[row + x] = sum_b[x] * inv;
+                        out_variance[row + x] = sum_variance[x] * inv * inv;
+                    }
+                }
+            });
+            r.swap(out_r);
+            g.swap(out_g);
+            b.swap(out_b);
+            variance.swap(out_variance);
+        }
+
+        image result(w, h);
+        float* o = result.data();
+        for (size_t i = 0; i < count; i++) {
+            o[3 * i] = r[i] * albedo[3 * i];
+            o[3 * i + 1] = g[i] * albedo[3 * i + 1];
+            o[3 * i + 2] = b[i] * albedo[3 * i + 2];
+        }
+        return result;
+    }
+
+private:
+    static constexpr float albedo_epsilon = 1e-3f;   // Keeps black surfaces from dividing by zero
+    static constexpr int min_variance_samples = 4;   // Fewer samples per pixel: estimate variance spatially
+
+    static float luminance_of(float r, float g, float b) {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    // 3x3 Gaussian of the variance around (x, y), clamped at the borders.
+    static float blurred_variance(int w, int h, int x, int y, const denoiser_detail::plane& variance) {
+        static constexpr float weights[3] = { 0.25f, 0.5f, 0.25f };
+        float sum = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            int qy = std::min(std::max(y + dy, 0), h - 1);
+            for (int dx = -1; dx <= 1; dx++) {
+                int qx = std::min(std::max(x + dx, 0), w - 1);
+                sum += weights[dx + 1] * weights[dy + 1] * variance[static_cast<size_t>(qy) * w + qx];
+            }
+        }
+        return sum;
+    }
+
+    // Replaces `variance` with the luminance variance of each pixel's 5x5 neighbourhood.
+    static void spatial_variance(int w, int h, const denoiser_detail::plane& r, const denoiser_detail::plane& g,
+                                 const denoiser_detail::plane& b, denoiser_detail::plane& variance) {
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float sum = 0, sum_sq = 0;
+                int n = 0;
+                for (int qy = std::max(0, y - 2); qy <= std::min(h - 1, y + 2); qy++) {
+                    for (int qx = std::max(0, x - 2); qx <= std::min(w - 1, x + 2); qx++) {
+                        size_t i = static_cast<size_t>(qy) * w + qx;
+                        float l = luminance_of(r[i], g[i], b[i]);
+                        sum += l;
+                        sum_sq += l * l;
+                        n++;
+                    }
+                }
+                float mean = sum / n;
+                variance[static_cast<size_t>(y) * w + x] = std::max(0.0f, sum_sq / n - mean * mean);
+            }
+        }
+    }
+
+    // Runs fn(y0, y1) over bands of rows covering [0, h), on `workers` or the calling thread.
+    static void for_rows(thread_pool* workers, int h, const std::function<void(int, int)>& fn) {
+        if (!workers) {
+            fn(0, h);
+            return;
+        }
+        int bands = std::max(1, std::min(h, workers->size() * 4));
+        task_group group(*workers);
+        for (int band = 0; band < bands; band++) {
+            int y0 = static_cast<int>(static_cast<long long>(h) * band / bands);
+            int y1 = static_cast<int>(static_cast<long long>(h) * (band + 1) / bands);
+            group.run([&fn, y0, y1] { fn(y0, y1); });
+        }
+        group.wait();
+    }
+};
+
+#endif
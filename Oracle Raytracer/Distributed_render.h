@@ -0,0 +1,368 @@
+#ifndef DISTRIBUTED_RENDER_H
+#define DISTRIBUTED_RENDER_H
+
+#include "Accumulation_buffer.h"
+#include "Camera.h"
+#include "Image.h"
+#include "Render_server.h"
+#include "Socket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+// Distributed rendering.
+// A coordinator splits the image into work units and hands them to render servers (Render_server.h)
+// running as worker processes, here or on other machines. A unit is a block of pixels and a range
+// of samples; the worker answers with the per-pixel sample sums, and the coordinator merges them.
+// Two splits are supported:
+//
+//   tiles    Every unit is one tile with all of its samples. Each sum is divided by the sample
+//            count exactly as camera::render_image() does, so the image is identical to a
+//            single-process render.
+//   samples  Every unit is one tile and one pass of pass_samples samples, so more machines than
+//            tiles can share a small image. Passes are added to an accumulation_buffer in sample
+//            order whatever order they arrive in, so the image is identical to a single-process
+//            camera::render_progressive() with the same pass_samples.
+//
+// Samples are seeded from (pixel, sample index, frame), so which worker renders a unit makes no
+// difference. Each worker has one connection and one unit in flight. A worker whose connection
+// fails or that does not answer within unit_timeout is dropped and its unit goes back to the
+// queue. Once the queue is empty, idle workers also take a second copy of any unit that has run
+// for more than slow_factor times the median unit time, so one slow machine cannot hold up the
+// frame; the first answer wins. Workers must see the same scene: a scene file path must be valid
+// on every worker, built-in scenes work anywhere.
+
+enum class distributed_split {
+    tiles,
+    samples
+};
+
+struct distributed_options {
+    distributed_split split = distributed_split::tiles;
+    int tile_size = 64;           // Edge of the pixel blocks handed out
+    int worker_tile_size = 16;    // Edge of the tiles a worker spreads a block over its render threads
+    double unit_timeout = 120;    // Seconds a worker may take for one unit before it is dropped
+    double slow_factor = 3;       // Units running this many median unit times get a second copy
+    double min_slow_seconds = 1;  // ... but never before they have run this long
+};
+
+struct distributed_stats {
+    size_t units = 0;
+    size_t duplicates = 0;        // Second copies handed to idle workers
+    size_t reassigned = 0;        // Units put back in the queue after a worker failed
+    size_t failed_workers = 0;
+    double seconds = 0;
+};
+
+class render_coordinator {
+public:
+    render_coordinator(const std::string& scene_name, const camera& cam, const distributed_options& options)
+        : scene_name(scene_name), cam(cam), options(options) {}
+
+    // Renders the image on `workers` (server addresses). False if the workers all failed before
+    // every unit was done.
+    bool render(const std::vector<std::string>& workers, image& result) {
+        auto start = std::chrono::steady_clock::now();
+        width = cam.image_width;
+        height = cam.output_height();
+        settings = camera_job_settings(cam);
+        make_units();
+        remaining = units.size();
+        framebuffer = image(width, height);
+        accum = accumulation_buffer(width, height, cam.settings_key());
+        next_pass.assign(tile_count, 0);
+        early_passes.assign(tile_count, {});
+
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < workers.size(); w++)
+            threads.emplace_back([this, &workers, w] { run_worker(workers[w]); });
+        for (auto& t : threads)
+            t.join();
+
+        stats.units = units.size();
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (remaining > 0) {
+            std::cerr << "Error: Every worker failed with " << remaining << " of " << units.size() << " units left" << std::endl;
+            return false;
+        }
+        result = options.split == distributed_split::tiles ? std::move(framebuffer) : accum.resolve();
+        return true;
+    }
+
+    const distributed_stats& statistics() const { return stats; }
+
+private:
+    struct unit {
+        int x0, y0, x1, y1;
+        int first_sample, sample_count;
+        int tile;                 // Index of the pixel block
+        int pass;                 // Index of the sample range within the block
+        bool done = false;
+        int in_flight = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    std::string scene_name;
+    camera cam;
+    distributed_options options;
+    std::string settings;
+    int width = 0, height = 0;
+    int tile_count = 0;
+
+    std::mutex mutex;             // Guards everything below
+    std::condition_variable changed;
+    std::vector<unit> units;
+    std::deque<size_t> queue;
+    size_t remaining = 0;
+    std::vector<double> unit_seconds;
+    std::vector<socket_connection*> connections;    // Of the workers still running
+    image framebuffer;                               // Split by tiles
+    accumulation_buffer accum;                       // Split by samples
+    std::vector<int> next_pass;                      // Per tile: the next pass to add to accum
+    std::vector<std::map<int, std::vector<sample_sum>>> early_passes;  // Per tile: passes that arrived before it
+    distributed_stats stats;
+
+    void make_units() {
+        int edge = std::max(1, options.tile_size);
+        int pass_samples = options.split == distributed_split::samples ? std::max(1, cam.pass_samples) : cam.samples_per_pixel;
+        units.clear();
+        tile_count = 0;
+        for (int y = 0; y < height; y += edge) {
+            for (int x = 0; x < width; x += edge, tile_count++) {
+                int pass = 0;
+                for (int first = 0; first < cam.samples_per_pixel; first += pass_samples, pass++) {
+                    unit u;
+                    u.x0 = x; u.y0 = y; u.x1 = std::min(x + edge, width); u.y1 = std::min(y + edge, height);
+                    u.first_sample = first;
+                    u.sample_count = std::min(pass_samples, cam.samples_per_pixel - first);
+                    u.tile = tile_count;
+                    u.pass = pass;
+                    units.push_back(u);
+                }
+            }
+        }
+        // Passes in sample order, so each tile's earlier passes tend to arrive first.
+        std::vector<size_t> order(units.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return units[a].pass < units[b].pass; });
+        queue.assign(order.begin(), order.end());
+    }
+
+    // The next unit for an idle worker: a queued one, else a second copy of a straggler. Blocks
+    // while neither exists; returns false once every unit is done.
+    bool take(size_t& index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            if (remaining == 0)
+                return false;
+            if (!queue.empty()) {
+                index = queue.front();
+                queue.pop_front();
+                start(index);
+                return true;
+            }
+            if (straggler(index)) {
+                stats.duplicates++;
+                start(index);
+                std::clog << "Duplicating slow unit " << index << "\n";
+                return true;
+            }
+            changed.wait_for(lock, std::chrono::milliseconds(50));
+        }
+    }
+
+    void start(size_t index) {
+        if (units[index].in_flight++ == 0)
+            units[index].started = std::chrono::steady_clock::now();
+    }
+
+    bool straggler(size_t& index) const {
+        if (unit_seconds.empty())
+            return false;
+        std::vector<double> sorted = unit_seconds;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double limit = std::max(options.min_slow_seconds, options.slow_factor * sorted[sorted.size() / 2]);
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < units.size(); i++) {
+            const unit& u = units[i];
+            if (!u.done && u.in_flight == 1 && std::chrono::duration<double>(now - u.started).count() > limit) {
+                index = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void failed(size_t index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unit& u = units[index];
+        u.in_flight--;
+        if (!u.done && u.in_flight == 0) {
+            queue.push_front(index);
+            stats.reassigned++;
+        }
+        changed.notify_all();
+    }
+
+    void finished(size_t index, std::vector<sample_sum> sums) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unit& u = units[index];
+        u.in_flight--;
+        if (u.done)
+            return;   // The other copy was faster.
+        u.done = true;
+        remaining--;
+        unit_seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - u.started).count());
+        merge(u, std::move(sums));
+        // Workers still busy on second copies (or hung) have nothing left to contribute.
+        if (remaining == 0) {
+            for (socket_connection* connection : connections)
+                connection->interrupt();
+        }
+        changed.notify_all();
+    }
+
+    void merge(const unit& u, std::vector<sample_sum> sums) {
+        int w = u.x1 - u.x0;
+        if (options.split == distributed_split::tiles) {
+            for (int y = u.y0; y < u.y1; y++) {
+                for (int x = u.x0; x < u.x1; x++)
+                    framebuffer.set(x, y, sums[static_cast<size_t>(y - u.y0) * w + (x - u.x0)].sum / cam.samples_per_pixel);
+            }
+            return;
+        }
+        // Float sums only come out the same when the passes are added in the same order.
+        auto& early = early_passes[u.tile];
+        early[u.pass] = std::move(sums);
+        for (auto it = early.find(next_pass[u.tile]); it != early.end(); it = early.find(next_pass[u.tile])) {
+            for (int y = u.y0; y < u.y1; y++) {
+                for (int x = u.x0; x < u.x1; x++)
+                    accum.add(x, y, it->second[static_cast<size_t>(y - u.y0) * w + (x - u.x0)]);
+            }
+            early.erase(it);
+            next_pass[u.tile]++;
+        }
+    }
+
+    void run_worker(const std::string& address) {
+        socket_connection server = connect_socket(address);
+        if (server.is_open()) {
+            server.set_timeout(options.unit_timeout);
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.push_back(&server);
+        }
+        size_t index;
+        bool lost = false;
+        while (server.is_open() && take(index)) {
+            const unit& u = units[index];   // Bounds never change once the units are made.
+            std::string job = "region \"" + scene_name + "\" " + std::to_string(u.x0) + " " + std::to_string(u.y0) + " "
+                + std::to_string(u.x1) + " " + std::to_string(u.y1) + " " + std::to_string(u.first_sample) + " "
+                + std::to_string(u.sample_count) + settings + " tile_size " + std::to_string(options.worker_tile_size) + "\n";
+            std::string line;
+            std::vector<uint8_t> bytes(static_cast<size_t>(u.x1 - u.x0) * (u.y1 - u.y0) * region_pixel_bytes);
+            bool ok = server.send_all(job) && server.read_line(line)
+                && line == "sums " + std::to_string(bytes.size()) && server.read_bytes(bytes.data(), bytes.size());
+            if (!ok && all_done()) {
+                failed(index);
+                break;
+            }
+            if (!ok) {
+                std::cerr << "Error: Worker " << address << " failed on unit " << index
+                    << (line.compare(0, 6, "error ") == 0 ? ": " + line.substr(6) : std::string()) << "; reassigning" << std::endl;
+                failed(index);
+                lost = true;
+                break;
+            }
+            finished(index, decode_region_sums(bytes, u.sample_count));
+        }
+        // finished() interrupts every listed connection from other threads, so the socket is only
+        // closed once it is off the list, under the same lock.
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.erase(std::remove(connections.begin(), connections.end(), &server), connections.end());
+        if (lost)
+            server.close();
+        if (!server.is_open())
+            stats.failed_workers++;
+    }
+
+    bool all_done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return remaining == 0;
+    }
+};
+
+// Local worker processes for testing: `count` copies of this executable serving on Unix sockets,
+// `threads` render threads each. POSIX only.
+class local_workers {
+public:
+    local_workers(const std::string& executable, int count, int threads) {
+#if defined(_WIN32)
+        (void)executable; (void)count; (void)threads;
+        std::cerr << "Error: Local worker processes are not supported here; start servers and pass their addresses" << std::endl;
+#else
+        for (int i = 0; i < count; i++) {
+            std::string address = "/tmp/oracle_worker_" + std::to_string(getpid()) + "_" + std::to_string(i) + ".sock";
+            std::string thread_arg = std::to_string(threads);
+            std::vector<std::string> args = { executable, "--serve", address, "--threads", thread_arg };
+            std::vector<char*> argv;
+            for (auto& a : args)
+                argv.push_back(&a[0]);
+            argv.push_back(nullptr);
+            pid_t pid;
+            if (posix_spawn(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+                std::cerr << "Error: Could not start worker " << executable << std::endl;
+                continue;
+            }
+            pids.push_back(pid);
+            addresses.push_back(address);
+        }
+        // Wait up to five seconds for each server to listen.
+        for (const auto& address : addresses) {
+            for (int attempt = 0; attempt < 200 && !connect_socket(address, false).is_open(); attempt++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+#endif
+    }
+
+    ~local_workers() {
+#if !defined(_WIN32)
+        for (const auto& address : addresses) {
+            socket_connection server = connect_socket(address);
+            if (server.is_open())
+                server.send_all("shutdown\n");
+        }
+        for (pid_t pid : pids)
+            waitpid(pid, nullptr, 0);
+#endif
+    }
+
+    local_workers(const local_workers&) = delete;
+    local_workers& operator=(const local_workers&) = delete;
+
+    const std::vector<std::string>& worker_addresses() const { return addresses; }
+
+private:
+    std::vector<std::string> addresses;
+#if !defined(_WIN32)
+    std::vector<pid_t> pids;
+#endif
+};
+
+#endif
@@ -5,19 +5,19 @@
 #include "Vector.h"        // defines 'vec3', 'point3', and 'dot(...)'
 #include "Interval.h"      // defines 'interval'
 #include <memory>          // defines std::shared_ptr
-#include "aabb.h"
+#include <cstdint>
+#include "AABB.h"
+#include "Ray_packet.h"
 
 using std::shared_ptr;
 
 
-class material;
-
 class hit_record {
 public:
     point3 p;
     vec3 normal;
-    double t;
-    shared_ptr<material> mat;
+    real t;
+    uint32_t material_id;  // Index into the scene's material_table
     bool front_face;
 
     void set_face_normal(const ray& r, const vec3& outward_normal) {
@@ -29,6 +29,12 @@ public:
     }
 };
 
+// Per-lane results of tracing a ray_packet.
+struct packet_hits {
+    hit_record rec[ray_packet::max_size];
+    bool hit[ray_packet::max_size] = {};
+};
+
 class hittable {
 public:
     virtual ~hittable() = default;
@@ -36,6 +42,19 @@ public:
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
 
+    // Traces every lane of the packet. A lane that finds a closer hit sets hits.hit, fills
+    // hits.rec and lowers packet.t_max, so several objects can be traced in turn.
+    // The default handles one ray at a time; acceleration structures override it.
+    virtual void hit_packet(ray_packet& packet, packet_hits& hits) const {
+        for (int i = 0; i < packet.count; i++) {
+            if (packet.t_min[i] < packet.t_max[i]
+                && hit(packet.rays[i], interval(packet.t_min[i], packet.t_max[i]), hits.rec[i])) {
+                hits.hit[i] = true;
+                packet.t_max[i] = hits.rec[i].t;
+            }
+        }
+    }
+
     virtual aabb bounding_box() const = 0;
 
 };
@@ -1,6 +1,6 @@
 #ifndef HITTABLE_LIST_H
 #define HITTABLE_LIST_H
-#include "aabb.h"
+#include "AABB.h"
 
 #include "Hittable.h"
 
@@ -23,6 +23,10 @@ public:
 
     virtual bool hit(
         const ray& r, interval ray_t, hit_record& rec) const override;
+    void hit_packet(ray_packet& packet, packet_hits& hits) const override {
+        for (const auto& object : objects)
+            object->hit_packet(packet, hits);
+    }
     aabb bounding_box() const override { return bbox; }
 
 public:
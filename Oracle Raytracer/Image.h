@@ -0,0 +1,225 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "Color.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Float framebuffer and the encoders that turn it into files.
+// Pixels are stored as linear RGB floats, row-major from the top-left corner. Gamma encoding and
+// quantization only happen in the 8-bit encoders; PFM keeps the linear floats.
+
+class image {
+public:
+    image() = default;
+
+    image(int width, int height)
+        : w(width), h(height), pixels(static_cast<size_t>(width) * height * 3, 0.0f) {}
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    void set(int x, int y, const color& c) {
+        float* p = &pixels[index(x, y)];
+        p[0] = static_cast<float>(c.x());
+        p[1] = static_cast<float>(c.y());
+        p[2] = static_cast<float>(c.z());
+    }
+
+    color get(int x, int y) const {
+        const float* p = &pixels[index(x, y)];
+        return color(p[0], p[1], p[2]);
+    }
+
+    float* data() { return pixels.data(); }
+    const float* data() const { return pixels.data(); }
+
+private:
+    int w = 0;
+    int h = 0;
+    std::vector<float> pixels;
+
+    size_t index(int x, int y) const {
+        return (static_cast<size_t>(y) * w + x) * 3;
+    }
+};
+
+enum class image_format {
+    ppm_ascii,  // P3 text, one pixel per line (the original write_color output)
+    ppm,        // P6 binary, 8 bits per channel
+    pfm,        // Portable float map: linear 32-bit float RGB, for HDR post-processing
+    qoi         // "Quite OK Image" lossless compression of the 8-bit image
+};
+
+inline image_format image_format_from_path(const std::string& path) {
+    auto dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (auto& ch : ext)
+        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    if (ext == "pfm") return image_format::pfm;
+    if (ext == "qoi") return image_format::qoi;
+    return image_format::ppm;
+}
+
+inline std::vector<uint8_t> to_rgb8(const image& img) {
+    std::vector<uint8_t> rgb(static_cast<size_t>(img.width()) * img.height() * 3);
+    const float* src = img.data();
+    for (size_t i = 0; i < rgb.size(); i++)
+        rgb[i] = static_cast<uint8_t>(component_to_byte(src[i]));
+    return rgb;
+}
+
+inline std::vector<uint8_t> encode_ppm_ascii(const image& img) {
+    std::ostringstream out;
+    out << "P3\n" << img.width() << ' ' << img.height() << "\n255\n";
+    for (int y = 0; y < img.height(); y++) {
+        for (int x = 0; x < img.width(); x++)
+            write_color(out, img.get(x, y));
+    }
+    std::string text = out.str();
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+inline std::vector<uint8_t> encode_ppm(const image& img) {
+    std::string header = "P6\n" + std::to_string(img.width()) + ' ' + std::to_string(img.height()) + "\n255\n";
+    std::vector<uint8_t> out(header.begin(), header.end());
+    auto rgb = to_rgb8(img);
+    out.insert(out.end(), rgb.begin(), rgb.end());
+    return out;
+}
+
+inline std::vector<uint8_t> encode_pfm(const image& img) {
+    // A negative scale marks little-endian data; PFM rows run bottom to top.
+    std::string header = "PF\n" + std::to_string(img.width()) + ' ' + std::to_string(img.height()) + "\n-1.0\n";
+    std::vector<uint8_t> out(header.begin(), header.end());
+    size_t row_bytes = static_cast<size_t>(img.width()) * 3 * sizeof(float);
+    out.resize(header.size() + row_bytes * img.height());
+
+    uint8_t* dst = out.data() + header.size();
+    for (int y = img.height() - 1; y >= 0; y--) {
+        const float* row = img.data() + static_cast<size_t>(y) * img.width() * 3;
+        for (size_t k = 0; k < static_cast<size_t>(img.width()) * 3; k++) {
+            uint32_t bits;
+            std::memcpy(&bits, &row[k], sizeof(bits));
+            *dst++ = static_cast<uint8_t>(bits);
+            *dst++ = static_cast<uint8_t>(bits >> 8);
+            *dst++ = static_cast<uint8_t>(bits >> 16);
+            *dst++ = static_cast<uint8_t>(bits >> 24);
+        }
+    }
+    return out;
+}
+
+inline std::vector<uint8_t> encode_qoi(const image& img) {
+    // Encoder for the QOI format (qoiformat.org): runs, a 64-entry hash of recently seen colors,
+    // and small per-channel deltas, falling back to raw RGB.
+    const uint8_t op_index = 0x00, op_diff = 0x40, op_luma = 0x80, op_run = 0xc0, op_rgb = 0xfe;
+
+    std::vector<uint8_t> out;
+    auto put32 = [&out](uint32_t v) {
+        out.push_back(static_cast<uint8_t>(v >> 24));
+        out.push_back(static_cast<uint8_t>(v >> 16));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v));
+    };
+
+    auto rgb = to_rgb8(img);
+    out.reserve(14 + rgb.size() / 2);
+    out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+    put32(static_cast<uint32_t>(img.width()));
+    put32(static_cast<uint32_t>(img.height()));
+    out.push_back(3);   // RGB
+    out.push_back(0);   // sRGB with linear alpha
+
+    struct pixel { uint8_t r, g, b, a; };
+    pixel seen[64] = {};
+    pixel prev = { 0, 0, 0, 255 };
+    int run = 0;
+    size_t count = rgb.size() / 3;
+
+    for (size_t i = 0; i < count; i++) {
+        pixel px = { rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2], 255 };
+
+        if (px.r == prev.r && px.g == prev.g && px.b == prev.b) {
+            run++;
+            if (run == 62 || i + 1 == count) {
+                out.push_back(static_cast<uint8_t>(op_run | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            out.push_back(static_cast<uint8_t>(op_run | (run - 1)));
+            run = 0;
+        }
+
+        int hash = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+        if (seen[hash].r == px.r && seen[hash].g == px.g && seen[hash].b == px.b && seen[hash].a == px.a) {
+            out.push_back(static_cast<uint8_t>(op_index | hash));
+        }
+        else {
+            seen[hash] = px;
+
+            int8_t dr = static_cast<int8_t>(px.r - prev.r);
+            int8_t dg = static_cast<int8_t>(px.g - prev.g);
+            int8_t db = static_cast<int8_t>(px.b - prev.b);
+            int8_t dr_dg = static_cast<int8_t>(dr - dg);
+            int8_t db_dg = static_cast<int8_t>(db - dg);
+
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                out.push_back(static_cast<uint8_t>(op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+            }
+            else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+                out.push_back(static_cast<uint8_t>(op_luma | (dg + 32)));
+                out.push_back(static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8)));
+            }
+            else {
+                out.push_back(op_rgb);
+                out.push_back(px.r);
+                out.push_back(px.g);
+                out.push_back(px.b);
+            }
+        }
+        prev = px;
+    }
+
+    out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+    return out;
+}
+
+inline std::vector<uint8_t> encode_image(const image& img, image_format format) {
+    switch (format) {
+    case image_format::ppm_ascii: return encode_ppm_ascii(img);
+    case image_format::pfm:       return encode_pfm(img);
+    case image_format::qoi:       return encode_qoi(img);
+    default:                      return encode_ppm(img);
+    }
+}
+
+inline bool write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not create file " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+inline bool write_image(const image& img, const std::string& path, image_format format) {
+    return write_file(path, encode_image(img, format));
+}
+
+inline bool write_image(const image& img, const std::string& path) {
+    return write_image(img, path, image_format_from_path(path));
+}
+
+#endif
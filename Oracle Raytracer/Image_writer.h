@@ -0,0 +1,100 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "Image.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Background image output.
+// submit() hands a finished framebuffer to a dedicated thread that encodes it and writes it to
+// disk, so the caller can go straight on to the next frame or pass. The destructor waits for
+// every queued image to be written.
+
+class image_writer {
+public:
+    image_writer() : worker([this] { run(); }) {}
+
+    ~image_writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    image_writer(const image_writer&) = delete;
+    image_writer& operator=(const image_writer&) = delete;
+
+    void submit(image img, const std::string& path, image_format format) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back({ std::move(img), path, format });
+        }
+        changed.notify_all();
+    }
+
+    void submit(image img, const std::string& path) {
+        submit(std::move(img), path, image_format_from_path(path));
+    }
+
+    // Time spent encoding and writing images so far.
+    double write_seconds() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total_seconds;
+    }
+
+    // Blocks until everything submitted so far is on disk.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return jobs.empty() && !busy; });
+    }
+
+private:
+    struct job {
+        image img;
+        std::string path;
+        image_format format;
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<job> jobs;
+    bool busy = false;
+    bool stopping = false;
+    double total_seconds = 0;
+    std::thread worker;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;  // Only reached when stopping with nothing left to write.
+
+            job current = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            bool ok = write_image(current.img, current.path, current.format);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (ok)
+                std::clog << "Image saved as " << current.path << " (" << ms << " ms)\n";
+
+            lock.lock();
+            total_seconds += ms / 1e3;
+            busy = false;
+            changed.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "Hittable.h"
+#include "Transform.h"
+
+#include <cstdint>
+
+// A placed copy of a shared object.
+// The object (normally a linear_bvh over the object's own geometry: the bottom level) is built
+// once in its own space; each instance only holds a pointer to it and the transform from world
+// space into object space. Rays are carried into object space at the instance, and hits are
+// carried back, so a thousand instances of one model cost a thousand of these small records plus
+// one copy of the model. The scene's BVH over the instances is the top level.
+//
+// The transformed direction is not renormalized, so a hit's t is the same in both spaces.
+
+class instance : public hittable {
+public:
+    static constexpr uint32_t keep_material = UINT32_MAX;
+
+    // `material_id` replaces the object's materials, unless it is keep_material.
+    instance(shared_ptr<const hittable> object, const transform& object_to_world, uint32_t material_id = keep_material)
+        : object(std::move(object)), world_to_object(object_to_world.inverse()), material_id(material_id)
+    {
+        aabb local = this->object->bounding_box();
+        bbox = local.x.min <= local.x.max ? object_to_world.box(local) : aabb::empty;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        ray local(world_to_object.point(r.origin()), world_to_object.vector(r.direction()), r.time());
+        if (!object->hit(local, ray_t, rec))
+            return false;
+        rec.p = r.at(rec.t);
+        // Normals map back by the inverse transpose of object_to_world, the transpose of
+        // world_to_object. front_face carries over: the transform keeps the sign of dot(d, n).
+        rec.normal = unit_vector(world_to_object.transpose_vector(rec.normal));
+        if (material_id != keep_material)
+            rec.material_id = material_id;
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    const shared_ptr<const hittable>& get_object() const { return object; }
+
+private:
+    shared_ptr<const hittable> object;
+    transform world_to_object;
+    aabb bbox;
+    uint32_t material_id;
+};
+
+#endif
@@ -1,45 +1,51 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
+#include "Precision.h"
 #include "Utilities.h"
-class interval {
+template <typename T>
+class interval_t {
 public:
-    double min, max;
+    T min, max;
 
-    interval() : min(+infinity), max(-infinity) {} // Default interval is empty
+    constexpr interval_t() : min(T(+infinity)), max(T(-infinity)) {} // Default interval is empty
 
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    constexpr interval_t(T _min, T _max) : min(_min), max(_max) {}
 
-    interval(const interval& a, const interval& b) {
-        // Create the interval tightly enclosing the two input intervals.
-        min = a.min <= b.min ? a.min : b.min;
-        max = a.max >= b.max ? a.max : b.max;
-    }
+    // Create the interval tightly enclosing the two input intervals.
+    constexpr interval_t(const interval_t& a, const interval_t& b)
+        : min(a.min <= b.min ? a.min : b.min), max(a.max >= b.max ? a.max : b.max) {}
 
-    bool contains(double x) const {
+    bool contains(T x) const {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const {
+    bool surrounds(T x) const {
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    T clamp(T x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
     }
 
-    interval expand(double delta) const {
+    interval_t expand(T delta) const {
         auto padding = delta / 2;
-        return interval(min - padding, max + padding);
+        return interval_t(min - padding, max + padding);
     }
 
 
 
-    static const interval empty, universe;
+    static const interval_t empty, universe;
 };
 
-const interval interval::empty = interval(+infinity, -infinity);
-const interval interval::universe = interval(-infinity, +infinity);
+// constexpr, so they are constant-initialized: aabb_t's statics are built from these, and
+// dynamic initialization of template statics happens in no particular order.
+template <typename T>
+constexpr interval_t<T> interval_t<T>::empty = interval_t<T>(T(+infinity), T(-infinity));
+template <typename T>
+constexpr interval_t<T> interval_t<T>::universe = interval_t<T>(T(-infinity), T(+infinity));
+
+using interval = interval_t<real>;
 
 #endif
\ No newline at end of file
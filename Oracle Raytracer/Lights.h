@@ -0,0 +1,310 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "Utilities.h"
+#include "AABB.h"
+#include "Color.h"
+#include "Material.h"
+#include "Scene_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// The lights of a scene, for sampling them directly (next-event estimation).
+// Every sphere whose material is a diffuse_light with a nonzero color is a light; emissive spheres
+// inside instances and emissive triangles still shine when a path hits them, they are just never
+// aimed at.
+//
+// One light is picked per shading point. With thousands of lights, picking uniformly wastes
+// nearly every shadow ray on a light too far away or too dim to matter, so the lights sit in a
+// binary tree (after the light trees of Conty Estevez and Kulla, "Importance Sampling of Many
+// Lights with Adaptive Tree Splitting", 2018, without the orientation cones, since spheres shine
+// in every direction). Each node keeps the bounds and total power of the lights below it; a pick
+// walks from the root and takes each child with probability proportional to its power over its
+// squared distance from the shading point, so it costs O(log n) and favours the lights that
+// matter there. The picked sphere is then sampled uniformly within the cone it subtends.
+//
+// pdf() gives the density with which a shading point would have picked and sampled the light a
+// ray found, which multiple importance sampling needs. Hit records don't say which primitive was
+// hit, so the light is found from the hit point through the same tree.
+
+enum class light_selection {
+    uniform,   // Every light equally likely
+    tree       // Power over squared distance, through the light tree
+};
+
+// A direction toward a light from a shading point.
+struct light_sample {
+    vec3 direction;     // Unit vector
+    double distance;    // To the light's surface along `direction`
+    color emission;
+    double pdf;         // Solid-angle density of `direction`, including the chance of picking the light
+};
+
+class light_list {
+public:
+    light_selection selection = light_selection::tree;
+
+    light_list() = default;
+
+    light_list(const scene_geometry& geometry, const material_table& materials) {
+        const sphere_soa& spheres = geometry.spheres;
+        for (size_t i = 0; i < spheres.size(); i++) {
+            const material& m = materials[spheres.get_material(i)];
+            real radius = spheres.get_radius(i);
+            if (m.type() != material_type::diffuse_light || !(radius > 0) || luminance(m.emitted()) <= 0)
+                continue;
+            lights.push_back({ spheres.start_center(i), spheres.motion(i), radius, m.emitted() });
+        }
+        build();
+    }
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+
+    // Picks a light for the shading point `p` at `time` and a direction toward it. False if the
+    // point is inside the picked light, which then can't be sampled.
+    bool sample(const point3& p, double time, light_sample& out) const {
+        double pick_pdf;
+        size_t index = pick(p, random_double(), pick_pdf);
+        const light& l = lights[index];
+        vec3 to_center = l.center(time) - p;
+        double d2 = to_center.length_squared();
+        double r2 = double(l.radius) * l.radius;
+        if (d2 <= r2)
+            return false;
+
+        double d = std::sqrt(d2);
+        double one_minus_cos_max = cone_width(d2, r2);
+        double u1 = random_double(), u2 = random_double();
+        double one_minus_cos = u1 * one_minus_cos_max;
+        double cos_theta = 1 - one_minus_cos;
+        double sin_theta = std::sqrt(std::max(0.0, one_minus_cos * (2 - one_minus_cos)));
+        double phi = 2 * pi * u2;
+
+        vec3 w = to_center / static_cast<real>(d);
+        vec3 a, b;
+        orthonormal_basis(w, a, b);
+        out.direction = static_cast<real>(sin_theta * std::cos(phi)) * a + static_cast<real>(sin_theta * std::sin(phi)) * b
+            + static_cast<real>(cos_theta) * w;
+        // Nearest intersection with the sphere along the sampled direction.
+        double along = d * cos_theta;
+        out.distance = along - std::sqrt(std::max(0.0, r2 - (d2 - along * along)));
+        out.emission = l.emission;
+        out.pdf = pick_pdf / (2 * pi * one_minus_cos_max);
+        return true;
+    }
+
+    // Density with which sample() from `p` at `time` produces the direction toward `hit`, a point on
+    // an emissive surface; 0 if that surface is not one of the lights.
+    double pdf(const point3& p, double time, const point3& hit) const {
+        size_t index;
+        if (!find(hit, time, index))
+            return 0;
+        const light& l = lights[index];
+        double d2 = (l.center(time) - p).length_squared();
+        double r2 = double(l.radius) * l.radius;
+        if (d2 <= r2)
+            return 0;
+        return pick_probability(p, index) / (2 * pi * cone_width(d2, r2));
+    }
+
+private:
+    struct light {
+        point3 start;   // Center at time 0
+        vec3 motion;    // Center moves by this much from time 0 to 1
+        real radius;
+        color emission;
+
+        point3 center(double time) const { return start + static_cast<real>(time) * motion; }
+        double power() const { return luminance(emission) * double(radius) * radius; }
+        aabb bounds() const {
+            vec3 r(radius, radius, radius);
+            return aabb(aabb(start - r, start + r), aabb(start + motion - r, start + motion + r));
+        }
+    };
+
+    struct node {
+        aabb bounds;
+        double power = 0;
+        point3 middle;       // Center of the bounds
+        double extent2 = 0;  // Squared half diagonal of the bounds
+        int left = -1;       // Children, or -1 for a leaf
+        int right = -1;
+        int parent = -1;
+        uint32_t light = 0;  // Leaves: the light
+    };
+
+    std::vector<light> lights;
+    std::vector<node> nodes;          // Root first
+    std::vector<int> leaf_of_light;   // Node index of every light's leaf
+
+    // 1 - cos of the half angle of the cone a sphere of squared radius r2 subtends at squared
+    // distance d2, without the cancellation of computing the cosine first.
+    static double cone_width(double d2, double r2) {
+        double sin2 = r2 / d2;
+        return sin2 / (1 + std::sqrt(std::max(0.0, 1 - sin2)));
+    }
+
+    // Duff et al., "Building an Orthonormal Basis, Revisited" (JCGT 2017).
+    static void orthonormal_basis(const vec3& n, vec3& a, vec3& b) {
+        real sign = std::copysign(real(1), n.z());
+        real s = -1 / (sign + n.z());
+        real t = n.x() * n.y() * s;
+        a = vec3(1 + sign * n.x() * n.x() * s, sign * t, -sign * n.x());
+        b = vec3(t, sign + n.y() * n.y() * s, -n.y());
+    }
+
+    void build() {
+        nodes.clear();
+        leaf_of_light.assign(lights.size(), -1);
+        if (lights.empty())
+            return;
+        nodes.reserve(2 * lights.size() - 1);
+        std::vector<uint32_t> order(lights.size());
+        std::iota(order.begin(), order.end(), 0u);
+        build_node(order, 0, order.size(), -1);
+    }
+
+    // Median split of the light centers along the widest axis of their bounds.
+    int build_node(std::vector<uint32_t>& order, size_t begin, size_t end, int parent) {
+        int index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        nodes[index].parent = parent;
+        if (end - begin == 1) {
+            const light& l = lights[order[begin]];
+            set_bounds(nodes[index], l.bounds(), l.power());
+            nodes[index].light = order[begin];
+            leaf_of_light[order[begin]] = index;
+            return index;
+        }
+
+        aabb centers;
+        for (size_t i = begin; i < end; i++)
+            centers = aabb(centers, aabb(lights[order[i]].start, lights[order[i]].start + lights[order[i]].motion));
+        auto width = [&centers](int k) { return centers.axis_interval(k).max - centers.axis_interval(k).min; };
+        int axis = 0;
+        for (int k = 1; k < 3; k++) {
+            if (width(k) > width(axis))
+                axis = k;
+        }
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+            return lights[a].start[axis] < lights[b].start[axis];
+        });
+
+        int left = build_node(order, begin, mid, index);
+        int right = build_node(order, mid, end, index);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        set_bounds(nodes[index], aabb(nodes[left].bounds, nodes[right].bounds), nodes[left].power + nodes[right].power);
+        return index;
+    }
+
+    static void set_bounds(node& n, const aabb& bounds, double power) {
+        n.bounds = bounds;
+        n.power = power;
+        n.middle = point3(bounds.x.min + bounds.x.max, bounds.y.min + bounds.y.max, bounds.z.min + bounds.z.max) / 2;
+        vec3 half = point3(bounds.x.max, bounds.y.max, bounds.z.max) - n.middle;
+        n.extent2 = half.length_squared();
+    }
+
+    // How much the lights below `n` are worth to a shading point at `p`: their power over the
+    // squared distance to the center of their bounds. The distance is never taken as less than a
+    // quarter of the bounds' half diagonal, so a point close to or inside a cluster doesn't let it
+    // swamp everything else on one nearby light. Clamping at the whole half diagonal, as Conty
+    // Estevez and Kulla do, flattens every large node to plain power: with thousands of lights
+    // it left nearly twice the variance at equal samples.
+    static double importance(const node& n, const point3& p) {
+        double d2 = std::max(double((n.middle - p).length_squared()), n.extent2 / 16);
+        return n.power / std::max(d2, 1e-12);
+    }
+
+    // Probability of descending into `left` from its parent (the other child is `right`).
+    static double left_probability(const node& left, const node& right, const point3& p) {
+        double a = importance(left, p), b = importance(right, p);
+        return a + b > 0 ? a / (a + b) : 0.5;
+    }
+
+    size_t pick(const point3& p, double u, double& probability) const {
+        if (selection == light_selection::uniform || lights.size() == 1) {
+            size_t index = std::min(static_cast<size_t>(u * lights.size()), lights.size() - 1);
+            probability = 1.0 / lights.size();
+            return index;
+        }
+        probability = 1;
+        int at = 0;
+        while (nodes[at].left >= 0) {
+            const node& n = nodes[at];
+            double p_left = left_probability(nodes[n.left], nodes[n.right], p);
+            // Reuse the random number: rescale the part of [0,1) the choice left over.
+            if (u < p_left) {
+                u /= p_left;
+                probability *= p_left;
+                at = n.left;
+            }
+            else {
+                u = (u - p_left) / (1 - p_left);
+                probability *= 1 - p_left;
+                at = n.right;
+            }
+            u = std::min(u, 1 - std::numeric_limits<double>::epsilon());
+        }
+        return nodes[at].light;
+    }
+
+    // The chance that pick() from `p` returns `index`, walking up from its leaf.
+    double pick_probability(const point3& p, size_t index) const {
+        if (selection == light_selection::uniform || lights.size() == 1)
+            return 1.0 / lights.size();
+        double probability = 1;
+        for (int at = leaf_of_light[index]; nodes[at].parent >= 0; at = nodes[at].parent) {
+            const node& parent = nodes[nodes[at].parent];
+            double p_left = left_probability(nodes[parent.left], nodes[parent.right], p);
+            probability *= parent.left == at ? p_left : 1 - p_left;
+        }
+        return probability;
+    }
+
+    // The light whose surface `hit` lies on at `time`. Hit points carry the rounding of the
+    // intersection that found them, so "on" allows a small relative error.
+    bool find(const point3& hit, double time, size_t& index) const {
+        if (nodes.empty())
+            return false;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const node& n = nodes[stack[--top]];
+            double slack = 1e-4 * (std::sqrt(n.extent2) + std::abs(double(n.middle.x())) + std::abs(double(n.middle.y())) + std::abs(double(n.middle.z())));
+            bool inside = true;
+            for (int axis = 0; axis < 3 && inside; axis++) {
+                const interval& range = n.bounds.axis_interval(axis);
+                inside = hit[axis] >= range.min - slack && hit[axis] <= range.max + slack;
+            }
+            if (!inside)
+                continue;
+            if (n.left < 0) {
+                const light& l = lights[n.light];
+                double d = (hit - l.center(time)).length();
+                double tolerance = 1e-4 * l.radius + 1e-5 * (std::abs(double(hit.x())) + std::abs(double(hit.y())) + std::abs(double(hit.z())));
+                if (std::abs(d - l.radius) <= tolerance) {
+                    index = n.light;
+                    return true;
+                }
+                continue;
+            }
+            if (top + 2 > 64)
+                return false;
+            stack[top++] = n.left;
+            stack[top++] = n.right;
+        }
+        return false;
+    }
+};
+
+#endif
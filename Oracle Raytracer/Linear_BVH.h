@@ -0,0 +1,1047 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include "AABB.h"
+#include "Hittable.h"
+#include "Hittable_list.h"
+
+#include "Scene_geometry.h"
+#include "Sphere.h"
+#include "Sphere_soa.h"
+#include "Thread_pool.h"
+#include "Triangle_mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Flattened BVH.
+// All nodes live in one contiguous array in depth-first order, so the first child of an interior
+// node is always the next node in the array and only the second child needs an explicit offset.
+// Leaves reference a contiguous range of the reordered primitive array. Traversal is iterative
+// with a fixed-size stack and visits the child nearer to the ray origin first.
+//
+// The tree is built over a scene_geometry and leaves reference primitives by (kind, index), grouped
+// by kind. Spheres come first and are mirrored in leaf order into a sphere_soa, so a leaf tests all
+// of its spheres with one SIMD kernel call. Triangles follow, mirrored in leaf order into a
+// triangle_mesh that shares the scene's vertex buffer. Instances come next and are called
+// directly; only custom primitives go through hittable::hit.
+//
+// The default builder bins primitive centroids and picks splits with the Surface Area Heuristic;
+// large subtrees are built as parallel tasks on a thread_pool.
+//
+// Animated scenes move their primitives between frames and call refit() instead of building a new
+// tree. It recomputes every box bottom-up in one pass over the node array, which keeps the tree's
+// topology, so the tree slowly degrades as primitives drift away from the neighbours they were
+// grouped with. Each refit compares every subtree's SAH cost with its cost when it was built and
+// rebuilds the largest subtrees that degraded past refit_rebuild_ratio, splicing them back into
+// the array. The whole tree's cost is no guide here: one huge primitive, such as a ground sphere,
+// dominates the cost of all its ancestors. When the degraded subtrees hold most of the primitives,
+// the tree is built again from scratch instead.
+//
+// Node bounds enclose their primitives over the whole shutter interval. When spheres move, a node
+// above a fast one gets a long swept box that most rays cross without hitting anything. Two
+// remedies are tried at build time, and each is kept only where its SAH estimate says it pays for
+// the extra memory a traversal touches:
+//  - Node bounds at the start and the end of the interval. Primitives move linearly, so the box
+//    interpolated to a ray's time still encloses the node at that time. This is tight when the
+//    spheres under a node move together.
+//  - Time segments: the interval is split, and each segment gets its own tree over boxes swept
+//    only across that segment. A ray traverses the tree of its time. This is what helps when the
+//    spheres fly apart in different directions, which leaves every interpolated box as large as
+//    their spread.
+
+struct alignas(64) linear_bvh_node {
+    aabb     bounds;
+    uint32_t offset;    // Leaf: index of the first primitive. Interior: index of the second child.
+    uint32_t first_sphere;    // Leaf: index of its first sphere in the sphere mirror.
+    uint16_t count;           // Number of primitives in a leaf, 0 for interior nodes.
+    uint16_t sphere_count;    // Leading primitives of a leaf that are spheres,
+    uint16_t triangle_count;  // then triangles; the rest are instances, then custom.
+    uint8_t  axis;            // Split axis of an interior node.
+
+    bool is_leaf() const { return count > 0; }
+};
+
+enum class bvh_split_method {
+    sah,     // Binned Surface Area Heuristic
+    median   // Object median along the longest centroid axis
+};
+
+struct bvh_build_options {
+    bvh_split_method split_method = bvh_split_method::sah;
+    int    max_leaf_size = 4;            // Subtrees larger than this are always split
+    int    bin_count = 16;               // SAH candidate planes per axis
+    double traversal_cost = 1.0;         // SAH cost of visiting an interior node
+    double intersection_cost = 1.0;      // SAH cost of testing one primitive
+    int    thread_count = 0;             // Build threads (0 = all hardware threads, 1 = serial)
+    size_t parallel_threshold = 4096;    // Smallest subtree that is built as its own task
+    bool   motion_bounds = true;         // Keep node bounds at both ends of the shutter when primitives move
+    double motion_cost_ratio = 0.4;      // ...if they bring the SAH cost below this fraction of the swept boxes'
+    int    max_time_segments = 8;        // Upper limit on per-segment trees for fast motion (1 = one tree)
+    double segment_cost_ratio = 0.5;     // Segments are kept if their SAH cost is below this fraction of one tree's
+    interval shutter = interval(0, 1);   // Ray times the tree serves; sphere boxes cover only these
+    double refit_rebuild_ratio = 1.3;    // refit() rebuilds subtrees whose SAH cost grew past this factor
+};
+
+// Bounds of one node at the start and at the end of the shutter interval.
+struct linear_bvh_motion {
+    aabb start, end;
+
+    aabb at(real time) const {
+        return aabb(lerp(start.x, end.x, time), lerp(start.y, end.y, time), lerp(start.z, end.z, time));
+    }
+
+    static interval lerp(const interval& a, const interval& b, real time) {
+        return interval(a.min + time * (b.min - a.min), a.max + time * (b.max - a.max));
+    }
+};
+
+struct bvh_build_stats {
+    double build_ms = 0;     // Wall-clock build time
+    double sah_cost = 0;     // Expected cost of a random ray, relative to one primitive test
+    double motion_sah_cost = 0;  // The same with node bounds interpolated to the ray's time (0 without them)
+    size_t node_count = 0;
+    size_t leaf_count = 0;
+    int    depth = 0;
+    size_t node_bytes = 0;       // Node array, and the interpolated bounds of moving scenes where kept
+    size_t primitive_bytes = 0;  // Leaf-order primitive references and the sphere and triangle mirrors (not the shared vertex buffer)
+};
+
+// What one linear_bvh::refit() did.
+struct bvh_refit_stats {
+    double refit_ms = 0;              // Wall-clock time, rebuilds included
+    double sah_ratio = 1;             // Whole-tree SAH cost after refitting relative to the last build
+    size_t rebuilt_subtrees = 0;      // Subtrees rebuilt in place
+    size_t rebuilt_primitives = 0;    // Primitives under them, or all of them after a full rebuild
+    bool   full_rebuild = false;      // The tree was built again from scratch
+};
+
+class linear_bvh : public hittable {
+public:
+    static constexpr int max_depth = 64;  // Also the traversal stack size.
+
+    linear_bvh(const hittable_list& list, const bvh_build_options& options = bvh_build_options())
+        : linear_bvh(scene_geometry(list), options) {}
+
+    linear_bvh(const scene_geometry& geometry, const bvh_build_options& options = bvh_build_options())
+        : primitives(geometry.primitives()), custom(geometry.custom), options(options)
+    {
+        this->options.max_leaf_size = std::max(1, std::min(options.max_leaf_size, 0xffff));
+        this->options.bin_count = std::max(2, options.bin_count);
+
+        auto start_time = std::chrono::steady_clock::now();
+        if (!primitives.empty())
+            build_all(geometry);
+        compute_stats();
+        // Interpolated bounds cost a second cache line per node visit; they only pay for themselves
+        // where the spheres under each node move together and the expected cost drops well below
+        // that of the swept boxes.
+        if (!motion.empty() && stats.motion_sah_cost > options.motion_cost_ratio * stats.sah_cost)
+            motion = std::vector<linear_bvh_motion>();
+        if (motion.empty())
+            try_time_segments(geometry);
+        stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+        compute_stats();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!segments.empty())
+            return segment_at(r.time()).hit(r, ray_t, rec);
+        if (nodes.empty())
+            return false;
+        return motion.empty() ? traverse<false>(r, ray_t, rec) : traverse<true>(r, ray_t, rec);
+    }
+
+    // Packet traversal for coherent rays: a node is entered if any live lane hits its box, and
+    // the box test covers all lanes with one SIMD kernel. Leaves are then intersected lane by lane.
+    // In moving scenes the lanes' times differ, and their own interpolated boxes or time segments
+    // cull far better than the shared swept boxes, so each lane traverses on its own.
+    void hit_packet(ray_packet& packet, packet_hits& hits) const override {
+        if (!motion.empty() || !segments.empty()) {
+            hittable::hit_packet(packet, hits);
+            return;
+        }
+        if (nodes.empty() || packet.count == 0)
+            return;
+
+        simd_level level = spheres.get_simd_level();
+        uint32_t live = packet.active_mask();
+        if (live == 0)
+            return;
+
+        // Coherent rays share direction signs; order children by the first live lane's.
+        int first = 0;
+        while (!(live & (1u << first)))
+            first++;
+        bool dir_is_neg[3] = { packet.inv_x[first] < 0, packet.inv_y[first] < 0, packet.inv_z[first] < 0 };
+
+        uint32_t stack[max_depth];
+        int stack_size = 0;
+        uint32_t current = 0;
+
+        while (true) {
+            const linear_bvh_node& node = nodes[current];
+            uint32_t mask = packet_box_mask(node.bounds, packet, level) & live;
+            ORACLE_STAT(render_counters::local().bvh_nodes++);
+            ORACLE_STAT(render_counters::local().aabb_tests += packet.count);
+
+            if (mask != 0) {
+                if (node.is_leaf()) {
+                    for (int i = 0; i < packet.count; i++) {
+                        if (!(mask & (1u << i)))
+                            continue;
+                        interval ray_t(packet.t_min[i], packet.t_max[i]);
+                        triangle_ray tri_ray = node.triangle_count > 0 ? triangle_ray(packet.rays[i]) : triangle_ray();
+                        if (hit_leaf(node, packet.rays[i], tri_ray, ray_t, hits.rec[i])) {
+                            hits.hit[i] = true;
+                            packet.t_max[i] = ray_t.max;
+                        }
+                    }
+                }
+                else {
+                    if (dir_is_neg[node.axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+    }
+
+    aabb bounding_box() const override {
+        aabb box = nodes.empty() ? aabb::empty : nodes[0].bounds;
+        for (const auto& segment : segments)
+            box = aabb(box, segment.bounding_box());
+        return box;
+    }
+
+    // Updates the tree for new positions of the primitives of `geometry`, which must be the geometry
+    // the tree was built over or one with the same primitives in the same order. Anything else (a
+    // different primitive count, a new vertex buffer) gets a full rebuild.
+    bvh_refit_stats refit(const scene_geometry& geometry) {
+        auto start_time = std::chrono::steady_clock::now();
+        bvh_refit_stats result;
+        if (!segments.empty()) {
+            for (auto& segment : segments) {
+                bvh_refit_stats s = segment.refit(geometry);
+                result.sah_ratio = std::max(result.sah_ratio, s.sah_ratio);
+                result.rebuilt_subtrees += s.rebuilt_subtrees;
+                result.rebuilt_primitives += s.rebuilt_primitives;
+                result.full_rebuild = result.full_rebuild || s.full_rebuild;
+            }
+            compute_stats();
+        }
+        else if (!same_primitives(geometry)) {
+            rebuild(geometry, result);
+        }
+        else {
+            // The tree as built is the reference every later refit is measured against.
+            if (reference_area.empty()) {
+                reference_area.resize(nodes.size());
+                for (size_t n = 0; n < nodes.size(); n++)
+                    reference_area[n] = nodes[n].bounds.surface_area();
+            }
+            update_mirrors(geometry);
+            refit_bounds();
+
+            std::vector<double> cost, reference;
+            subtree_costs(cost, reference);
+            result.sah_ratio = nodes.empty() || reference[0] <= 0 ? 1 : cost[0] / reference[0];
+            rebuild_degraded(geometry, cost, reference, result);
+            if (!result.full_rebuild)
+                compute_stats();
+        }
+        result.refit_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        return result;
+    }
+
+    size_t node_count() const { return stats.node_count; }
+    size_t primitive_count() const { return segments.empty() ? primitives.size() : segments[0].primitive_count(); }
+    size_t time_segment_count() const { return std::max<size_t>(1, segments.size()); }
+    const bvh_build_stats& build_stats() const { return stats; }
+
+    void set_simd_level(simd_level level) {
+        spheres.set_simd_level(level);
+        for (auto& segment : segments)
+            segment.set_simd_level(level);
+    }
+
+private:
+    struct build_entry {
+        aabb     box;
+        point3   center;
+        uint32_t index;
+    };
+
+    // Nodes of one subtree in depth-first order. Interior offsets are relative to the chunk start;
+    // leaf offsets index the shared entry array and are already absolute.
+    using node_chunk = std::vector<linear_bvh_node>;
+
+    std::vector<linear_bvh_node> nodes;
+    std::vector<linear_bvh_motion> motion;     // Per node, or empty when nothing moves
+    std::vector<linear_bvh> segments;          // Per time segment, or empty when this is the only tree
+    std::vector<primitive_ref> primitives;     // In leaf order
+    std::vector<uint32_t> source;              // Per primitive: its index in the geometry's storage of its kind
+    std::vector<real> reference_area;          // Per node: its area when built; filled by the first refit
+    std::vector<instance> instances;           // The instances of `primitives`, in leaf order
+    std::vector<shared_ptr<hittable>> custom;  // The geometry's custom bucket, indexed by primitive_ref
+    sphere_soa spheres;         // The spheres of `primitives`, in leaf order
+    triangle_mesh triangles;    // The triangles of `primitives`, in leaf order
+    bvh_build_options options;
+    bvh_build_stats stats;
+
+    // Closest-hit traversal of one ray. Moving scenes test each node's box at the ray's time.
+    template <bool moving>
+    bool traverse(const ray& r, interval ray_t, hit_record& rec) const {
+        real shutter_time = moving ? (r.time() - options.shutter.min) / (options.shutter.max - options.shutter.min) : 0;
+        const vec3& dir = r.direction();
+        vec3 inv_dir(1.0 / dir.x(), 1.0 / dir.y(), 1.0 / dir.z());
+        bool dir_is_neg[3] = { inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0 };
+        // Shear for the triangle test, set up once per ray rather than per leaf.
+        triangle_ray tri_ray = triangles.size() > 0 ? triangle_ray(r) : triangle_ray();
+
+        uint32_t stack[max_depth];
+        int stack_size = 0;
+        uint32_t current = 0;
+        bool hit_anything = false;
+        ORACLE_STAT(uint64_t visited = 0);
+
+        while (true) {
+            const linear_bvh_node& node = nodes[current];
+            ORACLE_STAT(visited++);
+
+            bool enter = moving ? motion[current].at(shutter_time).hit(r.origin(), inv_dir, ray_t)
+                                : node.bounds.hit(r.origin(), inv_dir, ray_t);
+            if (enter) {
+                if (node.is_leaf()) {
+                    if (hit_leaf(node, r, tri_ray, ray_t, rec))
+                        hit_anything = true;
+                }
+                else {
+                    // Descend into the near child first and defer the far one.
+                    if (dir_is_neg[node.axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+
+        // Every visited node costs one box test.
+        ORACLE_STAT(render_counters::local().bvh_nodes += visited);
+        ORACLE_STAT(render_counters::local().aabb_tests += visited);
+        return hit_anything;
+    }
+
+    // Intersects one ray with the primitives of a leaf, lowering ray_t.max on a hit.
+    bool hit_leaf(const linear_bvh_node& node, const ray& r, const triangle_ray& tri_ray, interval& ray_t,
+        hit_record& rec) const
+    {
+        bool hit_anything = false;
+
+        real t;
+        size_t index;
+        if (spheres.closest_hit(r, ray_t, node.first_sphere, node.first_sphere + node.sphere_count, t, index)) {
+            spheres.resolve(r, t, index, rec);
+            hit_anything = true;
+            ray_t.max = t;
+        }
+
+        uint32_t triangle_begin = node.offset + node.sphere_count;
+        uint32_t custom_begin = triangle_begin + node.triangle_count;
+        for (uint32_t i = triangle_begin; i < custom_begin; i++) {
+            if (triangles.hit(primitives[i].index, r, tri_ray, ray_t, rec)) {
+                hit_anything = true;
+                ray_t.max = rec.t;
+            }
+        }
+
+        // Instances and custom primitives, told apart by their kind.
+        for (uint32_t i = custom_begin; i < node.offset + node.count; i++) {
+            const primitive_ref& p = primitives[i];
+            bool hit = p.kind == primitive_kind::instance
+                ? instances[p.index].instance::hit(r, ray_t, rec)
+                : custom[p.index]->hit(r, ray_t, rec);
+            if (hit) {
+                hit_anything = true;
+                ray_t.max = rec.t;
+            }
+        }
+        return hit_anything;
+    }
+
+    // Spheres that travel many diameters in different directions leave no tight node bounds at
+    // all; slicing the shutter interval cuts every swept box down to its slice. Each segment is a
+    // tree of its own, so a ray's traversal draws on more memory, and the segments replace this
+    // tree only if they cut its expected cost by segment_cost_ratio.
+    void try_time_segments(const scene_geometry& geometry) {
+        int count = choose_time_segments(geometry);
+        if (count <= 1)
+            return;
+
+        bvh_build_options segment_options = options;
+        segment_options.max_time_segments = 1;
+        real width = (options.shutter.max - options.shutter.min) / count;
+        std::vector<linear_bvh> candidates;
+        candidates.reserve(count);
+        double segment_cost = 0;
+        for (int k = 0; k < count; k++) {
+            real end = k + 1 == count ? options.shutter.max : options.shutter.min + (k + 1) * width;
+            segment_options.shutter = interval(options.shutter.min + k * width, end);
+            candidates.emplace_back(geometry, segment_options);
+            // SAH costs are relative to the root's area; compare them in absolute terms.
+            segment_cost += candidates.back().stats.sah_cost * candidates.back().bounding_box().surface_area() / count;
+        }
+        if (segment_cost > options.segment_cost_ratio * stats.sah_cost * bounding_box().surface_area())
+            return;
+
+        // The segments hold their own trees and primitives.
+        segments.swap(candidates);
+        nodes = std::vector<linear_bvh_node>();
+        primitives = std::vector<primitive_ref>();
+        instances = std::vector<instance>();
+        custom = std::vector<shared_ptr<hittable>>();
+        spheres = sphere_soa();
+        triangles = triangle_mesh();
+    }
+
+    // Only worth trying once the spheres travel many diameters: one segment per four diameters the
+    // mean sphere travels across the shutter interval, and none below eight.
+    int choose_time_segments(const scene_geometry& geometry) const {
+        const sphere_soa& s = geometry.spheres;
+        if (options.max_time_segments <= 1 || s.size() == 0)
+            return 1;
+        double travel = 0, diameter = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            travel += s.motion(i).length();
+            diameter += 2 * s.get_radius(i);
+        }
+        travel *= options.shutter.max - options.shutter.min;
+        if (!(travel >= 8 * diameter))
+            return 1;
+        return static_cast<int>(std::min<double>(options.max_time_segments, std::floor(travel / (4 * diameter))));
+    }
+
+    const linear_bvh& segment_at(real time) const {
+        real width = (options.shutter.max - options.shutter.min) / segments.size();
+        int k = static_cast<int>((time - options.shutter.min) / width);
+        return segments[std::min(std::max(k, 0), static_cast<int>(segments.size()) - 1)];
+    }
+
+    // A primitive's box over this tree's shutter interval.
+    aabb primitive_bounds(const scene_geometry& geometry, primitive_ref p) const {
+        if (p.kind != primitive_kind::sphere)
+            return geometry.bounding_box(p);
+        return aabb(geometry.spheres.bounding_box(p.index, options.shutter.min),
+            geometry.spheres.bounding_box(p.index, options.shutter.max));
+    }
+
+    bool same_primitives(const scene_geometry& geometry) const {
+        size_t sphere_count = 0, triangle_count = 0, instance_count = 0, custom_count = 0;
+        for (const auto& p : geometry.primitives()) {
+            sphere_count += p.kind == primitive_kind::sphere;
+            triangle_count += p.kind == primitive_kind::triangle;
+            instance_count += p.kind == primitive_kind::instance;
+            custom_count += p.kind == primitive_kind::custom;
+        }
+        return geometry.size() == primitives.size() && sphere_count == spheres.size()
+            && triangle_count == triangles.size() && instance_count == instances.size()
+            && custom_count == custom.size() && geometry.custom.size() == custom.size()
+            && (triangle_count == 0 || triangles.shares_vertices(geometry.triangles));
+    }
+
+    void rebuild(const scene_geometry& geometry, bvh_refit_stats& result) {
+        *this = linear_bvh(geometry, options);
+        result.full_rebuild = true;
+        result.rebuilt_primitives = geometry.size();
+    }
+
+    // Copies the current state of every primitive into the leaf-order mirrors. Triangles need
+    // nothing: their vertices live in the shared buffer.
+    void update_mirrors(const scene_geometry& geometry) {
+        for (size_t i = 0; i < primitives.size(); i++) {
+            const primitive_ref& p = primitives[i];
+            if (p.kind == primitive_kind::sphere)
+                spheres.set(p.index, geometry.spheres, source[i]);
+            else if (p.kind == primitive_kind::instance)
+                instances[p.index] = geometry.instances[source[i]];
+        }
+        custom = geometry.custom;
+    }
+
+    // A mirrored primitive's box over this tree's shutter interval.
+    aabb mirror_bounds(const primitive_ref& p) const {
+        switch (p.kind) {
+        case primitive_kind::sphere:
+            return aabb(spheres.bounding_box(p.index, options.shutter.min), spheres.bounding_box(p.index, options.shutter.max));
+        case primitive_kind::triangle: return triangles.bounding_box(p.index);
+        case primitive_kind::instance: return instances[p.index].bounding_box();
+        default:                       return custom[p.index]->bounding_box();
+        }
+    }
+
+    // Recomputes every box bottom-up: children follow their parent in the array.
+    void refit_bounds() {
+        for (size_t n = nodes.size(); n-- > 0;) {
+            linear_bvh_node& node = nodes[n];
+            if (node.is_leaf()) {
+                aabb box = aabb::empty;
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                    box = aabb(box, mirror_bounds(primitives[i]));
+                node.bounds = box;
+            }
+            else {
+                node.bounds = aabb(nodes[n + 1].bounds, nodes[node.offset].bounds);
+            }
+        }
+        if (!motion.empty())
+            build_motion_bounds();
+    }
+
+    // Unnormalized SAH cost of every subtree, with the current boxes and with the reference areas.
+    void subtree_costs(std::vector<double>& cost, std::vector<double>& reference) const {
+        cost.assign(nodes.size(), 0);
+        reference.assign(nodes.size(), 0);
+        for (size_t n = nodes.size(); n-- > 0;) {
+            const linear_bvh_node& node = nodes[n];
+            double c = node.is_leaf() ? options.intersection_cost * node.count : options.traversal_cost;
+            cost[n] = node.bounds.surface_area() * c;
+            reference[n] = reference_area[n] * c;
+            if (!node.is_leaf()) {
+                cost[n] += cost[n + 1] + cost[node.offset];
+                reference[n] += reference[n + 1] + reference[node.offset];
+            }
+        }
+    }
+
+    // The nodes [root, node_end) of a subtree and its primitives [first, end).
+    struct subtree_extent {
+        uint32_t root, node_end, first, end;
+        int depth;
+    };
+
+    subtree_extent subtree_range(uint32_t n, int depth) const {
+        uint32_t last_leaf = n;
+        while (!nodes[last_leaf].is_leaf())
+            last_leaf = nodes[last_leaf].offset;
+        uint32_t first_leaf = n;
+        while (!nodes[first_leaf].is_leaf())
+            first_leaf++;
+        return { n, last_leaf + 1, nodes[first_leaf].offset, nodes[last_leaf].offset + nodes[last_leaf].count, depth };
+    }
+
+    // Rebuilds the topmost degraded subtrees, or the whole tree if they cover more than half the
+    // primitives. The subtrees own disjoint ranges of primitives and mirror slots, so they are
+    // rebuilt in parallel, and then spliced into the node array in one pass.
+    void rebuild_degraded(const scene_geometry& geometry, const std::vector<double>& cost,
+        const std::vector<double>& reference, bvh_refit_stats& result)
+    {
+        std::vector<subtree_extent> targets;
+        std::vector<std::pair<uint32_t, int>> pending = { { 0, 0 } };
+        size_t degraded_primitives = 0;
+        while (!pending.empty()) {
+            uint32_t n = pending.back().first;
+            int depth = pending.back().second;
+            pending.pop_back();
+            const linear_bvh_node& node = nodes[n];
+            if (node.is_leaf())
+                continue;
+            if (cost[n] > options.refit_rebuild_ratio * reference[n]) {
+                targets.push_back(subtree_range(n, depth));
+                degraded_primitives += targets.back().end - targets.back().first;
+                continue;
+            }
+            pending.push_back({ n + 1, depth + 1 });
+            pending.push_back({ node.offset, depth + 1 });
+        }
+        if (targets.empty())
+            return;
+        if (degraded_primitives > primitives.size() / 2) {
+            rebuild(geometry, result);
+            return;
+        }
+
+        std::sort(targets.begin(), targets.end(),
+            [](const subtree_extent& a, const subtree_extent& b) { return a.root < b.root; });
+        std::vector<node_chunk> chunks(targets.size());
+        if (options.thread_count == 1 || degraded_primitives < options.parallel_threshold) {
+            for (size_t t = 0; t < targets.size(); t++)
+                chunks[t] = rebuild_subtree(geometry, targets[t]);
+        }
+        else {
+            // Batches of neighbouring subtrees, a few per thread.
+            thread_pool pool(options.thread_count);
+            size_t batch = std::max<size_t>(1, targets.size() / (4 * pool.size()));
+            task_group group(pool);
+            for (size_t begin = 0; begin < targets.size(); begin += batch) {
+                size_t end = std::min(targets.size(), begin + batch);
+                group.run([&, begin, end] {
+                    for (size_t t = begin; t < end; t++)
+                        chunks[t] = rebuild_subtree(geometry, targets[t]);
+                });
+            }
+            group.wait();
+        }
+        splice(targets, chunks);
+
+        result.rebuilt_subtrees += targets.size();
+        result.rebuilt_primitives += degraded_primitives;
+        if (!motion.empty())
+            build_motion_bounds();
+    }
+
+    // Builds a subtree again over the same primitives, reordering its range of primitives and
+    // mirror slots to match. Returns its nodes with chunk-relative interior offsets, for splice().
+    node_chunk rebuild_subtree(const scene_geometry& geometry, const subtree_extent& subtree) {
+        uint32_t first = subtree.first, end = subtree.end;
+
+        // Mirror slots of the range start at its first primitive of each kind.
+        uint32_t slot[4] = { 0, 0, 0, 0 };
+        bool seen[4] = { false, false, false, false };
+        std::vector<build_entry> entries;
+        entries.reserve(end - first);
+        for (uint32_t i = first; i < end; i++) {
+            const primitive_ref& p = primitives[i];
+            int kind = static_cast<int>(p.kind);
+            slot[kind] = seen[kind] ? std::min(slot[kind], p.index) : p.index;
+            seen[kind] = true;
+            aabb box = mirror_bounds(p);
+            entries.push_back({ box, centroid(box), i - first });
+        }
+
+        node_chunk chunk;
+        build(entries, 0, entries.size(), subtree.depth, chunk, nullptr);
+
+        // Back to geometry indices, in the new order, grouped by kind within each leaf.
+        std::vector<primitive_ref> ordered;
+        ordered.reserve(entries.size());
+        for (const auto& e : entries)
+            ordered.push_back({ primitives[first + e.index].kind, source[first + e.index] });
+        for (auto& node : chunk) {
+            if (node.is_leaf()) {
+                group_leaf(node, ordered.begin() + node.offset);
+                node.offset += first;
+            }
+        }
+
+        // Mirror them into the range's slots.
+        for (uint32_t i = first; i < end; i++) {
+            primitive_ref p = ordered[i - first];
+            source[i] = p.index;
+            uint32_t& next = slot[static_cast<int>(p.kind)];
+            if (p.kind == primitive_kind::sphere)
+                spheres.set(next, geometry.spheres, p.index);
+            else if (p.kind == primitive_kind::triangle)
+                triangles.set(next, geometry.triangles, p.index);
+            else if (p.kind == primitive_kind::instance)
+                instances[next] = geometry.instances[p.index];
+            if (p.kind != primitive_kind::custom)
+                p.index = next++;
+            primitives[i] = p;
+        }
+        for (auto& node : chunk) {
+            if (node.is_leaf())
+                node.first_sphere = node.sphere_count > 0 ? primitives[node.offset].index : 0;
+        }
+        return chunk;
+    }
+
+    // Replaces each subtree's nodes with its chunk and points every second-child offset at the
+    // new position of its node. Rebuilt nodes get their new areas as reference.
+    void splice(const std::vector<subtree_extent>& subtrees, const std::vector<node_chunk>& chunks) {
+        std::vector<linear_bvh_node> spliced;
+        std::vector<real> areas;
+        std::vector<uint32_t> new_index(nodes.size());
+        std::vector<uint32_t> kept_interior;
+        spliced.reserve(nodes.size());
+        areas.reserve(nodes.size());
+        size_t t = 0;
+        for (uint32_t k = 0; k < nodes.size();) {
+            uint32_t base = static_cast<uint32_t>(spliced.size());
+            new_index[k] = base;
+            if (t < subtrees.size() && k == subtrees[t].root) {
+                for (linear_bvh_node node : chunks[t]) {
+                    if (!node.is_leaf())
+                        node.offset += base;
+                    spliced.push_back(node);
+                    areas.push_back(node.bounds.surface_area());
+                }
+                k = subtrees[t++].node_end;
+                continue;
+            }
+            if (!nodes[k].is_leaf())
+                kept_interior.push_back(base);
+            spliced.push_back(nodes[k]);
+            areas.push_back(reference_area[k]);
+            k++;
+        }
+        for (uint32_t k : kept_interior)
+            spliced[k].offset = new_index[spliced[k].offset];
+        nodes.swap(spliced);
+        reference_area.swap(areas);
+    }
+
+    // Orders a leaf's primitives by kind (spheres, triangles, instances, then custom) and counts
+    // the first two.
+    template <typename Iterator>
+    static void group_leaf(linear_bvh_node& node, Iterator first) {
+        std::stable_sort(first, first + node.count,
+            [](const primitive_ref& a, const primitive_ref& b) { return a.kind < b.kind; });
+        node.sphere_count = static_cast<uint16_t>(std::count_if(first, first + node.count,
+            [](const primitive_ref& p) { return p.kind == primitive_kind::sphere; }));
+        node.triangle_count = static_cast<uint16_t>(std::count_if(first, first + node.count,
+            [](const primitive_ref& p) { return p.kind == primitive_kind::triangle; }));
+    }
+
+    static point3 centroid(const aabb& box) {
+        return point3(0.5 * (box.x.min + box.x.max), 0.5 * (box.y.min + box.y.max), 0.5 * (box.z.min + box.z.max));
+    }
+
+    void build_all(const scene_geometry& geometry) {
+        std::vector<build_entry> entries;
+        entries.reserve(primitives.size());
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            auto box = primitive_bounds(geometry, primitives[i]);
+            entries.push_back({ box, centroid(box), i });
+        }
+
+        if (options.thread_count == 1 || entries.size() < options.parallel_threshold) {
+            nodes.reserve(2 * entries.size());
+            build(entries, 0, entries.size(), 0, nodes, nullptr);
+        }
+        else {
+            thread_pool pool(options.thread_count);
+            build(entries, 0, entries.size(), 0, nodes, &pool);
+        }
+        // The reservation above assumes single-primitive leaves; give back what larger leaves left unused.
+        nodes.shrink_to_fit();
+
+        // Reorder the primitives so every leaf covers a contiguous range.
+        std::vector<primitive_ref> ordered;
+        ordered.reserve(entries.size());
+        for (const auto& e : entries)
+            ordered.push_back(primitives[e.index]);
+        primitives.swap(ordered);
+
+        // Group each leaf's primitives by kind: spheres, triangles, instances, then custom.
+        for (auto& node : nodes) {
+            if (node.is_leaf())
+                group_leaf(node, primitives.begin() + node.offset);
+        }
+
+        // Mirror spheres, triangles and instances in leaf order and point their refs at the mirrors,
+        // so each leaf's spheres form one contiguous range for the SIMD kernels.
+        spheres.reserve(geometry.spheres.size());
+        instances.reserve(geometry.instances.size());
+        triangles.share_vertices(geometry.triangles);
+        triangles.reserve(triangles.vertex_count(), geometry.triangles.size());
+        source.reserve(primitives.size());
+        for (auto& p : primitives) {
+            source.push_back(p.index);
+            if (p.kind == primitive_kind::sphere) {
+                spheres.add(geometry.spheres, p.index);
+                p.index = static_cast<uint32_t>(spheres.size() - 1);
+            } else if (p.kind == primitive_kind::triangle) {
+                triangles.add(geometry.triangles, p.index);
+                p.index = static_cast<uint32_t>(triangles.size() - 1);
+            } else if (p.kind == primitive_kind::instance) {
+                instances.push_back(geometry.instances[p.index]);
+                p.index = static_cast<uint32_t>(instances.size() - 1);
+            }
+        }
+        for (auto& node : nodes) {
+            if (node.is_leaf())
+                node.first_sphere = node.sphere_count > 0 ? primitives[node.offset].index : 0;
+        }
+
+        if (options.motion_bounds)
+            build_motion_bounds();
+    }
+
+    // Fills `motion` if any sphere moves, with node bounds at both ends of the shutter interval.
+    // Children follow their parent in the array, so walking it backwards finishes both children
+    // before the parent. Only spheres move; every other primitive uses its one box at both ends.
+    void build_motion_bounds() {
+        bool any_moving = false;
+        for (size_t i = 0; i < spheres.size() && !any_moving; i++)
+            any_moving = spheres.is_moving(i);
+        if (!any_moving) {
+            motion = std::vector<linear_bvh_motion>();
+            return;
+        }
+
+        motion.resize(nodes.size());
+        for (size_t n = nodes.size(); n-- > 0;) {
+            const linear_bvh_node& node = nodes[n];
+            linear_bvh_motion& m = motion[n];
+            if (!node.is_leaf()) {
+                const linear_bvh_motion& a = motion[n + 1];
+                const linear_bvh_motion& b = motion[node.offset];
+                m.start = aabb(a.start, b.start);
+                m.end = aabb(a.end, b.end);
+                continue;
+            }
+            m.start = m.end = aabb::empty;
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                const primitive_ref& p = primitives[i];
+                if (p.kind == primitive_kind::sphere) {
+                    m.start = aabb(m.start, spheres.bounding_box(p.index, options.shutter.min));
+                    m.end = aabb(m.end, spheres.bounding_box(p.index, options.shutter.max));
+                    continue;
+                }
+                aabb box = p.kind == primitive_kind::triangle ? triangles.bounding_box(p.index)
+                         : p.kind == primitive_kind::instance ? instances[p.index].bounding_box()
+                         : custom[p.index]->bounding_box();
+                m.start = aabb(m.start, box);
+                m.end = aabb(m.end, box);
+            }
+        }
+    }
+
+    // Appends the subtree over entries[start, end) to `out` and returns its root's index in `out`.
+    uint32_t build(std::vector<build_entry>& entries, size_t start, size_t end, int depth,
+        node_chunk& out, thread_pool* pool) const
+    {
+        uint32_t index = static_cast<uint32_t>(out.size());
+        out.emplace_back();
+
+        aabb bounds = aabb::empty;
+        aabb centroid_bounds = aabb::empty;
+        for (size_t i = start; i < end; i++) {
+            bounds = aabb(bounds, entries[i].box);
+            centroid_bounds = aabb(centroid_bounds, aabb(entries[i].center, entries[i].center));
+        }
+
+        size_t span = end - start;
+        int axis = 0;
+        size_t mid = choose_split(entries, start, end, bounds, centroid_bounds, depth, axis);
+
+        if (mid == start) {
+            out[index].bounds = bounds;
+            out[index].offset = static_cast<uint32_t>(start);
+            out[index].count = static_cast<uint16_t>(span);
+            out[index].sphere_count = 0;
+            out[index].triangle_count = 0;
+            out[index].axis = 0;
+            return index;
+        }
+
+        out[index].bounds = bounds;
+        out[index].count = 0;
+        out[index].sphere_count = 0;
+        out[index].triangle_count = 0;
+        out[index].axis = static_cast<uint8_t>(axis);
+
+        if (pool && span >= options.parallel_threshold) {
+            // Build the second child as a task while this thread builds the first, then splice
+            // both chunks in behind this node.
+            node_chunk left, right;
+            {
+                task_group group(*pool);
+                group.run([&] { build(entries, mid, end, depth + 1, right, pool); });
+                build(entries, start, mid, depth + 1, left, pool);
+            }
+            append_chunk(out, left);
+            out[index].offset = static_cast<uint32_t>(out.size());
+            append_chunk(out, right);
+        }
+        else {
+            build(entries, start, mid, depth + 1, out, nullptr);
+            out[index].offset = build(entries, mid, end, depth + 1, out, nullptr);
+        }
+        return index;
+    }
+
+    static void append_chunk(node_chunk& out, const node_chunk& chunk) {
+        uint32_t base = static_cast<uint32_t>(out.size());
+        for (auto node : chunk) {
+            if (!node.is_leaf())
+                node.offset += base;
+            out.push_back(node);
+        }
+    }
+
+    // Partitions entries[start, end) and returns the split position, or `start` to make a leaf.
+    size_t choose_split(std::vector<build_entry>& entries, size_t start, size_t end,
+        const aabb& bounds, const aabb& centroid_bounds, int depth, int& axis) const
+    {
+        axis = centroid_bounds.longest_axis();
+        size_t span = end - start;
+        size_t max_leaf = static_cast<size_t>(options.max_leaf_size);
+        if (span <= 1)
+            return start;
+
+        // Near the traversal stack limit, fall back to median splits; they halve the span every level.
+        bool median = options.split_method == bvh_split_method::median || depth >= max_depth - 24;
+        if (median) {
+            if (span <= max_leaf || depth >= max_depth - 1)
+                return start;
+            return median_split(entries, start, end, axis);
+        }
+
+        int bins = options.bin_count;
+        double best_cost = infinity;
+        int best_axis = -1;
+        int best_bin = 0;
+
+        struct bin { aabb box; size_t count = 0; };
+        std::vector<bin> bin_data(bins);
+        std::vector<double> right_cost(bins);
+
+        for (int candidate = 0; candidate < 3; candidate++) {
+            const interval& extent = centroid_bounds.axis_interval(candidate);
+            double width = extent.max - extent.min;
+            if (width <= 0)
+                continue;
+
+            for (auto& b : bin_data)
+                b = bin();
+            double scale = bins / width;
+            for (size_t i = start; i < end; i++) {
+                int b = std::min(bins - 1, static_cast<int>((entries[i].center[candidate] - extent.min) * scale));
+                bin_data[b].box = aabb(bin_data[b].box, entries[i].box);
+                bin_data[b].count++;
+            }
+
+            // Sweep from the right to get the cost of everything above each plane...
+            aabb right_box = aabb::empty;
+            size_t right_count = 0;
+            for (int b = bins - 1; b > 0; b--) {
+                right_box = aabb(right_box, bin_data[b].box);
+                right_count += bin_data[b].count;
+                right_cost[b] = right_box.surface_area() * right_count;
+            }
+
+            // ...then from the left, combining both halves for the plane below bin b.
+            aabb left_box = aabb::empty;
+            size_t left_count = 0;
+            for (int b = 1; b < bins; b++) {
+                left_box = aabb(left_box, bin_data[b - 1].box);
+                left_count += bin_data[b - 1].count;
+                if (left_count == 0 || left_count == span)
+                    continue;
+                double cost = left_box.surface_area() * left_count + right_cost[b];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = candidate;
+                    best_bin = b;
+                }
+            }
+        }
+
+        double parent_area = bounds.surface_area();
+        double leaf_cost = options.intersection_cost * span;
+
+        if (best_axis < 0) {
+            // All centroids coincide; no plane can separate them.
+            if (span <= max_leaf)
+                return start;
+            return median_split(entries, start, end, axis);
+        }
+
+        double split_cost = options.traversal_cost
+            + (parent_area > 0 ? options.intersection_cost * best_cost / parent_area : leaf_cost);
+        if (span <= max_leaf && leaf_cost <= split_cost)
+            return start;
+
+        axis = best_axis;
+        const interval& extent = centroid_bounds.axis_interval(best_axis);
+        double scale = bins / (extent.max - extent.min);
+        auto split = std::partition(entries.begin() + start, entries.begin() + end,
+            [&](const build_entry& e) {
+                int b = std::min(bins - 1, static_cast<int>((e.center[best_axis] - extent.min) * scale));
+                return b < best_bin;
+            });
+        size_t mid = static_cast<size_t>(split - entries.begin());
+        if (mid == start || mid == end)
+            return median_split(entries, start, end, best_axis);
+        return mid;
+    }
+
+    static size_t median_split(std::vector<build_entry>& entries, size_t start, size_t end, int axis) {
+        size_t mid = start + (end - start) / 2;
+        std::nth_element(entries.begin() + start, entries.begin() + mid, entries.begin() + end,
+            [axis](const build_entry& a, const build_entry& b) { return a.center[axis] < b.center[axis]; });
+        return mid;
+    }
+
+    void compute_stats() {
+        if (!segments.empty()) {
+            // Totals over the segments; a ray pays the cost of one of them.
+            stats = bvh_build_stats{ stats.build_ms };
+            for (const auto& segment : segments) {
+                const bvh_build_stats& s = segment.build_stats();
+                stats.sah_cost += s.sah_cost / segments.size();
+                stats.motion_sah_cost += s.motion_sah_cost / segments.size();
+                stats.node_count += s.node_count;
+                stats.leaf_count += s.leaf_count;
+                stats.depth = std::max(stats.depth, s.depth);
+                stats.node_bytes += s.node_bytes;
+                stats.primitive_bytes += s.primitive_bytes;
+            }
+            return;
+        }
+        stats.node_count = nodes.size();
+        stats.node_bytes = nodes.capacity() * sizeof(linear_bvh_node) + motion.capacity() * sizeof(linear_bvh_motion);
+        stats.primitive_bytes = primitives.capacity() * sizeof(primitive_ref) + source.capacity() * sizeof(uint32_t)
+            + spheres.memory_bytes()
+            + triangles.triangle_bytes() + instances.capacity() * sizeof(instance)
+            + custom.capacity() * sizeof(shared_ptr<hittable>);
+        stats.leaf_count = 0;
+        stats.sah_cost = 0;
+        stats.motion_sah_cost = 0;
+        stats.depth = 0;
+        if (nodes.empty())
+            return;
+
+        double root_area = nodes[0].bounds.surface_area();
+        std::vector<int> node_depth(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const auto& node = nodes[i];
+            double relative_area = root_area > 0 ? node.bounds.surface_area() / root_area : 1.0;
+            // Averaged over the ray's time. The area of an interpolated box is quadratic in time,
+            // so Simpson's rule is exact.
+            double motion_area = 0;
+            if (!motion.empty()) {
+                const linear_bvh_motion& m = motion[i];
+                motion_area = (m.start.surface_area() + 4 * m.at(0.5).surface_area() + m.end.surface_area()) / 6;
+                motion_area = root_area > 0 ? motion_area / root_area : 1.0;
+            }
+            stats.depth = std::max(stats.depth, node_depth[i]);
+
+            double cost = node.is_leaf() ? options.intersection_cost * node.count : options.traversal_cost;
+            stats.sah_cost += relative_area * cost;
+            stats.motion_sah_cost += motion_area * cost;
+            if (node.is_leaf()) {
+                stats.leaf_count++;
+            }
+            else {
+                node_depth[i + 1] = node_depth[i] + 1;
+                node_depth[node.offset] = node_depth[i] + 1;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file.
+// The file is memory-mapped, so large scene files are paged in as the parser walks through them
+// instead of being copied into a buffer first. If mapping fails (empty files, exotic file
+// systems) the contents are read into memory instead; callers see the same bytes either way.
+
+class mapped_file {
+public:
+    mapped_file() = default;
+
+    explicit mapped_file(const std::string& path) { open(path); }
+
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        if (map(path))
+            return true;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = reinterpret_cast<const char*>(fallback.data());
+        length = fallback.size();
+        is_open = true;
+        return true;
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        view = nullptr;
+        mapping = nullptr;
+#else
+        if (view) munmap(view, length);
+        view = nullptr;
+#endif
+        fallback.clear();
+        bytes = nullptr;
+        length = 0;
+        is_open = false;
+    }
+
+    bool good() const { return is_open; }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool is_open = false;
+    void* view = nullptr;
+    std::vector<uint8_t> fallback;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#endif
+
+    bool map(const std::string& path) {
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);  // The mapping keeps the file open.
+        if (!mapping)
+            return false;
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+        length = static_cast<size_t>(file_size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // The mapping keeps the file open.
+        if (p == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        view = p;
+        // Parsers read front to back; let the kernel read ahead aggressively.
+        madvise(view, length, MADV_SEQUENTIAL);
+#endif
+        bytes = static_cast<const char*>(view);
+        is_open = true;
+        return true;
+    }
+};
+
+#endif
@@ -2,22 +2,57 @@
 #define MATERIAL_H
 
 #include "Utilities.h"
-
-class hit_record;
+#include "Hittable.h"
+#include "Render_stats.h"
+
+#include <cstdint>
+#include <vector>
+
+// Materials are plain values tagged with their type. scatter() switches on the tag instead of
+// calling through a vtable, and a scene keeps all of its materials in one material_table, so hit
+// records carry a 32-bit index rather than a reference-counted pointer.
+// lambertian, metal, dielectric and diffuse_light construct the matching material.
+
+enum class material_type : uint8_t {
+    lambertian,
+    metal,
+    dielectric,
+    diffuse_light   // Emits its color equally in every direction, from both sides; scatters nothing
+};
 
 class material {
 public:
-    virtual ~material() = default;
+    material() : material(material_type::lambertian, color(0.5, 0.5, 0.5), 0, 1) {}
+
+    material_type type() const { return tag; }
+    const color& get_albedo() const { return albedo; }
+    double get_fuzz() const { return fuzz; }
+    double get_refraction_index() const { return ir; }
+
+    // Radiance the surface emits; black for everything but diffuse_light.
+    color emitted() const { return tag == material_type::diffuse_light ? albedo : color(0, 0, 0); }
+
+    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+        ORACLE_STAT(render_counters::local().scatter[static_cast<int>(tag)]++);
+        switch (tag) {
+        case material_type::metal:      return scatter_metal(r_in, rec, attenuation, scattered);
+        case material_type::dielectric: return scatter_dielectric(r_in, rec, attenuation, scattered);
+        case material_type::diffuse_light: return false;
+        default:                        return scatter_lambertian(r_in, rec, attenuation, scattered);
+        }
+    }
 
-    virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
-};
+protected:
+    material(material_type type, const color& albedo, double fuzz, double ir)
+        : albedo(albedo), fuzz(fuzz), ir(ir), tag(type) {}
 
-class lambertian : public material {
-public:
-    lambertian(const color& a) : albedo(a) {}
+private:
+    color albedo;
+    double fuzz;
+    double ir;   // Index of refraction (dielectric)
+    material_type tag;
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
+    bool scatter_lambertian(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
         auto scatter_direction = rec.normal + random_unit_vector();
 
         if (scatter_direction.near_zero()) {
@@ -29,32 +64,14 @@ public:
         return true;
     }
 
-private:
-    color albedo;
-};
-
-class metal : public material {
-public:
-    metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
+    bool scatter_metal(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
         vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
         scattered = ray(rec.p, reflected, r_in.time());
         attenuation = albedo;
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
-private:
-    color albedo;
-    double fuzz;
-};
-
-class dielectric : public material {
-public:
-    dielectric(double index_of_refraction) :ir(index_of_refraction) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override {
+    bool scatter_dielectric(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
         vec3 unit_direction = unit_vector(r_in.direction());
         double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
         double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
@@ -74,9 +91,6 @@ public:
         return true;
     }
 
-private:
-    double ir;
-
     static double reflectance(double cosine, double refraction_index) {
         // Use Schlick's approximation for reflectance.
         auto r0 = (1 - refraction_index) / (1 + refraction_index);
@@ -85,4 +99,41 @@ private:
     }
 };
 
-#endif
\ No newline at end of file
+class lambertian : public material {
+public:
+    lambertian(const color& a) : material(material_type::lambertian, a, 0, 1) {}
+};
+
+class metal : public material {
+public:
+    metal(const color& a, double f) : material(material_type::metal, a, f < 1 ? f : 1, 1) {}
+};
+
+class dielectric : public material {
+public:
+    dielectric(double index_of_refraction) : material(material_type::dielectric, color(1, 1, 1), 0, index_of_refraction) {}
+};
+
+// The color is the emitted radiance; values above 1 make brighter lights.
+class diffuse_light : public material {
+public:
+    diffuse_light(const color& emission) : material(material_type::diffuse_light, emission, 0, 1) {}
+};
+
+// Every material of a scene, addressed by the index add() returns.
+class material_table {
+public:
+    uint32_t add(const material& m) {
+        materials.push_back(m);
+        return static_cast<uint32_t>(materials.size() - 1);
+    }
+
+    const material& operator[](uint32_t index) const { return materials[index]; }
+
+    size_t size() const { return materials.size(); }
+
+private:
+    std::vector<material> materials;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef OBJ_FILE_H
+#define OBJ_FILE_H
+
+#include "Mapped_file.h"
+#include "Scene_geometry.h"
+#include "Text_parsing.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Wavefront OBJ meshes.
+// load_obj appends the faces of an OBJ file to the triangle mesh of a scene_geometry. Polygons are
+// split into triangle fans. Faces may reference positions and normals in any of the forms
+// "f v", "f v/vt", "f v//vn" and "f v/vt/vn"; negative indices count back from the latest vertex.
+// A position becomes one mesh vertex however many faces share it, and is only duplicated for
+// each further normal it is used with. Texture coordinates, groups, smoothing groups and OBJ
+// materials are skipped: the whole file gets one scene material.
+//
+// The file is mapped and parsed in place. A first pass counts the statements so every array is
+// allocated once, and the triangles go straight into the scene's shared index buffer, so there is
+// no per-triangle object.
+
+struct obj_transform {
+    double scale = 1;
+    vec3 offset = vec3(0, 0, 0);
+};
+
+namespace obj_file_detail {
+
+using text_parsing::is_space;
+
+class obj_parser {
+public:
+    obj_parser(const std::string& path, const char* begin, const char* end, scene_geometry& geometry,
+        uint32_t material_id, const obj_transform& transform)
+        : path(path), begin(begin), end(end), geometry(geometry), mesh(geometry.triangles),
+          material_id(material_id), transform(transform) {}
+
+    bool parse() {
+        count();
+        for (const char* p = begin; p < end; line++) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!line_end)
+                line_end = end;
+            if (!statement(p, line_end))
+                return false;
+            p = line_end + 1;
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    const std::string& path;
+    const char* begin;
+    const char* end;
+    scene_geometry& geometry;
+    triangle_mesh& mesh;
+    uint32_t material_id;
+    obj_transform transform;
+    int line = 1;
+    bool file_has_normals = false;
+
+    std::vector<point3> positions;      // "v" statements, transformed
+    std::vector<vec3> normals;          // "vn" statements, normalized
+    std::vector<uint32_t> first_vertex; // Per position: its first mesh vertex, relative to `base`
+    std::vector<uint32_t> vertex_normal;   // Per mesh vertex: the normal it was made with
+    std::vector<uint32_t> next_vertex;     // Per mesh vertex: the next one with the same position
+    uint32_t base = 0;                  // Mesh vertices before this file
+    std::vector<uint32_t> face;
+
+    bool error(const std::string& message) const {
+        std::cerr << "Error: " << path << ":" << line << ": " << message << std::endl;
+        return false;
+    }
+
+    static bool starts_with(const char* p, const char* line_end, const char* keyword) {
+        size_t n = std::strlen(keyword);
+        return static_cast<size_t>(line_end - p) > n && std::memcmp(p, keyword, n) == 0
+            && (p[n] == ' ' || p[n] == '\t');
+    }
+
+    static const char* skip_blanks(const char* p, const char* line_end) {
+        while (p < line_end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+        return p;
+    }
+
+    static const char* token_end(const char* p, const char* line_end) {
+        while (p < line_end && !is_space(*p))
+            p++;
+        return p;
+    }
+
+    // Counts positions, normals and triangles so the arrays are allocated once.
+    void count() {
+        size_t position_count = 0, normal_count = 0, triangle_count = 0;
+        for (const char* p = begin; p < end;) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!line_end)
+                line_end = end;
+            p = skip_blanks(p, line_end);
+            if (starts_with(p, line_end, "v")) {
+                position_count++;
+            }
+            else if (starts_with(p, line_end, "vn")) {
+                normal_count++;
+            }
+            else if (starts_with(p, line_end, "f")) {
+                int corners = 0;
+                for (const char* q = p + 1; q < line_end;) {
+                    q = skip_blanks(q, line_end);
+                    if (q < line_end && *q != '#') corners++;
+                    else break;
+                    q = token_end(q, line_end);
+                }
+                if (corners > 2)
+                    triangle_count += corners - 2;
+            }
+            p = line_end + 1;
+        }
+
+        file_has_normals = normal_count > 0;
+        base = static_cast<uint32_t>(mesh.vertex_count());
+        positions.reserve(position_count);
+        normals.reserve(normal_count);
+        first_vertex.reserve(position_count);
+        // Most positions are used with a single normal; duplicates grow the vertex buffer later.
+        geometry.reserve_triangles(mesh.vertex_count() + position_count, triangle_count, file_has_normals);
+        vertex_normal.reserve(position_count);
+        next_vertex.reserve(position_count);
+    }
+
+    bool statement(const char* p, const char* line_end) {
+        p = skip_blanks(p, line_end);
+        if (starts_with(p, line_end, "v")) {
+            vec3 v;
+            if (!read_vec3(p + 1, line_end, v))
+                return false;
+            positions.push_back(transform.offset + transform.scale * v);
+            first_vertex.push_back(none);
+            return true;
+        }
+        if (starts_with(p, line_end, "vn")) {
+            vec3 n;
+            if (!read_vec3(p + 2, line_end, n))
+                return false;
+            normals.push_back(n.length_squared() > 0 ? unit_vector(n) : n);
+            return true;
+        }
+        if (starts_with(p, line_end, "f"))
+            return read_face(p + 1, line_end);
+        // vt, o, g, s, usemtl, mtllib, comments and anything else OBJ allows.
+        return true;
+    }
+
+    bool read_vec3(const char* p, const char* line_end, vec3& v) {
+        double xyz[3];
+        for (double& c : xyz) {
+            p = skip_blanks(p, line_end);
+            const char* q = token_end(p, line_end);
+            if (q == p)
+                return error("missing number");
+            if (!text_parsing::parse_double(p, q, c))
+                return error("'" + std::string(p, q) + "' is not a number");
+            p = q;
+        }
+        v = vec3(xyz[0], xyz[1], xyz[2]);
+        return true;
+    }
+
+    // Turns an OBJ index (1-based, or negative counting back from the latest element) into a
+    // 0-based one.
+    bool resolve(const char* p, const char* q, size_t count, const char* what, uint32_t& index) {
+        int64_t i;
+        if (!text_parsing::parse_int(p, q, i))
+            return error("'" + std::string(p, q) + "' is not a " + what + " index");
+        int64_t resolved = i > 0 ? i - 1 : static_cast<int64_t>(count) + i;
+        if (i == 0 || resolved < 0 || resolved >= static_cast<int64_t>(count))
+            return error(std::string(what) + " index " + std::to_string(i) + " is out of range");
+        index = static_cast<uint32_t>(resolved);
+        return true;
+    }
+
+    bool read_face(const char* p, const char* line_end) {
+        face.clear();
+        for (;;) {
+            p = skip_blanks(p, line_end);
+            if (p == line_end || *p == '#')
+                break;
+            const char* q = token_end(p, line_end);
+            const char* slash = static_cast<const char*>(std::memchr(p, '/', q - p));
+            uint32_t position, normal = none;
+            if (!resolve(p, slash ? slash : q, positions.size(), "position", position))
+                return false;
+            if (slash) {
+                const char* second = static_cast<const char*>(std::memchr(slash + 1, '/', q - slash - 1));
+                if (second && second + 1 < q && !resolve(second + 1, q, normals.size(), "normal", normal))
+                    return false;
+            }
+            face.push_back(vertex(position, normal));
+            p = q;
+        }
+        if (face.size() < 3)
+            return error("a face needs at least three vertices");
+        for (size_t k = 2; k < face.size(); k++)
+            geometry.add_triangle(face[0], face[k - 1], face[k], material_id);
+        return true;
+    }
+
+    // The mesh vertex for a (position, normal) pair, added on first use.
+    uint32_t vertex(uint32_t position, uint32_t normal) {
+        uint32_t* link = &first_vertex[position];
+        while (*link != none) {
+            if (vertex_normal[*link] == normal)
+                return base + *link;
+            link = &next_vertex[*link];
+        }
+        *link = static_cast<uint32_t>(vertex_normal.size());
+        vertex_normal.push_back(normal);
+        next_vertex.push_back(none);
+        if (file_has_normals)
+            return mesh.add_vertex(positions[position], normal == none ? vec3(0, 0, 0) : normals[normal]);
+        return mesh.add_vertex(positions[position]);
+    }
+};
+
+}  // namespace obj_file_detail
+
+// Appends the triangles of the OBJ file in `path` to `geometry`, all with `material_id`. Positions
+// are scaled, then offset.
+inline bool load_obj(const std::string& path, scene_geometry& geometry, uint32_t material_id,
+    const obj_transform& transform = obj_transform())
+{
+    mapped_file file(path);
+    if (!file.good()) {
+        std::cerr << "Error: Could not open OBJ file " << path << std::endl;
+        return false;
+    }
+    obj_file_detail::obj_parser parser(path, file.data(), file.data() + file.size(), geometry, material_id, transform);
+    return parser.parse();
+}
+
+#endif
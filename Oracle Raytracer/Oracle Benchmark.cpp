@@ -0,0 +1,385 @@
+#include "Benchmark.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "Color.h"
+#include "Demo_scenes.h"
+#include "Hittable.h"
+#include "Linear_BVH.h"
+#include "Material.h"
+#include "Scene_file.h"
+#include "Sphere.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmark suite for tracking performance over time.
+// Microbenchmarks time the hot functions in isolation and report ns/op; scenarios render whole
+// scenes and report rays traced per second (camera rays and every bounce). Progress goes to
+// stderr, results to stdout (or --json <file>) as JSON:
+//
+//     { "suite": "oracle-benchmark", "version": 1, "simd": "avx2", "precision": "double", "threads": 8, "results": [
+//         { "name": "sphere::hit", "type": "micro", "ops": 4000000, "ns_per_op": 7.1, ... },
+//         { "name": "humanoid", "type": "scenario", "rays": 5123456, "mrays_per_s": 12.3, ... } ] }
+//
+// Usage: Oracle Benchmark [--filter text] [--quick] [--threads n] [--repeats n] [--json file]
+//
+// "precision" is the scalar type the suite was built with (see Precision.h); configure a second
+// build with ORACLE_FLOAT to compare single and double precision.
+
+struct suite_options {
+    std::string filter;     // Only run benchmarks whose name contains this
+    bool quick = false;     // Smaller problem sizes, for smoke runs
+    int threads = 0;        // Render threads for the scenarios (0 = all hardware threads)
+    int repeats = 5;        // Timed runs per microbenchmark; the median is reported
+};
+
+struct suite_result {
+    std::string name;
+    std::string type;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+class benchmark_suite {
+public:
+    explicit benchmark_suite(const suite_options& options) : options(options) {}
+
+    bool selected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    // Times `run`, which performs `ops` operations per call, over several runs after one warm-up.
+    void micro(const std::string& name, double ops, const std::function<double()>& run) {
+        if (!selected(name))
+            return;
+        benchmark_sink = benchmark_sink + run();
+
+        std::vector<double> times;
+        for (int k = 0; k < std::max(1, options.repeats); k++) {
+            benchmark_timer timer;
+            benchmark_sink = benchmark_sink + run();
+            times.push_back(timer.seconds());
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+
+        double ns = median * 1e9 / ops;
+        std::clog << name << ": " << ns << " ns/op\n";
+        results.push_back({ name, "micro", {
+            { "ops", ops }, { "ns_per_op", ns }, { "ns_per_op_min", times.front() * 1e9 / ops },
+            { "mops_per_s", ops / median / 1e6 } } });
+    }
+
+    void scenario(const std::string& name, scene_description& scene);
+
+    void write_json(std::ostream& out) const {
+        std::streamsize saved_precision = out.precision(10);
+        out << "{\n  \"suite\": \"oracle-benchmark\",\n  \"version\": 1,\n";
+        out << "  \"simd\": \"" << simd_level_name(simd_support()) << "\",\n";
+        out << "  \"precision\": \"" << precision<real>::name << "\",\n";
+        out << "  \"threads\": " << thread_count() << ",\n";
+        out << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const suite_result& r = results[i];
+            out << (i ? ",\n" : "\n") << "    { \"name\": \"" << r.name << "\", \"type\": \"" << r.type << "\"";
+            for (const auto& v : r.values)
+                out << ", \"" << v.first << "\": " << v.second;
+            out << " }";
+        }
+        out << "\n  ]\n}\n";
+        out.precision(saved_precision);
+    }
+
+    const suite_options& settings() const { return options; }
+
+private:
+    suite_options options;
+    std::vector<suite_result> results;
+
+    int thread_count() const {
+        return options.threads > 0 ? options.threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+};
+
+// Forwards to the scene and counts every ray traced through it. Counts are spread over cache-line
+// sized slots picked by thread, so render threads rarely touch the same line.
+class ray_counter : public hittable {
+public:
+    explicit ray_counter(const hittable& world) : world(world) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        count(1);
+        return world.hit(r, ray_t, rec);
+    }
+
+    void hit_packet(ray_packet& packet, packet_hits& hits) const override {
+        uint64_t live = 0;
+        for (uint32_t mask = packet.active_mask(); mask != 0; mask &= mask - 1)
+            live++;
+        count(live);
+        world.hit_packet(packet, hits);
+    }
+
+    aabb bounding_box() const override { return world.bounding_box(); }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (const auto& s : slots)
+            sum += s.rays.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<uint64_t> rays{ 0 };
+    };
+
+    static constexpr size_t slot_count = 64;
+    const hittable& world;
+    mutable slot slots[slot_count];
+
+    void count(uint64_t n) const {
+        static thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+        slots[index].rays.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+void benchmark_suite::scenario(const std::string& name, scene_description& scene) {
+    if (!selected(name))
+        return;
+    camera& cam = scene.cam;
+    cam.thread_count = options.threads;
+    if (options.quick) {
+        cam.image_width = std::min(cam.image_width, 160);
+        cam.samples_per_pixel = std::min(cam.samples_per_pixel, 4);
+    }
+
+    benchmark_timer build_timer;
+    linear_bvh bvh(scene.geometry);
+    double build_seconds = build_timer.seconds();
+
+    ray_counter world(bvh);
+    std::streambuf* log = std::clog.rdbuf(nullptr);  // Silence the camera's progress output
+    benchmark_timer timer;
+    image img = cam.render_image(world, scene.materials);
+    double seconds = timer.seconds();
+    std::clog.rdbuf(log);
+
+    double rays = static_cast<double>(world.total());
+    double pixels = static_cast<double>(img.width()) * img.height();
+    std::clog << name << ": " << rays / seconds / 1e6 << " Mrays/s, build " << build_seconds * 1e3 << " ms\n";
+    results.push_back({ name, "scenario", {
+        { "primitives", static_cast<double>(scene.geometry.size()) }, { "width", static_cast<double>(img.width()) },
+        { "height", static_cast<double>(img.height()) }, { "samples_per_pixel", static_cast<double>(cam.samples_per_pixel) },
+        { "build_ms", build_seconds * 1e3 }, { "seconds", seconds }, { "rays", rays },
+        { "rays_per_sample", rays / (pixels * cam.samples_per_pixel) }, { "mrays_per_s", rays / seconds / 1e6 },
+        { "ns_per_ray", seconds * 1e9 / rays } } });
+}
+
+void run_micro(benchmark_suite& suite) {
+    const int count = suite.settings().quick ? 200000 : 2000000;
+
+    suite.micro("random_double", count, [&] {
+        double sum = 0;
+        for (int k = 0; k < count; k++)
+            sum += random_double();
+        return sum;
+    });
+
+    // Rays from a shell around the unit sphere, aimed at points near it: about half of them hit.
+    seed_random(11);
+    std::vector<ray> near_rays(4096);
+    for (auto& r : near_rays) {
+        point3 origin = 5 * random_unit_vector();
+        r = ray(origin, 1.5 * random_in_unit_sphere() - origin);
+    }
+    sphere unit(point3(0, 0, 0), 1, 0);
+    suite.micro("sphere::hit", count, [&] {
+        double sum = 0;
+        hit_record rec;
+        for (int k = 0; k < count; k++) {
+            if (unit.sphere::hit(near_rays[k & 4095], interval(0.001, infinity), rec))
+                sum += rec.t;
+        }
+        return sum;
+    });
+
+    // The same rays against a triangle across the sphere's equator, with the per-ray setup included.
+    triangle_mesh mesh;
+    mesh.add_triangle(mesh.add_vertex(point3(-1.5, -1, 0)), mesh.add_vertex(point3(1.5, -1, 0)),
+        mesh.add_vertex(point3(0, 1.5, 0)), 0);
+    suite.micro("triangle_mesh::hit", count, [&] {
+        double sum = 0;
+        hit_record rec;
+        for (int k = 0; k < count; k++) {
+            if (mesh.hit_one(0, near_rays[k & 4095], interval(0.001, infinity), rec))
+                sum += rec.t;
+        }
+        return sum;
+    });
+
+    aabb box(point3(-1, -1, -1), point3(1, 1, 1));
+    suite.micro("aabb::hit", count, [&] {
+        double sum = 0;
+        for (int k = 0; k < count; k++)
+            sum += box.hit(near_rays[k & 4095], interval(0.001, infinity));
+        return sum;
+    });
+
+    std::vector<vec3> inv_dirs;
+    for (const auto& r : near_rays)
+        inv_dirs.emplace_back(1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z());
+    suite.micro("aabb::hit (precomputed inverse)", count, [&] {
+        double sum = 0;
+        for (int k = 0; k < count; k++)
+            sum += box.hit(near_rays[k & 4095].origin(), inv_dirs[k & 4095], interval(0.001, infinity));
+        return sum;
+    });
+
+    // Whole-tree queries on 100k random spheres, pointer-based and flattened. The scene takes a
+    // while to generate, so it is skipped when neither tree is selected.
+    if (suite.selected("bvh_node::hit") || suite.selected("linear_bvh::hit")) {
+        const int tree_rays = count / 10;
+        auto scene = random_sphere_scene(100000);
+        auto rays = random_rays(tree_rays);
+        auto trace_all = [&](const hittable& tree) {
+            double sum = 0;
+            hit_record rec;
+            for (const auto& r : rays) {
+                if (tree.hit(r, interval(0.001, infinity), rec))
+                    sum += rec.t;
+            }
+            return sum;
+        };
+        if (suite.selected("bvh_node::hit")) {
+            bvh_node tree(scene);
+            suite.micro("bvh_node::hit", tree_rays, [&] { return trace_all(tree); });
+        }
+        if (suite.selected("linear_bvh::hit")) {
+            linear_bvh tree(scene);
+            suite.micro("linear_bvh::hit", tree_rays, [&] { return trace_all(tree); });
+        }
+    }
+
+    // Hit records spread over a unit sphere, hit from outside. Seeded here so they don't depend on
+    // whether the trees above were built.
+    seed_random(12);
+    material_table materials;
+    materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    materials.add(metal(color(0.8, 0.8, 0.8), 0.1));
+    materials.add(dielectric(1.5));
+    const char* type_names[] = { "lambertian", "metal", "dielectric" };
+    std::vector<hit_record> records(1024);
+    std::vector<ray> incoming(records.size());
+    for (size_t k = 0; k < records.size(); k++) {
+        vec3 n = random_unit_vector();
+        incoming[k] = ray(point3(0, 0, 0) - 2 * n + random_unit_vector() * 0.5, n);
+        records[k].p = n;
+        records[k].t = 1;
+        records[k].set_face_normal(incoming[k], n);
+    }
+    for (uint32_t m = 0; m < 3; m++) {
+        const material& mat = materials[m];
+        suite.micro(std::string("material::scatter (") + type_names[m] + ")", count, [&] {
+            double sum = 0;
+            color attenuation;
+            ray scattered;
+            for (int k = 0; k < count; k++) {
+                size_t i = static_cast<size_t>(k) & (records.size() - 1);
+                if (mat.scatter(incoming[i], records[i], attenuation, scattered))
+                    sum += scattered.direction().x();
+            }
+            return sum;
+        });
+    }
+
+    std::vector<color> pixels(4096);
+    for (auto& c : pixels)
+        c = color::random(0, 1);
+    suite.micro("write_color", count / 4, [&] {
+        std::ostringstream out;
+        for (int k = 0; k < count / 4; k++)
+            write_color(out, pixels[k & 4095]);
+        return static_cast<double>(out.tellp());
+    });
+}
+
+void run_scenarios(benchmark_suite& suite) {
+    {
+        scene_description scene;
+        humanoid_scene(scene);
+        scene.cam.image_width = 400;
+        scene.cam.samples_per_pixel = 16;
+        suite.scenario("humanoid", scene);
+    }
+    std::string random_name = suite.settings().quick ? "random spheres (100k)" : "random spheres (1M)";
+    if (suite.selected(random_name)) {
+        scene_description scene;
+        random_spheres_scene(scene, suite.settings().quick ? 100000 : 1000000);
+        suite.scenario(random_name, scene);
+    }
+    {
+        scene_description scene;
+        dielectric_scene(scene);
+        suite.scenario("dielectric spheres", scene);
+    }
+    std::string crowd_name = suite.settings().quick ? "crowd (1k instances)" : "crowd (10k instances)";
+    if (suite.selected(crowd_name)) {
+        scene_description scene;
+        crowd_scene(scene, suite.settings().quick ? 1000 : 10000);
+        suite.scenario(crowd_name, scene);
+    }
+    std::string moving_name = suite.settings().quick ? "fast-moving spheres (10k)" : "fast-moving spheres (100k)";
+    if (suite.selected(moving_name)) {
+        scene_description scene;
+        moving_spheres_scene(scene, suite.settings().quick ? 10000 : 100000, 20);
+        suite.scenario(moving_name, scene);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    suite_options options;
+    std::string json_file;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            options.filter = argv[++i];
+        else if (arg == "--quick")
+            options.quick = true;
+        else if (arg == "--threads" && i + 1 < argc)
+            options.threads = std::stoi(argv[++i]);
+        else if (arg == "--repeats" && i + 1 < argc)
+            options.repeats = std::stoi(argv[++i]);
+        else if (arg == "--json" && i + 1 < argc)
+            json_file = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--filter text] [--quick] [--threads n] [--repeats n] [--json file]\n";
+            return 1;
+        }
+    }
+
+    benchmark_suite suite(options);
+    run_micro(suite);
+    run_scenarios(suite);
+
+    if (json_file.empty()) {
+        suite.write_json(std::cout);
+        return 0;
+    }
+    std::ofstream out(json_file);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not create file " << json_file << std::endl;
+        return 1;
+    }
+    suite.write_json(out);
+    return 0;
+}
@@ -9,76 +9,326 @@
 #include "Material.h"
 #include "Camera.h"
 #include <fstream>
-#include "bvh.h"
+#include "BVH.h"
+#include "Linear_BVH.h"
+#include "Demo_scenes.h"
+#include "Scene_file.h"
+#include "Benchmark.h"
+#include "Render_server.h"
+#include "Distributed_render.h"
+#include "Denoiser.h"
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
 
 using std::make_shared;
 
-int main() {
-    hittable_list world;
-    world = hittable_list(make_shared<bvh_node>(world));
+// Raised by Ctrl+C / SIGTERM; a progressive render checkpoints and stops after the current pass.
+std::atomic<bool> stop_requested{ false };
 
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+void request_stop(int) {
+    stop_requested = true;
+}
 
-    // Scale factor to make the humanoid larger
-    double scale = 2.5;
+// `base` with a frame number before its extension: output.ppm -> output_0007.ppm.
+std::string frame_file(const std::string& base, int frame) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%04d", frame);
+    size_t dot = base.find_last_of('.');
+    size_t slash = base.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return base + number;
+    return base.substr(0, dot) + number + base.substr(dot);
+}
 
-    // Base center of the humanoid, raised to be more central in the view
-    point3 base_center(0, 1.5, 0);
-    auto humanoid_material = make_shared<metal>(color(0.8, 0.6, 0.4), 0.1);
+int render_animation(const std::string& output, int frames, int figures) {
+    scene_description scene;
+    walking_crowd crowd(scene, figures);
+    auto bvh = make_shared<linear_bvh>(scene.geometry);
+    hittable_list world(bvh);
+    image_writer writer;
+    scene.cam.writer = &writer;
+    std::clog << "Frame 0 BVH build: " << bvh->build_stats().build_ms << " ms\n";
 
-    // Head (scaled radius)
-    world.add(make_shared<sphere>(base_center + vec3(0, 0.6, 0) * scale, 0.25 * scale, humanoid_material));
+    double refit_total = 0, trace_total = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame > 0) {
+            crowd.pose(scene.geometry, frame / 24.0);
+            bvh_refit_stats refit = bvh->refit(scene.geometry);
+            refit_total += refit.refit_ms;
+            std::clog << "Frame " << frame << " refit: " << refit.refit_ms << " ms, SAH x" << refit.sah_ratio;
+            if (refit.full_rebuild)
+                std::clog << ", full rebuild";
+            else if (refit.rebuilt_subtrees > 0)
+                std::clog << ", rebuilt " << refit.rebuilt_subtrees << " subtrees (" << refit.rebuilt_primitives << " primitives)";
+            std::clog << "\n";
+        }
+        auto start = std::chrono::steady_clock::now();
+        scene.cam.render(world, scene.materials, frame_file(output, frame));
+        double trace_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        trace_total += trace_ms;
+        std::clog << "Frame " << frame << " trace: " << trace_ms << " ms\n";
+    }
+    std::clog << "Average per frame: refit " << (frames > 1 ? refit_total / (frames - 1) : 0.0) << " ms, trace "
+        << trace_total / frames << " ms\n";
+    return 0;
+}
 
-    // Torso (combined into one larger sphere for simplicity)
-    world.add(make_shared<sphere>(base_center, 0.4 * scale, humanoid_material));
+// `workers` is a comma-separated list of server addresses, or local:<count> to start that many
+// worker processes of this executable, sharing the hardware threads.
+int render_distributed(const std::string& scene_name, const camera& cam, const std::string& workers,
+                       const distributed_options& options, int threads, const std::string& executable,
+                       const std::string& output) {
+    std::unique_ptr<local_workers> local;
+    std::vector<std::string> addresses;
+    if (workers.compare(0, 6, "local:") == 0) {
+        int count = std::max(1, std::stoi(workers.substr(6)));
+        int hardware = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+        local = std::make_unique<local_workers>(executable, count, std::max(1, hardware / count));
+        addresses = local->worker_addresses();
+    }
+    else {
+        for (size_t start = 0; start <= workers.size();) {
+            size_t comma = std::min(workers.find(',', start), workers.size());
+            if (comma > start)
+                addresses.push_back(workers.substr(start, comma - start));
+            start = comma + 1;
+        }
+    }
+    if (addresses.empty()) {
+        std::cerr << "Error: No workers to render on" << std::endl;
+        return 1;
+    }
 
-    // --- MODIFICATIONS START ---
+    render_coordinator coordinator(scene_name, cam, options);
+    image result;
+    if (!coordinator.render(addresses, result))
+        return 1;
+    const distributed_stats& stats = coordinator.statistics();
+    std::clog << "Rendered " << stats.units << " units on " << addresses.size() << " workers in " << stats.seconds << " s ("
+        << stats.reassigned << " reassigned, " << stats.duplicates << " duplicated, " << stats.failed_workers << " workers failed)\n";
+    if (!write_image(result, output))
+        return 1;
+    std::clog << "Done. Image saved as " << output << "\n";
+    return 0;
+}
 
-    // --- Arms ---
-    // Using a three-sphere structure for more connected limbs.
-    // Base z-offset for arms to bring them forward toward the camera.
-    double arm_z_offset_base = 0.1;
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return run_benchmark(argv[2]);
 
-    // Left arm (Shoulder -> Bicep -> Forearm)
-    world.add(make_shared<sphere>(base_center + (vec3(-0.30, 0.20, arm_z_offset_base) * scale), 0.12 * scale, humanoid_material)); // Shoulder
-    world.add(make_shared<sphere>(base_center + (vec3(-0.32, 0.04, arm_z_offset_base) * scale), 0.11 * scale, humanoid_material)); // Bicep
-    world.add(make_shared<sphere>(base_center + (vec3(-0.35, -0.15, arm_z_offset_base) * scale), 0.10 * scale, humanoid_material)); // Forearm
+    // Usage: Oracle Raytracer [output file] [--scene file] [--crowd count] [--save-scene file] [--checkpoint file]
+    //                          [--adaptive] [--heatmap file] [--iterative] [--stats file] [--tile-heatmap file]
+    //                          [--animate frames] [--serve address [--cache-mb size]] [--client address job...]
+    //                          [--distribute addresses|local:count [--split tiles|samples]] [--threads count]
+    //                          [--denoise] [--aov prefix] [--lights count] [--no-light-sampling]
+    // --crowd renders `count` instanced humanoids instead of the built-in scene.
+    // --lights renders `count` small emissive spheres lighting a few large ones, with the sky blocked.
+    // Diffuse surfaces sample the scene's emissive spheres directly (see Lights.h);
+    // --no-light-sampling leaves finding them to BSDF sampling alone.
+    // --animate renders `frames` frames of a walking crowd (--crowd sets its size) at 24 frames per
+    // second, as the output name with the frame number appended. The BVH is built for the first
+    // frame and refitted for the others; each frame reports its refit and trace times.
+    // --serve runs a render server on a Unix socket path or a TCP port (see Render_server.h) that keeps
+    // up to --cache-mb megabytes of built scenes (default 1024). --client sends the rest of the
+    // command line to a server as one job, e.g. "render @humanoid image_width 400", and saves a
+    // rendered image as the output file.
+    // --distribute renders on worker servers (comma-separated addresses, or `count` local worker
+    // processes) and merges their results into the image a single process would have produced;
+    // --split samples hands out sample ranges as well as tiles (see Distributed_render.h).
+    // --threads sets the render threads (and those of a server); the default is every hardware thread.
+    // --denoise filters the image with the à-trous denoiser (see Denoiser.h), guided by first-hit
+    // albedo, normal and depth buffers; --aov writes those as prefix_albedo.pfm, prefix_normal.pfm
+    // and prefix_depth.pfm. Both need a one-pass render: no --checkpoint or --adaptive.
+    // --save-scene writes the scene (the built-in one unless --scene is given) and exits; a .oscn
+    // extension selects the binary format, so it also converts between the two forms.
+    // --stats writes a JSON summary of the render (phase times, per-tile times and, in builds with
+    // ORACLE_STATS, the hot-path counters); --tile-heatmap writes an image of the time per tile.
+    std::string output = "output.ppm";
+    std::string checkpoint;
+    std::string heatmap;
+    std::string scene_file;
+    std::string save_scene_file;
+    std::string stats_file;
+    std::string tile_heatmap;
+    std::string serve_address;
+    std::string client_address;
+    std::string client_job;
+    std::string aov_prefix;
+    int crowd = 0;
+    int light_count = 0;
+    int animate = 0;
+    int cache_mb = 1024;
+    int threads = 0;
+    std::string distribute;
+    distributed_options distribution;
+    bool adaptive = false;
+    bool iterative = false;
+    bool denoise = false;
+    bool sample_lights = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--checkpoint" && i + 1 < argc)
+            checkpoint = argv[++i];
+        else if (arg == "--scene" && i + 1 < argc)
+            scene_file = argv[++i];
+        else if (arg == "--crowd" && i + 1 < argc)
+            crowd = std::stoi(argv[++i]);
+        else if (arg == "--save-scene" && i + 1 < argc)
+            save_scene_file = argv[++i];
+        else if (arg == "--adaptive")
+            adaptive = true;
+        else if (arg == "--heatmap" && i + 1 < argc)
+            heatmap = argv[++i];
+        else if (arg == "--stats" && i + 1 < argc)
+            stats_file = argv[++i];
+        else if (arg == "--tile-heatmap" && i + 1 < argc)
+            tile_heatmap = argv[++i];
+        else if (arg == "--iterative")
+            iterative = true;
+        else if (arg == "--animate" && i + 1 < argc)
+            animate = std::stoi(argv[++i]);
+        else if (arg == "--serve" && i + 1 < argc)
+            serve_address = argv[++i];
+        else if (arg == "--cache-mb" && i + 1 < argc)
+            cache_mb = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::stoi(argv[++i]);
+        else if (arg == "--distribute" && i + 1 < argc)
+            distribute = argv[++i];
+        else if (arg == "--lights" && i + 1 < argc)
+            light_count = std::stoi(argv[++i]);
+        else if (arg == "--no-light-sampling")
+            sample_lights = false;
+        else if (arg == "--denoise")
+            denoise = true;
+        else if (arg == "--aov" && i + 1 < argc)
+            aov_prefix = argv[++i];
+        else if (arg == "--split" && i + 1 < argc)
+            distribution.split = std::string(argv[++i]) == "samples" ? distributed_split::samples : distributed_split::tiles;
+        else if (arg == "--client" && i + 1 < argc) {
+            client_address = argv[++i];
+            // Words with spaces (scene paths) go over quoted.
+            for (i++; i < argc; i++) {
+                std::ostringstream word;
+                if (std::string(argv[i]).find_first_of(" \t\"") != std::string::npos)
+                    word << std::quoted(argv[i]);
+                else
+                    word << argv[i];
+                client_job += (client_job.empty() ? "" : " ") + word.str();
+            }
+        }
+        else
+            output = arg;
+    }
 
-    // Right arm (Shoulder -> Bicep -> Forearm)
-    world.add(make_shared<sphere>(base_center + (vec3(0.30, 0.20, arm_z_offset_base) * scale), 0.12 * scale, humanoid_material));  // Shoulder
-    world.add(make_shared<sphere>(base_center + (vec3(0.32, 0.04, arm_z_offset_base) * scale), 0.11 * scale, humanoid_material));  // Bicep
-    world.add(make_shared<sphere>(base_center + (vec3(0.35, -0.15, arm_z_offset_base) * scale), 0.10 * scale, humanoid_material));  // Forearm
+    if (!serve_address.empty()) {
+        render_server server(static_cast<size_t>(std::max(cache_mb, 0)) << 20, threads);
+        return server.run(serve_address);
+    }
+    if (!client_address.empty())
+        return run_render_client(client_address, client_job, output);
 
-    // --- Legs ---
-    // Added a z-offset to bring legs forward
-    double leg_z_offset_base = 0.05;
+    if (animate > 0)
+        return render_animation(output, animate, crowd > 0 ? crowd : 64);
 
-    // Left leg
-    world.add(make_shared<sphere>(base_center + (vec3(-0.15, -0.5, leg_z_offset_base) * scale), 0.15 * scale, humanoid_material)); // Thigh
-    world.add(make_shared<sphere>(base_center + (vec3(-0.15, -0.9, leg_z_offset_base) * scale), 0.14 * scale, humanoid_material)); // Shin
+    scene_description scene;
+    if (!scene_file.empty()) {
+        if (!load_scene(scene_file, scene))
+            return 1;
+    }
+    else if (crowd > 0) {
+        crowd_scene(scene, crowd);
+    }
+    else if (light_count > 0) {
+        light_field_scene(scene, light_count);
+    }
+    else {
+        humanoid_scene(scene);
+    }
 
-    // Right leg
-    world.add(make_shared<sphere>(base_center + (vec3(0.15, -0.5, leg_z_offset_base) * scale), 0.15 * scale, humanoid_material));  // Thigh
-    world.add(make_shared<sphere>(base_center + (vec3(0.15, -0.9, leg_z_offset_base) * scale), 0.14 * scale, humanoid_material)); // Shin
-  /*  auto center2 = center + vec3(0, random_double(0, .5), 0);
-    world.add(make_shared<sphere>(center, center2, 0.2, sphere_material)); */// for move spheres
-    // --- MODIFICATIONS END ---
+    if (!save_scene_file.empty())
+        return save_scene(scene, save_scene_file) ? 0 : 1;
 
-    camera cam;
+    if (iterative)
+        scene.cam.integrator = integrator_type::iterative;
+    scene.cam.sample_lights = sample_lights;
+    if (!distribute.empty()) {
+        // Workers build the same scene from its name.
+        std::string scene_name = !scene_file.empty() ? scene_file
+            : crowd > 0 ? "@crowd:" + std::to_string(crowd)
+            : light_count > 0 ? "@lights:" + std::to_string(light_count) : "@humanoid";
+        return render_distributed(scene_name, scene.cam, distribute, distribution, threads, argv[0], output);
+    }
 
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width = 800; // Using the image width from your latest code
-    cam.samples_per_pixel = 100;
-    cam.max_depth = 50;
+    // Spheres go from the scene's SoA storage into the BVH without any per-object allocation.
+    auto bvh = make_shared<linear_bvh>(scene.geometry);
+    hittable_list world(bvh);
+    const material_table& materials = scene.materials;
+    light_list lights(scene.geometry, materials);
+    camera& cam = scene.cam;
+    cam.lights = &lights;
 
-    cam.vfov = 60; // Widened field of view to see the whole humanoid
-    cam.lookfrom = point3(0, 1.5, 4); // Moved camera closer and centered
-    cam.lookat = base_center; // Look directly at the humanoid's torso
-    cam.vup = vec3(0, 1, 0);
+    // The writer thread encodes and saves the image while main() tears the scene down.
+    image_writer writer;
+    cam.writer = &writer;
 
-    cam.defocus_angle = 0.1;
-    cam.focus_dist = (cam.lookfrom - cam.lookat).length(); // Set focus distance to the humanoid
+    // Adaptive sampling treats samples_per_pixel as a ceiling and stops on converged pixels.
+    cam.adaptive = adaptive;
+    cam.heatmap_file = heatmap;
+    cam.thread_count = threads;
 
-    cam.render(world);
+    render_stats stats;
+    stats.build_seconds = bvh->build_stats().build_ms / 1e3;
+    if (!stats_file.empty() || !tile_heatmap.empty())
+        cam.stats = &stats;
+
+    if (denoise || !aov_prefix.empty()) {
+        if (!checkpoint.empty() || adaptive) {
+            std::cerr << "Error: --denoise and --aov need a one-pass render (no --checkpoint or --adaptive)" << std::endl;
+            return 1;
+        }
+        aov_buffers aovs;
+        cam.aovs = &aovs;
+        image result = cam.render_image(world, materials);
+        if (!aov_prefix.empty()) {
+            writer.submit(aovs.albedo, aov_prefix + "_albedo.pfm");
+            writer.submit(aovs.normal, aov_prefix + "_normal.pfm");
+            writer.submit(aovs.depth_image(), aov_prefix + "_depth.pfm");
+        }
+        if (denoise) {
+            auto start = std::chrono::steady_clock::now();
+            denoiser filter;
+            filter.thread_count = threads;
+            result = filter.denoise(result, aovs);
+            std::clog << "Denoised in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                << " ms (" << simd_level_name(filter.kernel()) << ")\n";
+        }
+        writer.submit(std::move(result), output);
+        std::clog << "Done. Queued " << output << " for writing\n";
+    }
+    else if (checkpoint.empty()) {
+        cam.render(world, materials, output);
+    }
+    else {
+        // Progressive render that survives being interrupted: rerunning with the same checkpoint
+        // continues where the last run stopped.
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+        cam.stop_request = &stop_requested;
+        cam.render_progressive(world, materials, output, checkpoint);
+    }
+
+    if (cam.stats) {
+        writer.wait();
+        stats.output_seconds += writer.write_seconds();
+        if (!stats_file.empty() && stats.write_json(stats_file))
+            std::clog << "Render statistics saved as " << stats_file << "\n";
+        if (!tile_heatmap.empty())
+            writer.submit(stats.tile_heatmap(), tile_heatmap);
+    }
 }
\ No newline at end of file
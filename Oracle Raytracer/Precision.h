@@ -0,0 +1,35 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+// Scalar type of the geometry pipeline.
+// vec3, ray, interval and aabb are templates over their scalar type; the aliases the rest of the
+// renderer uses (vec3, point3, color, ray, interval, aabb) and the sphere store are built on
+// `real`. It is double by default; defining ORACLE_FLOAT builds everything in single precision,
+// which halves the memory traffic of scenes and acceleration structures.
+
+#if defined(ORACLE_FLOAT)
+using real = float;
+#else
+using real = double;
+#endif
+
+// Tolerances that depend on the precision of the arithmetic.
+template <typename T>
+struct precision;
+
+template <>
+struct precision<double> {
+    static constexpr const char* name = "double";
+    static constexpr double ray_t_min = 0.000001;  // Nearest hit a scattered ray accepts, so it does not hit its own origin
+    static constexpr double near_zero = 1e-8;      // vec3::near_zero() per-component threshold
+};
+
+template <>
+struct precision<float> {
+    static constexpr const char* name = "float";
+    // Hit points carry an error of a few ulps of the scene coordinates (~1e-5 at 100 units).
+    static constexpr float ray_t_min = 0.001f;
+    static constexpr float near_zero = 1e-5f;
+};
+
+#endif
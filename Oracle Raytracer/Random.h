@@ -0,0 +1,140 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <cstdlib>
+
+// Random number engines.
+// Every engine exposes the same small interface -- seed(key), next_u32() and next_double() -- so
+// the one used by random_double() can be swapped at compile time:
+//
+//   ORACLE_RNG_XOSHIRO  xoshiro256+
+//   ORACLE_RNG_LEGACY   the C library rand() (global state, not reproducible across threads)
+//   (default)           PCG32
+//
+// Each thread owns its own engine, and the camera reseeds it from (pixel, sample, frame) before
+// tracing a sample, so a render is bit-identical no matter how many threads produced it.
+
+inline uint64_t splitmix64(uint64_t x) {
+    // Finalizer from SplitMix64: a cheap, well-mixed 64-bit hash.
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t sample_key(uint64_t pixel, uint64_t sample, uint64_t frame) {
+    // Folds the three sample coordinates into one well-distributed seed.
+    return splitmix64(pixel ^ splitmix64(sample ^ splitmix64(frame)));
+}
+
+class pcg32 {
+public:
+    pcg32() { seed(0); }
+
+    void seed(uint64_t key) {
+        // Derive both the start state and the stream selector from the key, so neighbouring
+        // keys land on unrelated streams.
+        state = 0;
+        inc = (splitmix64(key ^ 0xda3e39cb94b95bdbull) << 1) | 1u;
+        next_u32();
+        state += splitmix64(key);
+        next_u32();
+    }
+
+    uint32_t next_u32() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+    }
+
+    double next_double() {
+        // 32 random bits scaled into [0,1).
+        return next_u32() * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+class xoshiro256plus {
+public:
+    xoshiro256plus() { seed(0); }
+
+    void seed(uint64_t key) {
+        // The reference implementation recommends filling the state from SplitMix64.
+        for (auto& word : s) {
+            key = splitmix64(key);
+            word = key;
+        }
+    }
+
+    uint64_t next_u64() {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    uint32_t next_u32() { return static_cast<uint32_t>(next_u64() >> 32); }
+
+    double next_double() {
+        // The upper 53 bits are the strong ones for the '+' scrambler.
+        return (next_u64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+class legacy_rand {
+public:
+    // Kept only for comparison: shares the C library's hidden global state between threads.
+    void seed(uint64_t key) { srand(static_cast<unsigned int>(key)); }
+
+    uint32_t next_u32() {
+        return static_cast<uint32_t>(next_double() * 4294967296.0);
+    }
+
+    double next_double() {
+        return rand() / (RAND_MAX + 1.0);
+    }
+};
+
+#if defined(ORACLE_RNG_XOSHIRO)
+using rng_engine = xoshiro256plus;
+#elif defined(ORACLE_RNG_LEGACY)
+using rng_engine = legacy_rand;
+#else
+using rng_engine = pcg32;
+#endif
+
+inline rng_engine& thread_rng() {
+    thread_local rng_engine engine;
+    return engine;
+}
+
+inline void seed_random(uint64_t key) {
+    thread_rng().seed(key);
+}
+
+inline void seed_sample(uint64_t pixel, uint64_t sample, uint64_t frame) {
+    // Positions the calling thread's stream at the start of one camera sample.
+    thread_rng().seed(sample_key(pixel, sample, frame));
+}
+
+#endif
@@ -3,29 +3,32 @@
 
 #include "Vector.h"
 
-class ray {
+template <typename T>
+class ray_t {
 public:
-    ray() {}
+    ray_t() {}
 
-    ray(const point3& origin, const vec3& direction, double time)
+    ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction, T time)
         : orig(origin), dir(direction), tm(time) {}
 
-    ray(const point3& origin, const vec3& direction)
-        : ray(origin, direction, 0) {}
+    ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction)
+        : ray_t(origin, direction, 0) {}
 
-    const point3& origin() const { return orig; }
-    const vec3& direction() const { return dir; }
+    const vec3_t<T>& origin() const { return orig; }
+    const vec3_t<T>& direction() const { return dir; }
 
-    double time() const { return tm; }
+    T time() const { return tm; }
 
-    point3 at(double t) const {
+    vec3_t<T> at(T t) const {
         return orig + t * dir;
     }
 
 private:
-    point3 orig;
-    vec3 dir;
-    double tm;
+    vec3_t<T> orig;
+    vec3_t<T> dir;
+    T tm;
 };
 
+using ray = ray_t<real>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "Ray.h"
+#include "Interval.h"
+#include "AABB.h"
+#include "Simd.h"
+
+#include <cstdint>
+
+// A group of rays traced together: sixteen in single precision, eight in double, so a full
+// packet is one AVX-512 register per component either way. Besides the rays themselves, the packet keeps origins, reciprocal directions and the current
+// [t_min, t_max] of every ray in aligned structure-of-arrays form, so one box can be slab-tested
+// against all of them with a single vector kernel. t_max shrinks as closer hits are found.
+// Unused lanes have an empty interval and never hit anything.
+
+class ray_packet {
+public:
+#ifdef ORACLE_FLOAT
+    static constexpr int max_size = 16;
+#else
+    static constexpr int max_size = 8;
+#endif
+
+    ray rays[max_size];
+    alignas(64) real ox[max_size], oy[max_size], oz[max_size];
+    alignas(64) real inv_x[max_size], inv_y[max_size], inv_z[max_size];
+    alignas(64) real t_min[max_size], t_max[max_size];
+    int count = 0;
+
+    ray_packet() {
+        for (int i = 0; i < max_size; i++) {
+            ox[i] = oy[i] = oz[i] = 0;
+            inv_x[i] = inv_y[i] = inv_z[i] = 1;
+            t_min[i] = +infinity;
+            t_max[i] = -infinity;
+        }
+    }
+
+    void add(const ray& r, interval ray_t) {
+        int i = count++;
+        rays[i] = r;
+        ox[i] = r.origin().x();
+        oy[i] = r.origin().y();
+        oz[i] = r.origin().z();
+        inv_x[i] = real(1) / r.direction().x();
+        inv_y[i] = real(1) / r.direction().y();
+        inv_z[i] = real(1) / r.direction().z();
+        t_min[i] = ray_t.min;
+        t_max[i] = ray_t.max;
+    }
+
+    // Lanes still able to hit something.
+    uint32_t active_mask() const {
+        uint32_t mask = 0;
+        for (int i = 0; i < count; i++) {
+            if (t_min[i] < t_max[i])
+                mask |= 1u << i;
+        }
+        return mask;
+    }
+};
+
+// Slab-tests `box` against every lane of the packet and returns the mask of lanes that hit it.
+inline uint32_t packet_box_mask_scalar(const aabb& box, const ray_packet& p) {
+    uint32_t mask = 0;
+    for (int i = 0; i < ray_packet::max_size; i++) {
+        real t0x = (box.x.min - p.ox[i]) * p.inv_x[i], t1x = (box.x.max - p.ox[i]) * p.inv_x[i];
+        real t0y = (box.y.min - p.oy[i]) * p.inv_y[i], t1y = (box.y.max - p.oy[i]) * p.inv_y[i];
+        real t0z = (box.z.min - p.oz[i]) * p.inv_z[i], t1z = (box.z.max - p.oz[i]) * p.inv_z[i];
+        real t_near = std::fmax(std::fmax(std::fmin(t0x, t1x), std::fmin(t0y, t1y)), std::fmax(std::fmin(t0z, t1z), p.t_min[i]));
+        real t_far = std::fmin(std::fmin(std::fmax(t0x, t1x), std::fmax(t0y, t1y)), std::fmin(std::fmax(t0z, t1z), p.t_max[i]));
+        if (t_near < t_far)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+#if defined(ORACLE_SIMD_X86) && !defined(ORACLE_FLOAT)
+ORACLE_TARGET_AVX2
+inline uint32_t packet_box_mask_avx2(const aabb& box, const ray_packet& p) {
+    uint32_t mask = 0;
+    const __m256d min_x = _mm256_set1_pd(box.x.min), max_x = _mm256_set1_pd(box.x.max);
+    const __m256d min_y = _mm256_set1_pd(box.y.min), max_y = _mm256_set1_pd(box.y.max);
+    const __m256d min_z = _mm256_set1_pd(box.z.min), max_z = _mm256_set1_pd(box.z.max);
+
+    for (int half = 0; half < ray_packet::max_size; half += 4) {
+        __m256d ox = _mm256_load_pd(p.ox + half), ix = _mm256_load_pd(p.inv_x + half);
+        __m256d oy = _mm256_load_pd(p.oy + half), iy = _mm256_load_pd(p.inv_y + half);
+        __m256d oz = _mm256_load_pd(p.oz + half), iz = _mm256_load_pd(p.inv_z + half);
+
+        __m256d t0x = _mm256_mul_pd(_mm256_sub_pd(min_x, ox), ix), t1x = _mm256_mul_pd(_mm256_sub_pd(max_x, ox), ix);
+        __m256d t0y = _mm256_mul_pd(_mm256_sub_pd(min_y, oy), iy), t1y = _mm256_mul_pd(_mm256_sub_pd(max_y, oy), iy);
+        __m256d t0z = _mm256_mul_pd(_mm256_sub_pd(min_z, oz), iz), t1z = _mm256_mul_pd(_mm256_sub_pd(max_z, oz), iz);
+
+        __m256d t_near = _mm256_max_pd(
+            _mm256_max_pd(_mm256_min_pd(t0x, t1x), _mm256_min_pd(t0y, t1y)),
+            _mm256_max_pd(_mm256_min_pd(t0z, t1z), _mm256_load_pd(p.t_min + half)));
+        __m256d t_far = _mm256_min_pd(
+            _mm256_min_pd(_mm256_max_pd(t0x, t1x), _mm256_max_pd(t0y, t1y)),
+            _mm256_min_pd(_mm256_max_pd(t0z, t1z), _mm256_load_pd(p.t_max + half)));
+
+        mask |= static_cast<uint32_t>(_mm256_movemask_pd(_mm256_cmp_pd(t_near, t_far, _CMP_LT_OQ))) << half;
+    }
+    return mask;
+}
+
+ORACLE_AVX512_WARNINGS_BEGIN
+ORACLE_TARGET_AVX512
+inline uint32_t packet_box_mask_avx512(const aabb& box, const ray_packet& p) {
+    __m512d ox = _mm512_load_pd(p.ox), ix = _mm512_load_pd(p.inv_x);
+    __m512d oy = _mm512_load_pd(p.oy), iy = _mm512_load_pd(p.inv_y);
+    __m512d oz = _mm512_load_pd(p.oz), iz = _mm512_load_pd(p.inv_z);
+
+    __m512d t0x = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.x.min), ox), ix);
+    __m512d t1x = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.x.max), ox), ix);
+    __m512d t0y = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.y.min), oy), iy);
+    __m512d t1y = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.y.max), oy), iy);
+    __m512d t0z = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.z.min), oz), iz);
+    __m512d t1z = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(box.z.max), oz), iz);
+
+    __m512d t_near = _mm512_max_pd(
+        _mm512_max_pd(_mm512_min_pd(t0x, t1x), _mm512_min_pd(t0y, t1y)),
+        _mm512_max_pd(_mm512_min_pd(t0z, t1z), _mm512_load_pd(p.t_min)));
+    __m512d t_far = _mm512_min_pd(
+        _mm512_min_pd(_mm512_max_pd(t0x, t1x), _mm512_max_pd(t0y, t1y)),
+        _mm512_min_pd(_mm512_max_pd(t0z, t1z), _mm512_load_pd(p.t_max)));
+
+    return static_cast<uint32_t>(_mm512_cmp_pd_mask(t_near, t_far, _CMP_LT_OQ));
+}
+ORACLE_AVX512_WARNINGS_END
+#elif defined(ORACLE_SIMD_X86)
+// Single precision: eight lanes per AVX2 register, all sixteen in one AVX-512 register.
+ORACLE_TARGET_AVX2
+inline uint32_t packet_box_mask_avx2(const aabb& box, const ray_packet& p) {
+    uint32_t mask = 0;
+    const __m256 min_x = _mm256_set1_ps(box.x.min), max_x = _mm256_set1_ps(box.x.max);
+    const __m256 min_y = _mm256_set1_ps(box.y.min), max_y = _mm256_set1_ps(box.y.max);
+    const __m256 min_z = _mm256_set1_ps(box.z.min), max_z = _mm256_set1_ps(box.z.max);
+
+    for (int half = 0; half < ray_packet::max_size; half += 8) {
+        __m256 ox = _mm256_load_ps(p.ox + half), ix = _mm256_load_ps(p.inv_x + half);
+        __m256 oy = _mm256_load_ps(p.oy + half), iy = _mm256_load_ps(p.inv_y + half);
+        __m256 oz = _mm256_load_ps(p.oz + half), iz = _mm256_load_ps(p.inv_z + half);
+
+        __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(min_x, ox), ix), t1x = _mm256_mul_ps(_mm256_sub_ps(max_x, ox), ix);
+        __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(min_y, oy), iy), t1y = _mm256_mul_ps(_mm256_sub_ps(max_y, oy), iy);
+        __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(min_z, oz), iz), t1z = _mm256_mul_ps(_mm256_sub_ps(max_z, oz), iz);
+
+        __m256 t_near = _mm256_max_ps(
+            _mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)),
+            _mm256_max_ps(_mm256_min_ps(t0z, t1z), _mm256_load_ps(p.t_min + half)));
+        __m256 t_far = _mm256_min_ps(
+            _mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)),
+            _mm256_min_ps(_mm256_max_ps(t0z, t1z), _mm256_load_ps(p.t_max + half)));
+
+        mask |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(t_near, t_far, _CMP_LT_OQ))) << half;
+    }
+    return mask;
+}
+
+ORACLE_AVX512_WARNINGS_BEGIN
+ORACLE_TARGET_AVX512
+inline uint32_t packet_box_mask_avx512(const aabb& box, const ray_packet& p) {
+    __m512 ox = _mm512_load_ps(p.ox), ix = _mm512_load_ps(p.inv_x);
+    __m512 oy = _mm512_load_ps(p.oy), iy = _mm512_load_ps(p.inv_y);
+    __m512 oz = _mm512_load_ps(p.oz), iz = _mm512_load_ps(p.inv_z);
+
+    __m512 t0x = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.x.min), ox), ix);
+    __m512 t1x = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.x.max), ox), ix);
+    __m512 t0y = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.y.min), oy), iy);
+    __m512 t1y = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.y.max), oy), iy);
+    __m512 t0z = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.z.min), oz), iz);
+    __m512 t1z = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.z.max), oz), iz);
+
+    __m512 t_near = _mm512_max_ps(
+        _mm512_max_ps(_mm512_min_ps(t0x, t1x), _mm512_min_ps(t0y, t1y)),
+        _mm512_max_ps(_mm512_min_ps(t0z, t1z), _mm512_load_ps(p.t_min)));
+    __m512 t_far = _mm512_min_ps(
+        _mm512_min_ps(_mm512_max_ps(t0x, t1x), _mm512_max_ps(t0y, t1y)),
+        _mm512_min_ps(_mm512_max_ps(t0z, t1z), _mm512_load_ps(p.t_max)));
+
+    return static_cast<uint32_t>(_mm512_cmp_ps_mask(t_near, t_far, _CMP_LT_OQ));
+}
+ORACLE_AVX512_WARNINGS_END
+#endif
+
+inline uint32_t packet_box_mask(const aabb& box, const ray_packet& p, simd_level level) {
+    switch (level) {
+#if defined(ORACLE_SIMD_X86)
+    case simd_level::avx512: return packet_box_mask_avx512(box, p);
+    case simd_level::avx2:   return packet_box_mask_avx2(box, p);
+#endif
+    default:                 return packet_box_mask_scalar(box, p);
+    }
+}
+
+#endif
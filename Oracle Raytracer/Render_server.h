@@ -0,0 +1,706 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "Camera.h"
+#include "Demo_scenes.h"
+#include "Hittable_list.h"
+#include "Image.h"
+#include "Lights.h"
+#include "Linear_BVH.h"
+#include "Scene_file.h"
+#include "Socket.h"
+#include "Text_parsing.h"
+#include "Thread_pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Render server.
+// A long-lived process that keeps scenes loaded, with their BVHs built, between jobs, and renders
+// every job on one thread pool, so a job against a cached scene only pays for tracing. Clients
+// connect over a Unix domain socket or TCP (see Socket.h) and send one job per line:
+//
+//     render <scene> [setting value...]   # Render; the reply is streamed (below)
+//     region <scene> ...                  # Sample sums of a block of pixels (see render_region)
+//     status                              # One line of scene cache figures
+//     shutdown                            # Stop the server once this connection closes
+//
+// <scene> is a scene file path as seen by the server (in double quotes if it has spaces), or a
+// built-in scene: @humanoid, @crowd:<figures>, @spheres:<count> or @lights:<count>. The settings
+// override the scene's camera: the camera settings of scene files (image_width, samples_per_pixel,
+// max_depth, vfov, lookfrom x y z, lookat, vup, aspect_ratio, defocus_angle, focus_dist) plus
+// tile_size, frame, integrator recursive|iterative, sample_lights on|off, format ppm|pfm|qoi and
+// tiles on|off. A render job is answered with
+//
+//     ok <width> <height> <hit|miss> <scene ms>   # scene ms: load and BVH build, 0 on a hit
+//     tile <x0> <y0> <x1> <y1>                    # Per finished tile, unless "tiles off": followed by
+//                                                 # (x1-x0)*(y1-y0)*3 little-endian float32 linear RGB
+//     image <format> <bytes>                      # Followed by the encoded image
+//     done <trace ms>
+//
+// or by "error <message>". Connections are served one at a time and the jobs of a connection in
+// order; each job already spreads its tiles over every render thread.
+//
+// The cache holds up to a byte budget of scenes (geometry, BVH nodes and mirrors, bottom-level BVHs
+// of instanced objects) and evicts the least recently used ones beyond it. A scene file that
+// changed on disk since it was cached is loaded again.
+
+struct cached_scene {
+    std::string name;
+    scene_description scene;
+    shared_ptr<linear_bvh> bvh;
+    hittable_list world;
+    light_list lights;
+    size_t bytes = 0;
+    double load_ms = 0;   // Loading and BVH build
+    std::filesystem::file_time_type modified{};
+};
+
+// Heap bytes a cached scene holds on to.
+inline size_t cached_scene_bytes(const cached_scene& entry) {
+    const scene_geometry& geometry = entry.scene.geometry;
+    const bvh_build_stats& st = entry.bvh->build_stats();
+    size_t bytes = geometry.spheres.memory_bytes() + geometry.triangles.triangle_bytes() + geometry.triangles.vertex_bytes()
+        + geometry.instances.capacity() * sizeof(instance) + geometry.primitives().capacity() * sizeof(primitive_ref)
+        + st.node_bytes + st.primitive_bytes;
+    // Instanced objects are shared, so each one is counted once.
+    std::unordered_set<const hittable*> objects;
+    for (const auto& object : geometry.instances) {
+        const hittable* shared = object.get_object().get();
+        if (!objects.insert(shared).second)
+            continue;
+        if (auto bottom = dynamic_cast<const linear_bvh*>(shared))
+            bytes += bottom->build_stats().node_bytes + bottom->build_stats().primitive_bytes;
+    }
+    return bytes;
+}
+
+namespace render_server_detail {
+
+// "@crowd:500" -> 500; false without a valid positive count.
+inline bool builtin_count(const std::string& name, const std::string& prefix, int& count) {
+    if (name.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    int64_t n;
+    const char* p = name.c_str() + prefix.size();
+    if (!text_parsing::parse_int(p, name.c_str() + name.size(), n) || n <= 0 || n > 100000000)
+        return false;
+    count = static_cast<int>(n);
+    return true;
+}
+
+}  // namespace render_server_detail
+
+// Fills an empty `scene` with the scene a job names: a scene file or a built-in scene (see above).
+inline bool load_named_scene(const std::string& name, scene_description& scene) {
+    using render_server_detail::builtin_count;
+    int count = 0;
+    if (name == "@humanoid")
+        humanoid_scene(scene);
+    else if (builtin_count(name, "@crowd:", count))
+        crowd_scene(scene, count);
+    else if (builtin_count(name, "@spheres:", count))
+        random_spheres_scene(scene, count);
+    else if (builtin_count(name, "@lights:", count))
+        light_field_scene(scene, count);
+    else if (!name.empty() && name[0] == '@') {
+        std::cerr << "Error: Unknown built-in scene " << name << std::endl;
+        return false;
+    }
+    else
+        return load_scene(name, scene);
+    return true;
+}
+
+class scene_cache {
+public:
+    explicit scene_cache(size_t budget_bytes) : budget(budget_bytes) {}
+
+    // The scene called `name`, loaded and built on a miss. Entries stay valid for as long as the
+    // caller holds them, evicted or not. Returns null (and prints why) if the scene can't be loaded.
+    shared_ptr<const cached_scene> get(const std::string& name, bool& hit) {
+        auto found = index.find(name);
+        if (found != index.end() && !stale(**found->second)) {
+            hit = true;
+            hits++;
+            entries.splice(entries.begin(), entries, found->second);
+            return *found->second;
+        }
+        if (found != index.end())
+            remove(found->second);
+
+        hit = false;
+        misses++;
+        auto entry = load(name);
+        if (!entry)
+            return nullptr;
+        entries.push_front(entry);
+        index[name] = entries.begin();
+        total_bytes += entry->bytes;
+        // The new scene stays even if it alone is over the budget.
+        while (total_bytes > budget && entries.size() > 1) {
+            std::clog << "Evicting scene " << entries.back()->name << " (" << entries.back()->bytes / 1e6 << " MB)\n";
+            remove(std::prev(entries.end()));
+            evictions++;
+        }
+        return entry;
+    }
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return total_bytes; }
+    size_t budget_bytes() const { return budget; }
+    uint64_t hit_count() const { return hits; }
+    uint64_t miss_count() const { return misses; }
+    uint64_t eviction_count() const { return evictions; }
+
+private:
+    using entry_list = std::list<shared_ptr<cached_scene>>;  // Most recently used first
+
+    size_t budget;
+    size_t total_bytes = 0;
+    entry_list entries;
+    std::unordered_map<std::string, entry_list::iterator> index;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+
+    static bool is_builtin(const std::string& name) { return !name.empty() && name[0] == '@'; }
+
+    static bool stale(const cached_scene& entry) {
+        if (is_builtin(entry.name))
+            return false;
+        std::error_code error;
+        auto modified = std::filesystem::last_write_time(entry.name, error);
+        return error || modified != entry.modified;
+    }
+
+    void remove(entry_list::iterator it) {
+        total_bytes -= (*it)->bytes;
+        index.erase((*it)->name);
+        entries.erase(it);
+    }
+
+    static shared_ptr<cached_scene> load(const std::string& name) {
+        auto start = std::chrono::steady_clock::now();
+        auto entry = std::make_shared<cached_scene>();
+        entry->name = name;
+        if (!is_builtin(name)) {
+            std::error_code error;
+            entry->modified = std::filesystem::last_write_time(name, error);
+            if (error) {
+                std::cerr << "Error: Could not open scene file " << name << std::endl;
+                return nullptr;
+            }
+        }
+        if (!load_named_scene(name, entry->scene))
+            return nullptr;
+        entry->bvh = std::make_shared<linear_bvh>(entry->scene.geometry);
+        entry->world = hittable_list(entry->bvh);
+        entry->lights = light_list(entry->scene.geometry, entry->scene.materials);
+        entry->bytes = cached_scene_bytes(*entry);
+        entry->load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::clog << "Cached scene " << name << ": " << entry->scene.geometry.size() << " primitives, "
+            << entry->bytes / 1e6 << " MB, " << entry->load_ms << " ms\n";
+        return entry;
+    }
+};
+
+namespace render_server_detail {
+
+// An image width or height from a reply: 1 to 16384, as the server allows.
+inline bool parse_size(const std::string& word, int64_t& value) {
+    return text_parsing::parse_int(word.data(), word.data() + word.size(), value) && value >= 1 && value <= 16384;
+}
+
+inline std::vector<std::string> split_words(const std::string& line) {
+    std::vector<std::string> words;
+    std::istringstream in(line);
+    std::string word;
+    while (in >> std::quoted(word))
+        words.push_back(word);
+    return words;
+}
+
+// The settings of a render job, applied on top of the cached scene's camera.
+struct job_settings {
+    image_format format = image_format::ppm;
+    std::string format_name = "ppm";
+    bool stream_tiles = true;
+};
+
+class job_parser {
+public:
+    job_parser(const std::vector<std::string>& words, size_t first) : words(words), at(first) {}
+
+    // Applies every setting to `cam` and `job`; false with `message` set on the first bad one.
+    bool apply(camera& cam, job_settings& job, std::string& message) {
+        while (at < words.size()) {
+            const std::string& name = words[at++];
+            bool ok;
+            if (name == "aspect_ratio")           ok = number(cam.aspect_ratio, 1e-3, 1e3);
+            else if (name == "image_width")       ok = integer(cam.image_width, 1, 16384);
+            else if (name == "samples_per_pixel") ok = integer(cam.samples_per_pixel, 1, 1 << 20);
+            else if (name == "max_depth")         ok = integer(cam.max_depth, 0, 1 << 10);
+            else if (name == "vfov")              ok = number(cam.vfov, 1e-3, 179.9);
+            else if (name == "lookfrom")          ok = vector(cam.lookfrom);
+            else if (name == "lookat")            ok = vector(cam.lookat);
+            else if (name == "vup")               ok = vector(cam.vup);
+            else if (name == "defocus_angle")     ok = number(cam.defocus_angle, 0, 180);
+            else if (name == "focus_dist")        ok = number(cam.focus_dist, 1e-6, 1e12);
+            else if (name == "tile_size")         ok = integer(cam.tile_size, 1, 4096);
+            else if (name == "frame")             ok = integer(cam.frame, 0, 1 << 30);
+            else if (name == "integrator") {
+                std::string value;
+                ok = word(value) && (value == "recursive" || value == "iterative");
+                cam.integrator = value == "iterative" ? integrator_type::iterative : integrator_type::recursive;
+            }
+            else if (name == "sample_lights") {
+                std::string value;
+                ok = word(value) && (value == "on" || value == "off");
+                cam.sample_lights = value == "on";
+            }
+            else if (name == "format") {
+                ok = word(job.format_name) && (job.format_name == "ppm" || job.format_name == "pfm" || job.format_name == "qoi");
+                job.format = image_format_from_path("." + job.format_name);
+            }
+            else if (name == "tiles") {
+                std::string value;
+                ok = word(value) && (value == "on" || value == "off");
+                job.stream_tiles = value == "on";
+            }
+            else {
+                message = "unknown setting '" + name + "'";
+                return false;
+            }
+            if (!ok) {
+                message = "bad value for " + name;
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    const std::vector<std::string>& words;
+    size_t at;
+
+    bool word(std::string& value) {
+        if (at >= words.size())
+            return false;
+        value = words[at++];
+        return true;
+    }
+
+    bool number(double& value, double lo, double hi) {
+        std::string w;
+        double v;
+        if (!word(w) || !text_parsing::parse_double(w.data(), w.data() + w.size(), v) || !(v >= lo && v <= hi))
+            return false;
+        value = v;
+        return true;
+    }
+
+    bool integer(int& value, int lo, int hi) {
+        std::string w;
+        int64_t v;
+        if (!word(w) || !text_parsing::parse_int(w.data(), w.data() + w.size(), v) || v < lo || v > hi)
+            return false;
+        value = static_cast<int>(v);
+        return true;
+    }
+
+    bool vector(vec3& value) {
+        double xyz[3];
+        for (double& c : xyz) {
+            if (!number(c, -1e12, 1e12))
+                return false;
+        }
+        value = vec3(xyz[0], xyz[1], xyz[2]);
+        return true;
+    }
+};
+
+// A tile message: its header line and the tile's pixels as little-endian floats.
+inline std::string encode_tile(const image& framebuffer, int x0, int y0, int x1, int y1) {
+    std::string message = "tile " + std::to_string(x0) + " " + std::to_string(y0) + " " + std::to_string(x1) + " "
+        + std::to_string(y1) + "\n";
+    size_t header = message.size();
+    size_t row_floats = static_cast<size_t>(x1 - x0) * 3;
+    message.resize(header + row_floats * (y1 - y0) * 4);
+    char* dst = &message[header];
+    for (int y = y0; y < y1; y++) {
+        const float* row = framebuffer.data() + (static_cast<size_t>(y) * framebuffer.width() + x0) * 3;
+        for (size_t k = 0; k < row_floats; k++) {
+            uint32_t bits;
+            std::memcpy(&bits, &row[k], sizeof(bits));
+            *dst++ = static_cast<char>(bits);
+            *dst++ = static_cast<char>(bits >> 8);
+            *dst++ = static_cast<char>(bits >> 16);
+            *dst++ = static_cast<char>(bits >> 24);
+        }
+    }
+    return message;
+}
+
+// Writes a tile message's pixels into `framebuffer`.
+inline void decode_tile(const std::vector<uint8_t>& bytes, image& framebuffer, int x0, int y0, int x1, int y1) {
+    const uint8_t* src = bytes.data();
+    for (int y = y0; y < y1; y++) {
+        float* row = framebuffer.data() + (static_cast<size_t>(y) * framebuffer.width() + x0) * 3;
+        for (size_t k = 0; k < static_cast<size_t>(x1 - x0) * 3; k++, src += 4) {
+            uint32_t bits = src[0] | uint32_t(src[1]) << 8 | uint32_t(src[2]) << 16 | uint32_t(src[3]) << 24;
+            std::memcpy(&row[k], &bits, sizeof(bits));
+        }
+    }
+}
+
+inline void put_double(std::string& out, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    for (int byte = 0; byte < 8; byte++)
+        out.push_back(static_cast<char>(bits >> (8 * byte)));
+}
+
+inline double get_double(const uint8_t* p) {
+    uint64_t bits = 0;
+    for (int byte = 0; byte < 8; byte++)
+        bits |= uint64_t(p[byte]) << (8 * byte);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+}  // namespace render_server_detail
+
+// Bytes per pixel of a region reply: the sample sum's red, green and blue and its luminance
+// square sum, as little-endian doubles.
+constexpr size_t region_pixel_bytes = 4 * 8;
+
+// Turns region reply bytes back into the sums the worker computed, `sample_count` samples each.
+inline std::vector<sample_sum> decode_region_sums(const std::vector<uint8_t>& bytes, int sample_count) {
+    std::vector<sample_sum> sums(bytes.size() / region_pixel_bytes);
+    const uint8_t* p = bytes.data();
+    for (auto& s : sums) {
+        using render_server_detail::get_double;
+        s.sum = color(get_double(p), get_double(p + 8), get_double(p + 16));
+        s.luminance_sq = get_double(p + 24);
+        s.count = sample_count;
+        p += region_pixel_bytes;
+    }
+    return sums;
+}
+
+// Every camera setting a job can carry, as job words that reproduce `cam` exactly on top of any
+// scene camera.
+inline std::string camera_job_settings(const camera& cam) {
+    std::string words;
+    auto number = [&words](const char* name, double v) {
+        char buffer[32];
+        scene_file_detail::format_double(v, buffer, sizeof(buffer));
+        words += std::string(" ") + name + " " + buffer;
+    };
+    auto vector = [&words](const char* name, const vec3& v) {
+        words += std::string(" ") + name;
+        for (int axis = 0; axis < 3; axis++) {
+            char buffer[32];
+            scene_file_detail::format_double(v[axis], buffer, sizeof(buffer));
+            words += std::string(" ") + buffer;
+        }
+    };
+    number("aspect_ratio", cam.aspect_ratio);
+    number("image_width", cam.image_width);
+    number("samples_per_pixel", cam.samples_per_pixel);
+    number("max_depth", cam.max_depth);
+    number("vfov", cam.vfov);
+    vector("lookfrom", cam.lookfrom);
+    vector("lookat", cam.lookat);
+    vector("vup", cam.vup);
+    number("defocus_angle", cam.defocus_angle);
+    number("focus_dist", cam.focus_dist);
+    number("frame", cam.frame);
+    words += cam.integrator == integrator_type::iterative ? " integrator iterative" : " integrator recursive";
+    words += cam.sample_lights ? " sample_lights on" : " sample_lights off";
+    return words;
+}
+
+class render_server {
+public:
+    // thread_count <= 0 renders on every hardware thread.
+    render_server(size_t cache_bytes, int thread_count) : cache(cache_bytes), pool(thread_count) {}
+
+    // Serves clients until one of them sends "shutdown". Returns the process exit code.
+    int run(const std::string& address) {
+        socket_listener listener;
+        if (!listener.listen(address))
+            return 1;
+        std::clog << "Serving on " << address << " with " << pool.size() << " render threads and a "
+            << cache.budget_bytes() / 1e6 << " MB scene cache\n";
+        while (!stopping) {
+            socket_connection client = listener.accept();
+            if (!client.is_open()) {
+                std::cerr << "Error: accept failed on " << address << std::endl;
+                return 1;
+            }
+            serve(client);
+        }
+        std::clog << "Server stopped\n";
+        return 0;
+    }
+
+private:
+    scene_cache cache;
+    thread_pool pool;
+    bool stopping = false;
+
+    void serve(socket_connection& client) {
+        std::string line;
+        while (client.read_line(line)) {
+            auto words = render_server_detail::split_words(line);
+            if (words.empty())
+                continue;
+            bool connected;
+            try {
+                connected = command(client, words);
+            }
+            catch (const std::exception& e) {
+                // One bad job (say, a framebuffer too large to allocate) must not take the server down.
+                std::cerr << "Error: " << line << ": " << e.what() << std::endl;
+                connected = client.send_all("error " + std::string(e.what()) + "\n");
+            }
+            if (!connected)
+                break;
+        }
+    }
+
+    // Answers one request; returns false once the client is gone.
+    bool command(socket_connection& client, const std::vector<std::string>& words) {
+        bool connected;
+        if (words[0] == "render") {
+            connected = render(client, words);
+        }
+        else if (words[0] == "region") {
+            connected = render_region(client, words);
+        }
+        else if (words[0] == "status") {
+            connected = client.send_all("status scenes " + std::to_string(cache.size()) + " bytes "
+                + std::to_string(cache.bytes()) + " budget " + std::to_string(cache.budget_bytes()) + " hits "
+                + std::to_string(cache.hit_count()) + " misses " + std::to_string(cache.miss_count())
+                + " evictions " + std::to_string(cache.eviction_count()) + "\n");
+        }
+        else if (words[0] == "shutdown") {
+            stopping = true;
+            connected = client.send_all("ok shutting down\n");
+        }
+        else {
+            connected = client.send_all("error unknown command '" + words[0] + "'\n");
+        }
+        return connected;
+    }
+
+    // "region <scene> <x0> <y0> <x1> <y1> <first sample> <sample count> [setting value...]": the sample
+    // sums of a block of pixels, for a coordinator that merges them (see Distributed_render.h).
+    // Answered with "sums <bytes>" and region_pixel_bytes per pixel, row by row.
+    bool render_region(socket_connection& client, const std::vector<std::string>& words) {
+        using namespace render_server_detail;
+        if (words.size() < 8)
+            return client.send_all("error region needs a scene, pixel bounds and a sample range\n");
+        int64_t v[6];
+        for (int k = 0; k < 6; k++) {
+            const std::string& w = words[2 + k];
+            if (!text_parsing::parse_int(w.data(), w.data() + w.size(), v[k]) || v[k] < 0 || v[k] > (1 << 30))
+                return client.send_all("error bad region bounds\n");
+        }
+        // A region never needs samples past the largest samples_per_pixel a camera accepts.
+        if (v[4] + v[5] > (1 << 20))
+            return client.send_all("error bad sample range\n");
+
+        bool hit;
+        auto entry = cache.get(words[1], hit);
+        if (!entry)
+            return client.send_all("error could not load scene " + words[1] + "\n");
+        camera cam = entry->scene.cam;
+        job_settings job;
+        std::string message;
+        if (!job_parser(words, 8).apply(cam, job, message) || !(message = cam.settings_error()).empty())
+            return client.send_all("error " + message + "\n");
+        int x0 = int(v[0]), y0 = int(v[1]), x1 = int(v[2]), y1 = int(v[3]);
+        if (x0 >= x1 || y0 >= y1 || x1 > cam.image_width || y1 > cam.output_height() || v[5] < 1)
+            return client.send_all("error region outside the image\n");
+
+        cam.pool = &pool;
+        cam.writer = nullptr;
+        cam.stats = nullptr;
+        cam.lights = &entry->lights;
+        auto sums = cam.render_region(entry->world, entry->scene.materials, x0, y0, x1, y1, int(v[4]), int(v[5]));
+        std::string reply = "sums " + std::to_string(sums.size() * region_pixel_bytes) + "\n";
+        reply.reserve(reply.size() + sums.size() * region_pixel_bytes);
+        for (const auto& s : sums) {
+            put_double(reply, s.sum.x());
+            put_double(reply, s.sum.y());
+            put_double(reply, s.sum.z());
+            put_double(reply, s.luminance_sq);
+        }
+        return client.send_all(reply);
+    }
+
+    // Returns false once the client is gone.
+    bool render(socket_connection& client, const std::vector<std::string>& words) {
+        using namespace render_server_detail;
+        if (words.size() < 2)
+            return client.send_all("error render needs a scene\n");
+
+        bool hit;
+        auto entry = cache.get(words[1], hit);
+        if (!entry)
+            return client.send_all("error could not load scene " + words[1] + "\n");
+
+        camera cam = entry->scene.cam;
+        job_settings job;
+        std::string message;
+        // The settings are checked as a whole: the cached scene's own camera is not trusted either.
+        if (!job_parser(words, 2).apply(cam, job, message) || !(message = cam.settings_error()).empty())
+            return client.send_all("error " + message + "\n");
+
+        std::string reply = "ok " + std::to_string(cam.image_width) + " " + std::to_string(cam.output_height()) + " "
+            + (hit ? "hit " : "miss ") + std::to_string(hit ? 0.0 : entry->load_ms) + "\n";
+        if (!client.send_all(reply))
+            return false;
+
+        // Tiles finish on the render threads; their messages must not interleave. Once a send
+        // fails the rest of the job still renders, but nothing more is sent.
+        std::mutex send_mutex;
+        bool connected = true;
+        cam.pool = &pool;
+        cam.writer = nullptr;
+        cam.stats = nullptr;
+        cam.lights = &entry->lights;
+        if (job.stream_tiles) {
+            cam.on_tile = [&](const image& framebuffer, int x0, int y0, int x1, int y1) {
+                std::string tile = encode_tile(framebuffer, x0, y0, x1, y1);
+                std::lock_guard<std::mutex> lock(send_mutex);
+                if (connected)
+                    connected = client.send_all(tile);
+            };
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        image framebuffer = cam.render_image(entry->world, entry->scene.materials);
+        double trace_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::clog << "Rendered " << words[1] << " (" << (hit ? "cached" : "loaded") << ") at " << cam.image_width << "x"
+            << cam.output_height() << ", " << cam.samples_per_pixel << " spp in " << trace_ms << " ms\n";
+
+        auto encoded = encode_image(framebuffer, job.format);
+        return connected
+            && client.send_all("image " + job.format_name + " " + std::to_string(encoded.size()) + "\n")
+            && client.send_all(encoded.data(), encoded.size())
+            && client.send_all("done " + std::to_string(trace_ms) + "\n");
+    }
+};
+
+// Test client: sends `job` to the server at `address` and prints the replies. A render job's
+// streamed tiles are assembled as they arrive, and the final image is written to `output`; the
+// time to the first tile and to the whole image are reported, and the assembled tiles are checked
+// against the final image. Without a format setting in the job, the output file's extension
+// picks one.
+inline int run_render_client(const std::string& address, std::string job, const std::string& output) {
+    using namespace render_server_detail;
+    socket_connection server = connect_socket(address);
+    if (!server.is_open())
+        return 1;
+
+    auto words = split_words(job);
+    bool render = !words.empty() && words[0] == "render";
+    if (render && job.find(" format ") == std::string::npos) {
+        switch (image_format_from_path(output)) {
+        case image_format::pfm: job += " format pfm"; break;
+        case image_format::qoi: job += " format qoi"; break;
+        default: break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::string line;
+    if (!server.send_all(job + "\n") || !server.read_line(line)) {
+        std::cerr << "Error: The server closed the connection" << std::endl;
+        return 1;
+    }
+    std::cout << line << "\n";
+    if (!render || line.compare(0, 3, "ok ") != 0)
+        return line.compare(0, 6, "error ") == 0 ? 1 : 0;
+
+    // "ok <width> <height> hit|miss <load ms>"
+    auto header = split_words(line);
+    int64_t width, height;
+    if (header.size() != 5 || !parse_size(header[1], width) || !parse_size(header[2], height)) {
+        std::cerr << "Error: Bad reply from the server: " << line << std::endl;
+        return 1;
+    }
+    image framebuffer(static_cast<int>(width), static_cast<int>(height));
+    size_t tiles = 0;
+    double first_tile_ms = 0;
+    std::vector<uint8_t> bytes;
+    std::string format;
+    while (server.read_line(line)) {
+        auto reply = split_words(line);
+        if (reply.size() == 5 && reply[0] == "tile") {
+            int64_t b[4];
+            bool valid = true;
+            for (int k = 0; k < 4; k++)
+                valid = valid && text_parsing::parse_int(reply[k + 1].data(), reply[k + 1].data() + reply[k + 1].size(), b[k]);
+            if (!valid || b[0] < 0 || b[1] < 0 || b[2] > framebuffer.width() || b[3] > framebuffer.height() || b[0] >= b[2] || b[1] >= b[3])
+                break;
+            int x0 = int(b[0]), y0 = int(b[1]), x1 = int(b[2]), y1 = int(b[3]);
+            bytes.resize(static_cast<size_t>(x1 - x0) * (y1 - y0) * 3 * 4);
+            if (!server.read_bytes(bytes.data(), bytes.size()))
+                break;
+            decode_tile(bytes, framebuffer, x0, y0, x1, y1);
+            if (tiles++ == 0)
+                first_tile_ms = elapsed_ms();
+        }
+        else if (reply.size() == 3 && reply[0] == "image") {
+            int64_t size;
+            // No format takes more than a float per channel, plus its header.
+            if (!text_parsing::parse_int(reply[2].data(), reply[2].data() + reply[2].size(), size) || size < 0
+                || size > width * height * 12 + 1024)
+                break;
+            format = reply[1];
+            bytes.resize(static_cast<size_t>(size));
+            if (!server.read_bytes(bytes.data(), bytes.size()))
+                break;
+        }
+        else if (reply.size() == 2 && reply[0] == "done") {
+            std::cout << tiles << " tiles streamed, first after " << first_tile_ms << " ms; image after " << elapsed_ms()
+                << " ms (server trace " << reply[1] << " ms)\n";
+            if (tiles > 0) {
+                bool same = encode_image(framebuffer, image_format_from_path("." + format)) == bytes;
+                std::cout << "Streamed tiles " << (same ? "match" : "differ from") << " the final image\n";
+            }
+            if (!write_file(output, bytes))
+                return 1;
+            std::cout << "Image saved as " << output << "\n";
+            return 0;
+        }
+        else {
+            std::cout << line << "\n";
+            return 1;
+        }
+    }
+    std::cerr << "Error: The server closed the connection" << std::endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include "Color.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Render statistics.
+// Hot-path counters (rays per bounce, BVH nodes, box and primitive tests, scatter calls) are only
+// compiled in when ORACLE_STATS is defined; otherwise ORACLE_STAT() drops its argument and the
+// hot paths are unchanged. Each thread counts into its own render_counters without any
+// synchronization. The camera takes the difference of a thread's counters around every tile and
+// merges it into the render_stats of the render, together with the tile's time.
+//
+// Phase timings and per-tile times are cheap and recorded whether or not counters are compiled in.
+
+#if defined(ORACLE_STATS)
+#define ORACLE_STAT(statement) statement
+#else
+#define ORACLE_STAT(statement)
+#endif
+
+struct render_counters {
+    static constexpr int depth_slots = 64;  // Rays at this bounce or deeper share the last slot
+    static constexpr int material_types = 4;
+
+    uint64_t rays[depth_slots] = {};        // Rays traced, by bounce (0 = camera rays)
+    uint64_t bvh_nodes = 0;                 // BVH nodes visited
+    uint64_t aabb_tests = 0;                // Ray-box tests
+    uint64_t sphere_tests = 0;              // Ray-sphere tests
+    uint64_t sphere_hits = 0;               // Sphere tests that found a closer hit
+    uint64_t triangle_tests = 0;            // Ray-triangle tests
+    uint64_t triangle_hits = 0;             // Triangle tests that found a closer hit
+    uint64_t scatter[material_types] = {};  // scatter() calls, indexed by material_type
+    uint64_t max_depth_paths = 0;           // Paths cut off by max_depth rather than escaping or being absorbed
+    uint64_t shadow_rays = 0;               // Rays toward sampled lights (not part of `rays`)
+
+    // The calling thread's counters.
+    static render_counters& local() {
+        thread_local render_counters counters;
+        return counters;
+    }
+
+    void count_ray(int bounce) {
+        rays[std::min(std::max(bounce, 0), depth_slots - 1)]++;
+    }
+
+    uint64_t total_rays() const {
+        uint64_t total = 0;
+        for (auto n : rays)
+            total += n;
+        return total;
+    }
+
+    // Adds `other` (sign = 1) or takes it away (sign = -1).
+    void merge(const render_counters& other, int sign = 1) {
+        auto add = [sign](uint64_t& a, uint64_t b) { a = sign > 0 ? a + b : a - b; };
+        for (int d = 0; d < depth_slots; d++)
+            add(rays[d], other.rays[d]);
+        add(bvh_nodes, other.bvh_nodes);
+        add(aabb_tests, other.aabb_tests);
+        add(sphere_tests, other.sphere_tests);
+        add(sphere_hits, other.sphere_hits);
+        add(triangle_tests, other.triangle_tests);
+        add(triangle_hits, other.triangle_hits);
+        for (int m = 0; m < material_types; m++)
+            add(scatter[m], other.scatter[m]);
+        add(max_depth_paths, other.max_depth_paths);
+        add(shadow_rays, other.shadow_rays);
+    }
+};
+
+struct tile_stats {
+    int x0, y0, x1, y1;     // Pixel bounds, half-open
+    double seconds = 0;     // Render time, summed over passes
+    uint64_t rays = 0;
+    uint64_t bvh_nodes = 0;
+};
+
+class render_stats {
+public:
+    static constexpr bool counters_enabled =
+#if defined(ORACLE_STATS)
+        true;
+#else
+        false;
+#endif
+
+    double build_seconds = 0;   // Acceleration structure construction
+    double trace_seconds = 0;   // Rendering tiles
+    double output_seconds = 0;  // Encoding and writing images
+    render_counters counters;
+
+    // Called before every render (or pass) with the image size and the edge of its tiles.
+    void begin(int image_width, int image_height, int tile_edge) {
+        std::lock_guard<std::mutex> lock(mutex);
+        width = image_width;
+        height = image_height;
+        edge = std::max(1, tile_edge);
+        columns = (width + edge - 1) / edge;
+        slots.assign(static_cast<size_t>(columns) * ((height + edge - 1) / edge), -1);
+        for (size_t i = 0; i < tiles.size(); i++) {
+            int s = slot(tiles[i].x0, tiles[i].y0);
+            if (s >= 0 && slots[s] < 0)
+                slots[s] = static_cast<int>(i);
+        }
+    }
+
+    // Thread-safe; repeated tiles (progressive passes) are added up.
+    void add_tile(int x0, int y0, int x1, int y1, double seconds, const render_counters& tile_counters) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.merge(tile_counters);
+        tile_stats& t = find_tile(x0, y0, x1, y1);
+        t.seconds += seconds;
+        t.rays += tile_counters.total_rays();
+        t.bvh_nodes += tile_counters.bvh_nodes;
+    }
+
+    const std::vector<tile_stats>& tile_list() const { return tiles; }
+
+    // Image of the render time per pixel of every tile, relative to the slowest tile.
+    image tile_heatmap() const {
+        image img(width, height);
+        double slowest = 0;
+        for (const auto& t : tiles)
+            slowest = std::max(slowest, time_per_pixel(t));
+        for (const auto& t : tiles) {
+            color c = heatmap_color(slowest > 0 ? time_per_pixel(t) / slowest : 0);
+            for (int y = t.y0; y < t.y1; y++) {
+                for (int x = t.x0; x < t.x1; x++)
+                    img.set(x, y, c);
+            }
+        }
+        return img;
+    }
+
+    bool write_json(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not create file " << path << std::endl;
+            return false;
+        }
+        out.precision(10);
+        out << "{\n  \"image\": { \"width\": " << width << ", \"height\": " << height << " },\n";
+        out << "  \"phases\": { \"build_seconds\": " << build_seconds << ", \"trace_seconds\": " << trace_seconds
+            << ", \"output_seconds\": " << output_seconds << " },\n";
+        out << "  \"counters_enabled\": " << (counters_enabled ? "true" : "false") << ",\n";
+        if (counters_enabled) {
+            static const char* material_names[render_counters::material_types] = { "lambertian", "metal", "dielectric", "diffuse_light" };
+            uint64_t rays = counters.total_rays();
+            int deepest = 0;
+            for (int d = 0; d < render_counters::depth_slots; d++) {
+                if (counters.rays[d])
+                    deepest = d;
+            }
+            out << "  \"counters\": {\n    \"rays\": " << rays << ",\n    \"rays_by_depth\": [";
+            for (int d = 0; d <= deepest; d++)
+                out << (d ? ", " : "") << counters.rays[d];
+            out << "],\n    \"bvh_nodes\": " << counters.bvh_nodes
+                << ",\n    \"aabb_tests\": " << counters.aabb_tests
+                << ",\n    \"sphere_tests\": " << counters.sphere_tests
+                << ",\n    \"sphere_hits\": " << counters.sphere_hits
+                << ",\n    \"triangle_tests\": " << counters.triangle_tests
+                << ",\n    \"triangle_hits\": " << counters.triangle_hits
+                << ",\n    \"scatter\": {";
+            for (int m = 0; m < render_counters::material_types; m++)
+                out << (m ? ", " : " ") << "\"" << material_names[m] << "\": " << counters.scatter[m];
+            out << " },\n    \"max_depth_paths\": " << counters.max_depth_paths
+                << ",\n    \"shadow_rays\": " << counters.shadow_rays
+                << ",\n    \"bvh_nodes_per_ray\": " << (rays ? double(counters.bvh_nodes) / rays : 0.0)
+                << ",\n    \"sphere_tests_per_ray\": " << (rays ? double(counters.sphere_tests) / rays : 0.0)
+                << ",\n    \"triangle_tests_per_ray\": " << (rays ? double(counters.triangle_tests) / rays : 0.0)
+                << ",\n    \"mrays_per_s\": " << (trace_seconds > 0 ? rays / trace_seconds / 1e6 : 0.0) << "\n  },\n";
+        }
+        out << "  \"tiles\": [";
+        for (size_t i = 0; i < tiles.size(); i++) {
+            const tile_stats& t = tiles[i];
+            out << (i ? ",\n" : "\n") << "    { \"x\": " << t.x0 << ", \"y\": " << t.y0 << ", \"width\": " << t.x1 - t.x0
+                << ", \"height\": " << t.y1 - t.y0 << ", \"seconds\": " << t.seconds;
+            if (counters_enabled)
+                out << ", \"rays\": " << t.rays << ", \"bvh_nodes\": " << t.bvh_nodes;
+            out << " }";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    int width = 0;
+    int height = 0;
+    int edge = 1;
+    int columns = 0;
+    std::vector<tile_stats> tiles;
+    std::vector<int> slots;   // Index into `tiles` of the tile at every tile-grid cell, or -1
+    std::mutex mutex;
+
+    // Grid cell of a tile starting at (x0, y0); tiles of one render never share a cell.
+    int slot(int x0, int y0) const {
+        if (x0 < 0 || y0 < 0 || x0 >= width || y0 >= height)
+            return -1;
+        return (y0 / edge) * columns + x0 / edge;
+    }
+
+    // The tile starting at (x0, y0), added on its first pass. Through the grid in O(1); a cell that
+    // holds another tile (a render of a region at another offset into the same stats) falls back
+    // to a search.
+    tile_stats& find_tile(int x0, int y0, int x1, int y1) {
+        int s = slot(x0, y0);
+        if (s >= 0 && slots[s] >= 0 && tiles[slots[s]].x0 == x0 && tiles[slots[s]].y0 == y0)
+            return tiles[slots[s]];
+        if (s < 0 || slots[s] >= 0) {
+            auto it = std::find_if(tiles.begin(), tiles.end(), [&](const tile_stats& t) { return t.x0 == x0 && t.y0 == y0; });
+            if (it != tiles.end())
+                return *it;
+        }
+        if (s >= 0 && slots[s] < 0)
+            slots[s] = static_cast<int>(tiles.size());
+        tiles.push_back({ x0, y0, x1, y1 });
+        return tiles.back();
+    }
+
+    static double time_per_pixel(const tile_stats& t) {
+        return t.seconds / (static_cast<double>(t.x1 - t.x0) * (t.y1 - t.y0));
+    }
+};
+
+#endif
@@ -0,0 +1,736 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "Camera.h"
+#include "Mapped_file.h"
+#include "Material.h"
+#include "Obj_file.h"
+#include "Scene_geometry.h"
+#include "Text_parsing.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Scene files: camera settings, materials, spheres and triangle meshes, in a text and a binary form.
+//
+// Text form, one statement per line, '#' starts a comment:
+//
+//     camera image_width 800           # Any camera setting below, followed by its value(s)
+//     camera lookfrom 0 1.5 4
+//     material ground lambertian 0.5 0.5 0.5
+//     material gold metal 0.8 0.6 0.4 0.1      # albedo, fuzz
+//     material glass dielectric 1.5             # index of refraction
+//     material lamp diffuse_light 4 4 4         # emitted radiance
+//     sphere 0 -1000 0 1000 ground              # center, radius, material name
+//     moving_sphere 0 1 0 0 1.5 0 0.2 glass     # center at time 0, center at time 1, radius, material
+//     mesh bunny.obj gold 10 0 -1 0             # OBJ file, material, optional scale and offset
+//
+// Materials must be defined before the spheres and meshes that use them. Mesh paths are relative
+// to the scene file. Camera settings: aspect_ratio, image_width, samples_per_pixel, max_depth,
+// vfov, lookfrom, lookat, vup, defocus_angle, focus_dist.
+//
+// Binary form, little-endian: "OSCN", version, material count, sphere count, the camera block,
+// one 48-byte record per material, then the spheres as columns (center x, y, z, motion x, y, z,
+// radius as doubles, then 32-bit material indices). Columns load straight into the sphere SoA.
+// Version 2 adds the triangle mesh: vertex count, triangle count, flags (1 = vertex normals),
+// the positions and normals as x, y, z columns of doubles, then three 32-bit vertex indices and
+// a 32-bit material index per triangle. Version 1 files, which have no mesh, still load.
+//
+// Both loaders map the file and append to a scene_geometry's sphere and triangle storage directly,
+// so no per-object allocation happens however many primitives the file holds. Meshes are only
+// written in the binary form; the text form references them as OBJ files.
+
+struct scene_description {
+    camera cam;
+    material_table materials;
+    scene_geometry geometry;
+};
+
+enum class scene_format {
+    text,
+    binary
+};
+
+inline scene_format scene_format_from_path(const std::string& path) {
+    auto dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (auto& ch : ext)
+        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    return ext == "oscn" ? scene_format::binary : scene_format::text;
+}
+
+namespace scene_file_detail {
+
+constexpr char magic[4] = { 'O', 'S', 'C', 'N' };
+constexpr uint32_t version = 2;
+constexpr size_t header_size = 24;
+constexpr size_t camera_size = 120;
+constexpr size_t material_size = 48;
+constexpr size_t sphere_size = 7 * 8 + 4;
+constexpr size_t mesh_header_size = 24;
+constexpr size_t vertex_size = 3 * 8;
+constexpr size_t triangle_size = 4 * 4;
+constexpr uint32_t mesh_has_normals = 1;
+
+inline void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int k = 0; k < 4; k++)
+        out.push_back(static_cast<uint8_t>(v >> (8 * k)));
+}
+
+inline void put64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int k = 0; k < 8; k++)
+        out.push_back(static_cast<uint8_t>(v >> (8 * k)));
+}
+
+inline void put_double(std::vector<uint8_t>& out, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    put64(out, bits);
+}
+
+inline void put_vec3(std::vector<uint8_t>& out, const vec3& v) {
+    put_double(out, v.x());
+    put_double(out, v.y());
+    put_double(out, v.z());
+}
+
+inline uint32_t get32(const char* p) {
+    const auto* b = reinterpret_cast<const uint8_t*>(p);
+    return static_cast<uint32_t>(b[0]) | static_cast<uint32_t>(b[1]) << 8
+        | static_cast<uint32_t>(b[2]) << 16 | static_cast<uint32_t>(b[3]) << 24;
+}
+
+inline uint64_t get64(const char* p) {
+    return get32(p) | static_cast<uint64_t>(get32(p + 4)) << 32;
+}
+
+inline double get_double(const char* p) {
+    uint64_t bits = get64(p);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline vec3 get_vec3(const char* p) {
+    return vec3(get_double(p), get_double(p + 8), get_double(p + 16));
+}
+
+using text_parsing::is_digit;
+using text_parsing::is_space;
+using text_parsing::parse_double;
+
+// Shortest of %.15g and %.17g that reads back as the same double.
+inline void format_double(double v, char* buffer, size_t size) {
+    // Single-precision builds: a widened float only needs the digits that read back as the same float.
+    if (std::is_same<real, float>::value && static_cast<double>(static_cast<float>(v)) == v) {
+        for (int digits = 6; digits <= 9; digits++) {
+            std::snprintf(buffer, size, "%.*g", digits, v);
+            if (std::strtof(buffer, nullptr) == static_cast<float>(v))
+                return;
+        }
+    }
+    std::snprintf(buffer, size, "%.15g", v);
+    if (std::strtod(buffer, nullptr) != v)
+        std::snprintf(buffer, size, "%.17g", v);
+}
+
+class text_parser {
+public:
+    text_parser(const std::string& path, const char* begin, const char* end, scene_description& scene)
+        : path(path), p(begin), end(end), scene(scene) {}
+
+    bool parse() {
+        // Every line holds at most one sphere; counting lines first lets the sphere arrays be
+        // allocated once instead of growing as the file is read.
+        size_t lines = 1;
+        for (const char* q = p; (q = static_cast<const char*>(std::memchr(q, '\n', end - q))) != nullptr; q++)
+            lines++;
+        scene.geometry.reserve(scene.geometry.size() + lines);
+
+        while (p < end) {
+            skip_blanks();
+            if (p < end && *p != '\n' && *p != '#' && !statement())
+                return false;
+            skip_blanks();
+            if (p < end && *p == '#') {
+                while (p < end && *p != '\n')
+                    p++;
+            }
+            if (p < end && *p != '\n')
+                return error("unexpected '" + std::string(p, token_end()) + "'");
+            if (p < end) {
+                p++;
+                line++;
+            }
+        }
+        // Settings constrain each other (the height depends on width and aspect ratio), so the
+        // camera is checked once all are read. A problem is reported at the line that set the
+        // value its message starts with, or else at the last camera setting.
+        std::string problem = scene.cam.settings_error();
+        if (!problem.empty()) {
+            auto it = camera_lines.find(problem.substr(0, problem.find(' ')));
+            line = last_camera_line;
+            if (it != camera_lines.end())
+                line = it->second;
+            return error(problem);
+        }
+        return true;
+    }
+
+private:
+    const std::string& path;
+    const char* p;
+    const char* end;
+    scene_description& scene;
+    int line = 1;
+    std::unordered_map<std::string, uint32_t> material_ids;
+    std::string last_material;
+    uint32_t last_material_id = 0;
+    std::unordered_map<std::string, int> camera_lines;   // Line of every camera setting read
+    int last_camera_line = 0;
+
+    bool error(const std::string& message) const {
+        std::cerr << "Error: " << path << ":" << line << ": " << message << std::endl;
+        return false;
+    }
+
+    void skip_blanks() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    const char* token_end() const {
+        const char* q = p;
+        while (q < end && !is_space(*q) && *q != '#')
+            q++;
+        return q;
+    }
+
+    bool read_word(std::string& out) {
+        skip_blanks();
+        const char* q = token_end();
+        if (q == p)
+            return error("missing value");
+        out.assign(p, q);
+        p = q;
+        return true;
+    }
+
+    // Compares the next token with `keyword` without copying it.
+    bool next_is(const char* keyword) {
+        skip_blanks();
+        const char* q = token_end();
+        size_t n = static_cast<size_t>(q - p);
+        if (n != std::strlen(keyword) || std::memcmp(p, keyword, n) != 0)
+            return false;
+        p = q;
+        return true;
+    }
+
+    bool read_number(double& value) {
+        skip_blanks();
+        const char* q = token_end();
+        if (q == p)
+            return error("missing number");
+        if (!parse_double(p, q, value))
+            return error("'" + std::string(p, q) + "' is not a number");
+        p = q;
+        return true;
+    }
+
+    bool read_integer(int& value) {
+        double v;
+        if (!read_number(v))
+            return false;
+        // Range first: converting a double outside int's range is undefined.
+        if (!(v >= std::numeric_limits<int>::min() && v <= std::numeric_limits<int>::max()) || v != std::floor(v))
+            return error("expected an integer");
+        value = static_cast<int>(v);
+        return true;
+    }
+
+    bool read_vec3(vec3& v) {
+        double x, y, z;
+        if (!read_number(x) || !read_number(y) || !read_number(z))
+            return false;
+        v = vec3(x, y, z);
+        return true;
+    }
+
+    bool material_ref(uint32_t& id) {
+        skip_blanks();
+        const char* q = token_end();
+        if (q == p)
+            return error("missing material");
+        // Consecutive spheres mostly share a material; skip the map lookup when it repeats.
+        size_t n = static_cast<size_t>(q - p);
+        if (n != last_material.size() || std::memcmp(p, last_material.data(), n) != 0) {
+            auto it = material_ids.find(std::string(p, q));
+            if (it == material_ids.end())
+                return error("unknown material '" + std::string(p, q) + "'");
+            last_material = it->first;
+            last_material_id = it->second;
+        }
+        id = last_material_id;
+        p = q;
+        return true;
+    }
+
+    bool statement() {
+        if (next_is("sphere")) {
+            point3 center;
+            double radius;
+            uint32_t mat;
+            if (!read_vec3(center) || !read_number(radius) || !material_ref(mat))
+                return false;
+            scene.geometry.add_sphere(center, vec3(0, 0, 0), radius, mat);
+            return true;
+        }
+        if (next_is("moving_sphere")) {
+            point3 center1, center2;
+            double radius;
+            uint32_t mat;
+            if (!read_vec3(center1) || !read_vec3(center2) || !read_number(radius) || !material_ref(mat))
+                return false;
+            scene.geometry.add_sphere(center1, center2 - center1, radius, mat);
+            return true;
+        }
+        if (next_is("mesh"))
+            return mesh_statement();
+        if (next_is("material"))
+            return material_definition();
+        if (next_is("camera"))
+            return camera_setting();
+        return error("unknown statement '" + std::string(p, token_end()) + "'");
+    }
+
+    bool at_line_end() {
+        skip_blanks();
+        return p == end || *p == '\n' || *p == '#';
+    }
+
+    bool mesh_statement() {
+        std::string file;
+        uint32_t mat;
+        if (!read_word(file) || !material_ref(mat))
+            return false;
+        obj_transform transform;
+        if (!at_line_end()) {
+            if (!read_number(transform.scale))
+                return false;
+            if (!(transform.scale > 0))
+                return error("mesh scale must be positive");
+            if (!at_line_end() && !read_vec3(transform.offset))
+                return false;
+        }
+        // Relative to the directory of the scene file.
+        bool absolute = !file.empty() && (file[0] == '/' || file[0] == '\\' || (file.size() > 1 && file[1] == ':'));
+        auto slash = path.find_last_of("/\\");
+        if (!absolute && slash != std::string::npos)
+            file = path.substr(0, slash + 1) + file;
+        if (!load_obj(file, scene.geometry, mat, transform))
+            return error("could not load mesh " + file);
+        return true;
+    }
+
+    bool material_definition() {
+        std::string name;
+        if (!read_word(name))
+            return false;
+        if (material_ids.count(name))
+            return error("material '" + name + "' is defined twice");
+
+        vec3 albedo;
+        double value;
+        uint32_t id;
+        if (next_is("lambertian")) {
+            if (!read_vec3(albedo)) return false;
+            id = scene.materials.add(lambertian(albedo));
+        }
+        else if (next_is("metal")) {
+            if (!read_vec3(albedo) || !read_number(value)) return false;
+            id = scene.materials.add(metal(albedo, value));
+        }
+        else if (next_is("dielectric")) {
+            if (!read_number(value)) return false;
+            id = scene.materials.add(dielectric(value));
+        }
+        else if (next_is("diffuse_light")) {
+            if (!read_vec3(albedo)) return false;
+            id = scene.materials.add(diffuse_light(albedo));
+        }
+        else {
+            return error("unknown material type '" + std::string(p, token_end()) + "'");
+        }
+        material_ids[name] = id;
+        return true;
+    }
+
+    bool camera_setting() {
+        camera& cam = scene.cam;
+        skip_blanks();
+        std::string name(p, token_end());
+        bool ok;
+        if (next_is("aspect_ratio"))           ok = read_number(cam.aspect_ratio);
+        else if (next_is("image_width"))       ok = read_integer(cam.image_width);
+        else if (next_is("samples_per_pixel")) ok = read_integer(cam.samples_per_pixel);
+        else if (next_is("max_depth"))         ok = read_integer(cam.max_depth);
+        else if (next_is("vfov"))              ok = read_number(cam.vfov);
+        else if (next_is("lookfrom"))          ok = read_vec3(cam.lookfrom);
+        else if (next_is("lookat"))            ok = read_vec3(cam.lookat);
+        else if (next_is("vup"))               ok = read_vec3(cam.vup);
+        else if (next_is("defocus_angle"))     ok = read_number(cam.defocus_angle);
+        else if (next_is("focus_dist"))        ok = read_number(cam.focus_dist);
+        else return error("unknown camera setting '" + std::string(p, token_end()) + "'");
+        if (ok)
+            camera_lines[name] = last_camera_line = line;
+        return ok;
+    }
+};
+
+inline bool load_text(const std::string& path, const mapped_file& file, scene_description& scene) {
+    text_parser parser(path, file.data(), file.data() + file.size(), scene);
+    return parser.parse();
+}
+
+inline bool load_binary(const std::string& path, const mapped_file& file, scene_description& scene) {
+    const char* data = file.data();
+    size_t size = file.size();
+    uint32_t file_version = size >= header_size ? get32(data + 4) : 0;
+    if (size < header_size + camera_size || file_version < 1 || file_version > version) {
+        std::cerr << "Error: " << path << " is not a version 1 to " << version << " scene file" << std::endl;
+        return false;
+    }
+    uint32_t material_count = get32(data + 8);
+    uint64_t sphere_count = get64(data + 16);
+    size_t fixed_size = header_size + camera_size + static_cast<size_t>(material_count) * material_size;
+    bool complete = size >= fixed_size && sphere_count <= (size - fixed_size) / sphere_size;
+    size_t mesh_offset = complete ? fixed_size + static_cast<size_t>(sphere_count) * sphere_size : 0;
+    uint64_t vertex_count = 0, triangle_count = 0;
+    uint32_t mesh_flags = 0;
+    if (complete && file_version >= 2) {
+        complete = size - mesh_offset >= mesh_header_size;
+        if (complete) {
+            vertex_count = get64(data + mesh_offset);
+            triangle_count = get64(data + mesh_offset + 8);
+            mesh_flags = get32(data + mesh_offset + 16);
+            size_t vertex_bytes = vertex_size * ((mesh_flags & mesh_has_normals) ? 2 : 1);
+            size_t rest = size - mesh_offset - mesh_header_size;
+            complete = vertex_count <= rest / vertex_bytes && triangle_count <= UINT32_MAX
+                && vertex_count < UINT32_MAX
+                && rest == vertex_count * vertex_bytes + triangle_count * triangle_size;
+        }
+    }
+    else if (complete) {
+        complete = mesh_offset == size;
+    }
+    if (!complete) {
+        std::cerr << "Error: Scene file " << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    const char* at = data + header_size;
+    camera& cam = scene.cam;
+    // Counts above INT_MAX saturate, so the check below rejects them instead of seeing them wrap.
+    auto get_int = [](const char* p) { return static_cast<int>(std::min<uint32_t>(get32(p), INT32_MAX)); };
+    cam.image_width = get_int(at);
+    cam.samples_per_pixel = get_int(at + 4);
+    cam.max_depth = get_int(at + 8);
+    cam.aspect_ratio = get_double(at + 16);
+    cam.vfov = get_double(at + 24);
+    cam.lookfrom = get_vec3(at + 32);
+    cam.lookat = get_vec3(at + 56);
+    cam.vup = get_vec3(at + 80);
+    cam.defocus_angle = get_double(at + 104);
+    cam.focus_dist = get_double(at + 112);
+    std::string problem = cam.settings_error();
+    if (!problem.empty()) {
+        std::cerr << "Error: " << path << ": " << problem << std::endl;
+        return false;
+    }
+    at += camera_size;
+
+    uint32_t first_material = static_cast<uint32_t>(scene.materials.size());
+    for (uint32_t i = 0; i < material_count; i++, at += material_size) {
+        color albedo = get_vec3(at + 8);
+        double fuzz = get_double(at + 32);
+        double ir = get_double(at + 40);
+        switch (static_cast<material_type>(at[0])) {
+        case material_type::lambertian: scene.materials.add(lambertian(albedo)); break;
+        case material_type::metal:      scene.materials.add(metal(albedo, fuzz)); break;
+        case material_type::dielectric: scene.materials.add(dielectric(ir)); break;
+        case material_type::diffuse_light: scene.materials.add(diffuse_light(albedo)); break;
+        default:
+            std::cerr << "Error: Scene file " << path << " has a material of unknown type " << int(at[0]) << std::endl;
+            return false;
+        }
+    }
+
+    size_t n = static_cast<size_t>(sphere_count);
+    const char* columns[7];
+    for (int c = 0; c < 7; c++)
+        columns[c] = at + c * n * 8;
+    const char* material_column = at + 7 * n * 8;
+
+    sphere_soa& spheres = scene.geometry.spheres;
+    size_t first = scene.geometry.add_spheres(n);
+    for (size_t i = 0; i < n; i++) {
+        size_t offset = i * 8;
+        uint32_t mat = get32(material_column + i * 4);
+        if (mat >= material_count) {
+            std::cerr << "Error: Sphere " << i << " in " << path << " uses undefined material " << mat << std::endl;
+            return false;
+        }
+        spheres.set(first + i,
+            point3(get_double(columns[0] + offset), get_double(columns[1] + offset), get_double(columns[2] + offset)),
+            vec3(get_double(columns[3] + offset), get_double(columns[4] + offset), get_double(columns[5] + offset)),
+            get_double(columns[6] + offset), first_material + mat);
+    }
+    if (triangle_count == 0)
+        return true;
+
+    size_t vertices = static_cast<size_t>(vertex_count), triangles = static_cast<size_t>(triangle_count);
+    bool normals = (mesh_flags & mesh_has_normals) != 0;
+    triangle_mesh& mesh = scene.geometry.triangles;
+    uint32_t base = static_cast<uint32_t>(mesh.vertex_count());
+    scene.geometry.reserve_triangles(base + vertices, triangles, normals);
+
+    at = data + mesh_offset + mesh_header_size;
+    const char* normal_columns = at + 3 * vertices * 8;
+    for (size_t i = 0; i < vertices; i++) {
+        size_t offset = i * 8;
+        point3 p(get_double(at + offset), get_double(at + vertices * 8 + offset), get_double(at + 2 * vertices * 8 + offset));
+        if (normals) {
+            mesh.add_vertex(p, vec3(get_double(normal_columns + offset), get_double(normal_columns + vertices * 8 + offset),
+                get_double(normal_columns + 2 * vertices * 8 + offset)));
+        }
+        else {
+            mesh.add_vertex(p);
+        }
+    }
+    at += (normals ? 6 : 3) * vertices * 8;
+    const char* triangle_materials = at + 12 * triangles;
+    for (size_t i = 0; i < triangles; i++) {
+        uint32_t a = get32(at + 12 * i), b = get32(at + 12 * i + 4), c = get32(at + 12 * i + 8);
+        uint32_t mat = get32(triangle_materials + 4 * i);
+        if (a >= vertex_count || b >= vertex_count || c >= vertex_count || mat >= material_count) {
+            std::cerr << "Error: Triangle " << i << " in " << path << " uses an undefined vertex or material" << std::endl;
+            return false;
+        }
+        scene.geometry.add_triangle(base + a, base + b, base + c, first_material + mat);
+    }
+    return true;
+}
+
+// Appends `bytes` to the file once enough has collected, so large scenes stream out in chunks.
+inline bool flush(std::ofstream& file, std::vector<uint8_t>& bytes, size_t threshold) {
+    if (bytes.size() < threshold)
+        return true;
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    bytes.clear();
+    return static_cast<bool>(file);
+}
+
+inline bool save_binary(const scene_description& scene, std::ofstream& file) {
+    const size_t chunk = 1 << 20;
+    const camera& cam = scene.cam;
+    const sphere_soa& spheres = scene.geometry.spheres;
+    size_t n = spheres.size();
+
+    std::vector<uint8_t> out;
+    out.reserve(chunk + 64);
+    out.insert(out.end(), magic, magic + 4);
+    put32(out, version);
+    put32(out, static_cast<uint32_t>(scene.materials.size()));
+    put32(out, 0);
+    put64(out, n);
+
+    put32(out, static_cast<uint32_t>(cam.image_width));
+    put32(out, static_cast<uint32_t>(cam.samples_per_pixel));
+    put32(out, static_cast<uint32_t>(cam.max_depth));
+    put32(out, 0);
+    put_double(out, cam.aspect_ratio);
+    put_double(out, cam.vfov);
+    put_vec3(out, cam.lookfrom);
+    put_vec3(out, cam.lookat);
+    put_vec3(out, cam.vup);
+    put_double(out, cam.defocus_angle);
+    put_double(out, cam.focus_dist);
+
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        const material& m = scene.materials[static_cast<uint32_t>(i)];
+        out.push_back(static_cast<uint8_t>(m.type()));
+        out.insert(out.end(), 7, 0);
+        put_vec3(out, m.get_albedo());
+        put_double(out, m.get_fuzz());
+        put_double(out, m.get_refraction_index());
+    }
+
+    for (int c = 0; c < 7; c++) {
+        for (size_t i = 0; i < n; i++) {
+            switch (c) {
+            case 0: put_double(out, spheres.start_center(i).x()); break;
+            case 1: put_double(out, spheres.start_center(i).y()); break;
+            case 2: put_double(out, spheres.start_center(i).z()); break;
+            case 3: put_double(out, spheres.motion(i).x()); break;
+            case 4: put_double(out, spheres.motion(i).y()); break;
+            case 5: put_double(out, spheres.motion(i).z()); break;
+            default: put_double(out, spheres.get_radius(i)); break;
+            }
+            if (!flush(file, out, chunk))
+                return false;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        put32(out, spheres.get_material(i));
+        if (!flush(file, out, chunk))
+            return false;
+    }
+
+    const triangle_mesh& mesh = scene.geometry.triangles;
+    const mesh_vertices& vertices = mesh.vertex_buffer();
+    size_t triangles = mesh.size();
+    // A mesh-less scene keeps no vertices, even if an earlier mesh left some in the buffer.
+    size_t vertex_count = triangles > 0 ? vertices.positions.size() : 0;
+    bool normals = triangles > 0 && mesh.has_normals();
+    put64(out, vertex_count);
+    put64(out, triangles);
+    put32(out, normals ? mesh_has_normals : 0);
+    put32(out, 0);
+    for (const auto* column : { &vertices.positions, &vertices.normals }) {
+        if (column == &vertices.normals && !normals)
+            break;
+        for (int axis = 0; axis < 3; axis++) {
+            for (size_t i = 0; i < vertex_count; i++) {
+                put_double(out, (*column)[i][axis]);
+                if (!flush(file, out, chunk))
+                    return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < triangles; i++) {
+        for (int corner = 0; corner < 3; corner++)
+            put32(out, mesh.vertex_index(i, corner));
+        if (!flush(file, out, chunk))
+            return false;
+    }
+    for (size_t i = 0; i < triangles; i++) {
+        put32(out, mesh.get_material(i));
+        if (!flush(file, out, chunk))
+            return false;
+    }
+    return flush(file, out, 0);
+}
+
+inline bool save_text(const scene_description& scene, std::ofstream& file) {
+    const size_t chunk = 1 << 20;
+    std::vector<uint8_t> out;
+    out.reserve(chunk + 512);
+    char number_buffer[32];
+
+    auto text = [&out](const char* s) { out.insert(out.end(), s, s + std::strlen(s)); };
+    auto num = [&](double v) {
+        format_double(v, number_buffer, sizeof(number_buffer));
+        out.push_back(' ');
+        text(number_buffer);
+    };
+    auto vec = [&](const vec3& v) { num(v.x()); num(v.y()); num(v.z()); };
+
+    const camera& cam = scene.cam;
+    text("# Oracle Raytracer scene\n");
+    text("camera aspect_ratio"); num(cam.aspect_ratio); text("\n");
+    text("camera image_width"); num(cam.image_width); text("\n");
+    text("camera samples_per_pixel"); num(cam.samples_per_pixel); text("\n");
+    text("camera max_depth"); num(cam.max_depth); text("\n");
+    text("camera vfov"); num(cam.vfov); text("\n");
+    text("camera lookfrom"); vec(cam.lookfrom); text("\n");
+    text("camera lookat"); vec(cam.lookat); text("\n");
+    text("camera vup"); vec(cam.vup); text("\n");
+    text("camera defocus_angle"); num(cam.defocus_angle); text("\n");
+    text("camera focus_dist"); num(cam.focus_dist); text("\n\n");
+
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        const material& m = scene.materials[static_cast<uint32_t>(i)];
+        text(("material m" + std::to_string(i)).c_str());
+        switch (m.type()) {
+        case material_type::metal:      text(" metal"); vec(m.get_albedo()); num(m.get_fuzz()); break;
+        case material_type::dielectric: text(" dielectric"); num(m.get_refraction_index()); break;
+        case material_type::diffuse_light: text(" diffuse_light"); vec(m.emitted()); break;
+        default:                        text(" lambertian"); vec(m.get_albedo()); break;
+        }
+        text("\n");
+    }
+    text("\n");
+
+    const sphere_soa& spheres = scene.geometry.spheres;
+    for (size_t i = 0; i < spheres.size(); i++) {
+        vec3 motion = spheres.motion(i);
+        if (motion.x() == 0 && motion.y() == 0 && motion.z() == 0) {
+            text("sphere"); vec(spheres.start_center(i));
+        }
+        else {
+            text("moving_sphere"); vec(spheres.start_center(i)); vec(spheres.start_center(i) + motion);
+        }
+        num(spheres.get_radius(i));
+        text((" m" + std::to_string(spheres.get_material(i)) + "\n").c_str());
+        if (!flush(file, out, chunk))
+            return false;
+    }
+    return flush(file, out, 0);
+}
+
+}  // namespace scene_file_detail
+
+// Appends the scene in `path` to `scene`: materials and primitives are added, camera settings in the
+// file overwrite the current ones. The format is recognized by the file's first bytes.
+inline bool load_scene(const std::string& path, scene_description& scene) {
+    mapped_file file(path);
+    if (!file.good()) {
+        std::cerr << "Error: Could not open scene file " << path << std::endl;
+        return false;
+    }
+    if (file.size() >= 4 && std::memcmp(file.data(), scene_file_detail::magic, 4) == 0)
+        return scene_file_detail::load_binary(path, file, scene);
+    return scene_file_detail::load_text(path, file, scene);
+}
+
+// Writes the scene to `path`, in binary if the extension is .oscn and as text otherwise.
+inline bool save_scene(const scene_description& scene, const std::string& path) {
+    size_t custom_count = scene.geometry.custom.size() + scene.geometry.instances.size();
+    if (custom_count > 0) {
+        std::cerr << "Error: " << custom_count << " custom primitives or instances cannot be written to a scene file" << std::endl;
+        return false;
+    }
+
+    bool binary = scene_format_from_path(path) == scene_format::binary;
+    if (!binary && scene.geometry.triangles.size() > 0) {
+        std::cerr << "Error: Triangle meshes can only be saved to a binary (.oscn) scene file" << std::endl;
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not create file " << path << std::endl;
+        return false;
+    }
+    bool written = binary
+        ? scene_file_detail::save_binary(scene, file)
+        : scene_file_detail::save_text(scene, file);
+    if (!written)
+        std::cerr << "Error: Could not write scene file " << path << std::endl;
+    return written;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SCENE_GEOMETRY_H
+#define SCENE_GEOMETRY_H
+
+#include "AABB.h"
+#include "Hittable.h"
+#include "Hittable_list.h"
+#include "Instance.h"
+#include "Sphere.h"
+#include "Sphere_soa.h"
+#include "Triangle_mesh.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Scene primitives bucketed by concrete type.
+// Every built-in primitive type has its own storage (spheres as structure-of-arrays, triangles as
+// an indexed mesh, instances by value), and a primitive_ref names one primitive as (kind, index into that kind's
+// storage). Acceleration structures store refs and call the type's intersection routine directly,
+// so the built-in types never go through a vtable.
+// Anything else that implements hittable (user shapes, nested acceleration structures) lands in
+// the `custom` bucket and is still reached through hittable::hit.
+
+enum class primitive_kind : uint8_t {
+    sphere,
+    triangle,
+    instance,
+    custom    // Any other hittable; keep last, leaves order their primitives by kind
+};
+
+struct primitive_ref {
+    primitive_kind kind;
+    uint32_t index;
+};
+
+class scene_geometry {
+public:
+    sphere_soa spheres;
+    triangle_mesh triangles;   // Every mesh of the scene, in one vertex and one index buffer
+    std::vector<instance> instances;
+    std::vector<shared_ptr<hittable>> custom;
+
+    scene_geometry() = default;
+
+    // Adapter from the pointer-based scene description: spheres are copied into their bucket,
+    // lists are flattened, everything else is kept as a custom primitive.
+    explicit scene_geometry(const hittable_list& list) { add(list); }
+
+    void add(const sphere& s) {
+        refs.push_back({ primitive_kind::sphere, static_cast<uint32_t>(spheres.size()) });
+        spheres.add(s);
+    }
+
+    void add_sphere(const point3& center, const vec3& motion, real radius, uint32_t material_id) {
+        refs.push_back({ primitive_kind::sphere, static_cast<uint32_t>(spheres.size()) });
+        spheres.add(center, motion, radius, material_id);
+    }
+
+    // Appends `n` spheres at once and returns the index of the first; scene loaders then fill them
+    // in place with spheres.set().
+    size_t add_spheres(size_t n) {
+        size_t first = spheres.size();
+        spheres.resize(first + n);
+        refs.reserve(refs.size() + n);
+        for (size_t i = first; i < first + n; i++)
+            refs.push_back({ primitive_kind::sphere, static_cast<uint32_t>(i) });
+        return first;
+    }
+
+    // Adds a triangle over vertices already in `triangles` (see triangle_mesh::add_vertex).
+    void add_triangle(uint32_t a, uint32_t b, uint32_t c, uint32_t material_id) {
+        refs.push_back({ primitive_kind::triangle, static_cast<uint32_t>(triangles.size()) });
+        triangles.add_triangle(a, b, c, material_id);
+    }
+
+    void add(const instance& object) {
+        refs.push_back({ primitive_kind::instance, static_cast<uint32_t>(instances.size()) });
+        instances.push_back(object);
+    }
+
+    void add(const shared_ptr<hittable>& object) {
+        if (auto s = dynamic_cast<const sphere*>(object.get())) {
+            add(*s);
+        }
+        else if (auto i = dynamic_cast<const instance*>(object.get())) {
+            add(*i);
+        }
+        else if (auto list = dynamic_cast<const hittable_list*>(object.get())) {
+            add(*list);
+        }
+        else {
+            refs.push_back({ primitive_kind::custom, static_cast<uint32_t>(custom.size()) });
+            custom.push_back(object);
+        }
+    }
+
+    void add(const hittable_list& list) {
+        for (const auto& object : list.objects)
+            add(object);
+    }
+
+    void reserve(size_t n) {
+        spheres.reserve(n);
+        refs.reserve(n);
+    }
+
+    void reserve_triangles(size_t vertex_count, size_t triangle_count, bool with_normals = false) {
+        triangles.reserve(vertex_count, triangles.size() + triangle_count, with_normals);
+        refs.reserve(refs.size() + triangle_count);
+    }
+
+    void clear() {
+        spheres.clear();
+        triangles.clear();
+        instances.clear();
+        custom.clear();
+        refs.clear();
+    }
+
+    // Every primitive, in the order it was added.
+    const std::vector<primitive_ref>& primitives() const { return refs; }
+    size_t size() const { return refs.size(); }
+
+    aabb bounding_box(primitive_ref p) const {
+        switch (p.kind) {
+        case primitive_kind::sphere:   return spheres.bounding_box(p.index);
+        case primitive_kind::triangle: return triangles.bounding_box(p.index);
+        case primitive_kind::instance: return instances[p.index].bounding_box();
+        default:                       return custom[p.index]->bounding_box();
+        }
+    }
+
+    bool hit(primitive_ref p, const ray& r, interval ray_t, hit_record& rec) const {
+        switch (p.kind) {
+        case primitive_kind::sphere:   return spheres.hit_one(p.index, r, ray_t, rec);
+        case primitive_kind::triangle: return triangles.hit_one(p.index, r, ray_t, rec);
+        case primitive_kind::instance: return instances[p.index].instance::hit(r, ray_t, rec);
+        default:                       return custom[p.index]->hit(r, ray_t, rec);
+        }
+    }
+
+private:
+    std::vector<primitive_ref> refs;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// SIMD support: runtime CPU feature detection, per-function target attributes and an aligned
+// allocator for structure-of-arrays storage.
+//
+// Kernels for every instruction set are compiled into the same binary; GCC/Clang need the
+// ORACLE_TARGET_* attributes to emit AVX code in functions of a translation unit built for
+// baseline x86-64, MSVC accepts the intrinsics anywhere. Which kernel runs is decided once at
+// startup by simd_support().
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ORACLE_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(ORACLE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ORACLE_TARGET_AVX2 __attribute__((target("avx2")))
+#define ORACLE_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define ORACLE_TARGET_AVX2
+#define ORACLE_TARGET_AVX512
+#endif
+
+// GCC 12 warns that the unmasked AVX-512 intrinsics read an uninitialized '__Y' (their merge
+// source is left undefined on purpose; fixed in later releases). Kernels using them sit between
+// these two, which silence just those warnings.
+#if defined(__GNUC__) && !defined(__clang__)
+#define ORACLE_AVX512_WARNINGS_BEGIN \
+    _Pragma("GCC diagnostic push") \
+    _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+    _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define ORACLE_AVX512_WARNINGS_END _Pragma("GCC diagnostic pop")
+#else
+#define ORACLE_AVX512_WARNINGS_BEGIN
+#define ORACLE_AVX512_WARNINGS_END
+#endif
+
+enum class simd_level {
+    scalar,
+    sse2,     // 2 doubles (4 floats) per register
+    avx2,     // 4 doubles (8 floats) per register
+    avx512    // 8 doubles (16 floats) per register
+};
+
+inline const char* simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::sse2:   return "sse2";
+    case simd_level::avx2:   return "avx2";
+    case simd_level::avx512: return "avx512";
+    default:                 return "scalar";
+    }
+}
+
+inline simd_level detect_simd_level() {
+#if defined(ORACLE_SIMD_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!sse2)
+        return simd_level::scalar;
+    if (!osxsave || !avx)
+        return simd_level::sse2;
+
+    // The OS must save the wider registers on context switches.
+    unsigned long long xcr0 = _xgetbv(0);
+    bool ymm_state = (xcr0 & 0x6) == 0x6;
+    bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+    if (max_leaf < 7 || !ymm_state)
+        return simd_level::sse2;
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    bool avx512f = (info[1] & (1 << 16)) != 0;
+    if (avx512f && zmm_state)
+        return simd_level::avx512;
+    if (avx2)
+        return simd_level::avx2;
+    return simd_level::sse2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_level::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return simd_level::avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return simd_level::sse2;
+    return simd_level::scalar;
+#endif
+#else
+    return simd_level::scalar;
+#endif
+}
+
+inline simd_level simd_support() {
+    // Detected once; the answer can't change while the process runs.
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+// Allocator for std::vector whose storage starts on an `Alignment`-byte boundary, so SIMD loads
+// from the start of an array never straddle cache lines.
+template <typename T, std::size_t Alignment = 64>
+class aligned_allocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        if (bytes == 0)
+            bytes = Alignment;
+#if defined(_MSC_VER)
+        void* p = _aligned_malloc(bytes, Alignment);
+#else
+        void* p = std::aligned_alloc(Alignment, bytes);
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t) {
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+};
+
+#endif
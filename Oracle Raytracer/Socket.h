@@ -0,0 +1,358 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Blocking stream sockets for the render server and its client.
+// An address is either a TCP port ("5555", on the loopback interface), a host and port
+// ("render-box:5555"), or the path of a Unix domain socket ("/tmp/oracle.sock"; POSIX only).
+// Connections read whole lines and exact byte counts, and write whole buffers; a failed call
+// means the peer is gone.
+
+namespace socket_detail {
+
+#if defined(_WIN32)
+using handle = SOCKET;
+constexpr handle invalid = INVALID_SOCKET;
+inline void close_handle(handle h) { closesocket(h); }
+
+// Winsock must be started once per process before any other call.
+inline bool startup() {
+    static bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+#else
+using handle = int;
+constexpr handle invalid = -1;
+inline void close_handle(handle h) { ::close(h); }
+inline bool startup() { return true; }
+#endif
+
+// A writer to a peer that has hung up gets an error instead of SIGPIPE.
+#if defined(MSG_NOSIGNAL)
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+inline void no_sigpipe(handle h) {
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(h, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)h;
+#endif
+}
+
+inline bool is_port(const std::string& address) {
+    if (address.empty() || address.size() > 5)
+        return false;
+    for (char c : address) {
+        if (c < '0' || c > '9')
+            return false;
+    }
+    return true;
+}
+
+// Splits "host:port" or "port"; false for Unix socket paths.
+inline bool tcp_address(const std::string& address, std::string& host, std::string& port) {
+    if (is_port(address)) {
+        host = "127.0.0.1";
+        port = address;
+        return true;
+    }
+    auto colon = address.find_last_of(':');
+    if (colon == std::string::npos || address.find_first_of("/\\") != std::string::npos || !is_port(address.substr(colon + 1)))
+        return false;
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    return true;
+}
+
+}  // namespace socket_detail
+
+class socket_connection {
+public:
+    socket_connection() = default;
+    explicit socket_connection(socket_detail::handle h) : h(h) {}
+    ~socket_connection() { close(); }
+
+    socket_connection(socket_connection&& other) noexcept : h(other.h), buffer(std::move(other.buffer)) {
+        other.h = socket_detail::invalid;
+    }
+    socket_connection& operator=(socket_connection&& other) noexcept {
+        if (this != &other) {
+            close();
+            h = other.h;
+            buffer = std::move(other.buffer);
+            other.h = socket_detail::invalid;
+        }
+        return *this;
+    }
+    socket_connection(const socket_connection&) = delete;
+    socket_connection& operator=(const socket_connection&) = delete;
+
+    bool is_open() const { return h != socket_detail::invalid; }
+
+    void close() {
+        if (is_open())
+            socket_detail::close_handle(h);
+        h = socket_detail::invalid;
+        buffer.clear();
+    }
+
+    // Makes sends and receives blocked on another thread fail, and every later one too.
+    void interrupt() {
+#if defined(_WIN32)
+        ::shutdown(h, SD_BOTH);
+#else
+        ::shutdown(h, SHUT_RDWR);
+#endif
+    }
+
+    // Sends and receives that block for longer than this fail; 0 waits forever.
+    void set_timeout(double seconds) {
+#if defined(_WIN32)
+        DWORD ms = static_cast<DWORD>(seconds * 1000);
+        setsockopt(h, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+        setsockopt(h, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+        timeval tv;
+        tv.tv_sec = static_cast<time_t>(seconds);
+        tv.tv_usec = static_cast<suseconds_t>((seconds - static_cast<double>(tv.tv_sec)) * 1e6);
+        setsockopt(h, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(h, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+    }
+
+    bool send_all(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            int chunk = static_cast<int>(size < (1u << 30) ? size : (1u << 30));
+            auto sent = ::send(h, p, chunk, socket_detail::send_flags);
+            if (sent <= 0)
+                return false;
+            p += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool send_all(const std::string& text) { return send_all(text.data(), text.size()); }
+
+    // Reads up to the next '\n', which is dropped along with a '\r' before it. Lines longer than
+    // max_line are refused, so a peer cannot make the reader buffer without bound.
+    bool read_line(std::string& line, size_t max_line = 1 << 16) {
+        size_t scanned = 0;
+        for (;;) {
+            auto newline = buffer.find('\n', scanned);
+            if (newline != std::string::npos) {
+                line.assign(buffer, 0, newline);
+                buffer.erase(0, newline + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                return true;
+            }
+            if (buffer.size() > max_line)
+                return false;
+            scanned = buffer.size();
+            if (!fill())
+                return false;
+        }
+    }
+
+    bool read_bytes(void* data, size_t size) {
+        char* out = static_cast<char*>(data);
+        size_t have = buffer.size() < size ? buffer.size() : size;
+        std::memcpy(out, buffer.data(), have);
+        buffer.erase(0, have);
+        while (have < size) {
+            auto got = ::recv(h, out + have, static_cast<int>(size - have), 0);
+            if (got <= 0)
+                return false;
+            have += static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+private:
+    socket_detail::handle h = socket_detail::invalid;
+    std::string buffer;   // Received but not yet consumed
+
+    bool fill() {
+        char chunk[4096];
+        auto got = ::recv(h, chunk, sizeof(chunk), 0);
+        if (got <= 0)
+            return false;
+        buffer.append(chunk, static_cast<size_t>(got));
+        return true;
+    }
+};
+
+class socket_listener {
+public:
+    socket_listener() = default;
+    ~socket_listener() { close(); }
+
+    socket_listener(const socket_listener&) = delete;
+    socket_listener& operator=(const socket_listener&) = delete;
+
+    // Binds `address` and starts listening. An existing Unix socket file at the path is replaced.
+    bool listen(const std::string& address) {
+        close();
+        if (!socket_detail::startup())
+            return fail("could not start Winsock");
+        std::string host, port;
+        if (socket_detail::tcp_address(address, host, port)) {
+            addrinfo hints = {}, *found = nullptr;
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || !found)
+                return fail("could not resolve " + address);
+            h = ::socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+            if (h != socket_detail::invalid) {
+                int on = 1;
+                setsockopt(h, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+                if (::bind(h, found->ai_addr, static_cast<int>(found->ai_addrlen)) != 0)
+                    close();
+            }
+            freeaddrinfo(found);
+            tcp = true;
+        }
+        else {
+#if defined(_WIN32)
+            return fail("Unix domain sockets are not supported here; give a TCP port");
+#else
+            sockaddr_un name = {};
+            name.sun_family = AF_UNIX;
+            if (address.size() >= sizeof(name.sun_path))
+                return fail("socket path " + address + " is too long");
+            std::memcpy(name.sun_path, address.c_str(), address.size() + 1);
+            ::unlink(address.c_str());
+            h = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (h != socket_detail::invalid) {
+                if (::bind(h, reinterpret_cast<const sockaddr*>(&name), sizeof(name)) != 0)
+                    close();
+                else
+                    unix_path = address;
+            }
+            tcp = false;
+#endif
+        }
+        if (h == socket_detail::invalid || ::listen(h, 16) != 0) {
+            close();
+            return fail("could not listen on " + address);
+        }
+        return true;
+    }
+
+    // Blocks until a client connects; the result is closed if the listener failed.
+    socket_connection accept() {
+        socket_detail::handle client = ::accept(h, nullptr, nullptr);
+        if (client == socket_detail::invalid)
+            return socket_connection();
+        socket_detail::no_sigpipe(client);
+        if (tcp) {
+            // Tiles are sent as they finish; don't hold them back to fill a segment.
+            int on = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+        }
+        return socket_connection(client);
+    }
+
+    void close() {
+        if (h != socket_detail::invalid)
+            socket_detail::close_handle(h);
+        h = socket_detail::invalid;
+#if !defined(_WIN32)
+        if (!unix_path.empty())
+            ::unlink(unix_path.c_str());
+#endif
+        unix_path.clear();
+    }
+
+private:
+    socket_detail::handle h = socket_detail::invalid;
+    bool tcp = false;
+    std::string unix_path;   // Removed again on close
+
+    static bool fail(const std::string& message) {
+        std::cerr << "Error: " << message << std::endl;
+        return false;
+    }
+};
+
+// Connects to a listening socket_listener; the result is closed (and an error printed, unless
+// report_errors is false) on failure.
+inline socket_connection connect_socket(const std::string& address, bool report_errors = true) {
+    if (!socket_detail::startup())
+        return socket_connection();
+    std::string host, port;
+    socket_detail::handle h = socket_detail::invalid;
+    if (socket_detail::tcp_address(address, host, port)) {
+        addrinfo hints = {}, *found = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) == 0) {
+            for (addrinfo* a = found; a && h == socket_detail::invalid; a = a->ai_next) {
+                h = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (h != socket_detail::invalid && ::connect(h, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0) {
+                    socket_detail::close_handle(h);
+                    h = socket_detail::invalid;
+                }
+            }
+            freeaddrinfo(found);
+        }
+    }
+#if !defined(_WIN32)
+    else if (address.size() < sizeof(sockaddr_un::sun_path)) {
+        sockaddr_un name = {};
+        name.sun_family = AF_UNIX;
+        std::memcpy(name.sun_path, address.c_str(), address.size() + 1);
+        h = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (h != socket_detail::invalid && ::connect(h, reinterpret_cast<const sockaddr*>(&name), sizeof(name)) != 0) {
+            socket_detail::close_handle(h);
+            h = socket_detail::invalid;
+        }
+    }
+#endif
+    if (h == socket_detail::invalid) {
+        if (report_errors)
+            std::cerr << "Error: Could not connect to " << address << std::endl;
+        return socket_connection();
+    }
+    socket_detail::no_sigpipe(h);
+    return socket_connection(h);
+}
+
+#endif
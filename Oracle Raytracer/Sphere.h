@@ -1,23 +1,24 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
-#include "hittable.h"
+#include "Hittable.h"
+#include "Render_stats.h"
 
 class sphere : public hittable {
 public:
     sphere() : radius(0.0) {}
     // Stationary Sphere
-    sphere(const point3& static_center, double radius, shared_ptr<material> mat)
-        : center(static_center, vec3(0, 0, 0)), radius(std::fmax(0, radius)), mat(mat)
+    sphere(const point3& static_center, real radius, uint32_t material_id)
+        : center(static_center, vec3(0, 0, 0)), radius(std::fmax(0, radius)), mat(material_id)
     {
         auto rvec = vec3(radius, radius, radius);
         bbox = aabb(static_center - rvec, static_center + rvec);
     }
 
     // Moving Sphere
-    sphere(const point3& center1, const point3& center2, double radius,
-        shared_ptr<material> mat)
-        : center(center1, center2 - center1), radius(std::fmax(0, radius)), mat(mat)
+    sphere(const point3& center1, const point3& center2, real radius,
+        uint32_t material_id)
+        : center(center1, center2 - center1), radius(std::fmax(0, radius)), mat(material_id)
     {
         auto rvec = vec3(radius, radius, radius);
         aabb box1(center.at(0) - rvec, center.at(0) + rvec);
@@ -26,6 +27,12 @@ public:
     }
     aabb bounding_box() const override { return bbox; }
 
+    // Raw parameters, for containers that repack spheres into their own layout (see sphere_soa).
+    const point3& start_center() const { return center.origin(); }
+    const vec3& motion() const { return center.direction(); }
+    real get_radius() const { return radius; }
+    uint32_t get_material() const { return mat; }
+
     virtual bool hit(
         const ray& r, interval ray_t, hit_record& rec) const override;
 
@@ -33,11 +40,12 @@ private:
     ray center;
     aabb bbox;
 
-    double radius;
-    shared_ptr<material> mat;
+    real radius;
+    uint32_t mat;
 };
 
 bool sphere::hit(const ray& r, interval ray_t, hit_record& rec) const {
+    ORACLE_STAT(render_counters::local().sphere_tests++);
     point3 current_center = center.at(r.time());
     vec3 oc = current_center - r.origin();
     auto a = r.direction().length_squared();
@@ -49,9 +57,10 @@ bool sphere::hit(const ray& r, interval ray_t, hit_record& rec) const {
     auto sqrtd = sqrt(discriminant);
 
     // Find the nearest root that lies in the acceptable range.
-    auto root = (-half_b - sqrtd) / a;
+    // oc points from the ray origin to the center, so the roots are (half_b -/+ sqrtd) / a.
+    auto root = (half_b - sqrtd) / a;
     if (!ray_t.surrounds(root)) {
-        root = (-half_b + sqrtd) / a;
+        root = (half_b + sqrtd) / a;
         if (!ray_t.surrounds(root)) {
             return false;
         }
@@ -61,7 +70,8 @@ bool sphere::hit(const ray& r, interval ray_t, hit_record& rec) const {
     rec.p = r.at(rec.t);
     vec3 outward_normal = (rec.p - current_center) / radius;    rec.set_face_normal(r, outward_normal);
 
-    rec.mat = mat;
+    rec.material_id = mat;
+    ORACLE_STAT(render_counters::local().sphere_hits++);
 
     return true;
 }
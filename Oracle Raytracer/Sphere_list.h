@@ -3,47 +3,37 @@
 
 #include "Hittable.h"
 #include "Sphere.h"
-#include <vector>
-#include <memory>
-
-using std::shared_ptr;
-using std::make_shared;
+#include "Sphere_soa.h"
 
 class sphere_list : public hittable {
 public:
     sphere_list() = default;
 
-    // add a sphere by value
+    // add a sphere by value; it is repacked into the structure-of-arrays store
     void add(const sphere& s) {
-        objects.push_back(make_shared<sphere>(s));
+        spheres.add(s);
+        bbox = aabb(bbox, s.bounding_box());
     }
 
     // clear all spheres
     void clear() {
-        objects.clear();
+        spheres.clear();
+        bbox = aabb();
     }
 
-    // test ray against all spheres in the list
+    // test ray against all spheres in the list; only the closest sphere's hit record is filled in
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        bool hit_anything = false;
-        double closest_so_far = ray_t.max;
-        hit_record temp_rec;
-
-        for (const auto& obj : objects) {
-            // restrict t to [ray_t.min, closest_so_far]
-            interval t_interval{ ray_t.min, closest_so_far };
-            if (obj->hit(r, t_interval, temp_rec)) {
-                hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
-            }
-        }
-
-        return hit_anything;
+        return spheres.hit(r, ray_t, rec);
     }
 
+    aabb bounding_box() const override { return bbox; }
+
+    size_t size() const { return spheres.size(); }
+    void set_simd_level(simd_level level) { spheres.set_simd_level(level); }
+
 private:
-    std::vector<shared_ptr<sphere>> objects;
+    sphere_soa spheres;
+    aabb bbox;
 };
 
 #endif // SPHERE_LIST_H
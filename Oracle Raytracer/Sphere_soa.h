@@ -0,0 +1,563 @@
+#ifndef SPHERE_SOA_H
+#define SPHERE_SOA_H
+
+#include "Hittable.h"
+#include "Render_stats.h"
+#include "Simd.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Structure-of-arrays sphere storage.
+// Centers, motion vectors, radii and material ids live in separate aligned arrays, so one ray can
+// be tested against a whole register of spheres at once. closest_hit() only finds the nearest t
+// and the index of the winning sphere; resolve() fills the hit_record for that one sphere.
+//
+// The arrays always carry `padding` trailing NaN entries, so kernels may load a full register
+// starting anywhere in [0, size()) without reading past the allocation. NaN centers never pass
+// the discriminant test.
+
+class sphere_soa {
+public:
+    static constexpr size_t padding = 64 / sizeof(real);  // Widest kernel: one AVX-512 register
+
+    sphere_soa() : level(simd_support()) { pad(); }
+
+    size_t size() const { return count; }
+
+    // Heap bytes held by the arrays, padding and spare capacity included.
+    size_t memory_bytes() const {
+        return (cx.capacity() + cy.capacity() + cz.capacity() + mx.capacity() + my.capacity() + mz.capacity()
+            + radius.capacity()) * sizeof(real) + material_id.capacity() * sizeof(uint32_t);
+    }
+
+    void clear() {
+        cx.clear(); cy.clear(); cz.clear();
+        mx.clear(); my.clear(); mz.clear();
+        radius.clear(); material_id.clear();
+        count = 0;
+        pad();
+    }
+
+    // Makes room for `n` spheres in total, so filling a store of known size allocates once.
+    void reserve(size_t n) {
+        for (auto* a : { &cx, &cy, &cz, &mx, &my, &mz, &radius })
+            a->reserve(n + padding);
+        material_id.reserve(n + padding);
+    }
+
+    void add(const sphere& s) {
+        const point3& c = s.start_center();
+        const vec3& m = s.motion();
+        set(count, c.x(), c.y(), c.z(), m.x(), m.y(), m.z(), s.get_radius(), s.get_material());
+        count++;
+        pad();
+    }
+
+    void add(const point3& center, const vec3& motion, real r, uint32_t mat) {
+        set(count, center, motion, r, mat);
+        count++;
+        pad();
+    }
+
+    // Appends sphere `i` of another store.
+    void add(const sphere_soa& other, size_t i) {
+        set(count, other.cx[i], other.cy[i], other.cz[i], other.mx[i], other.my[i], other.mz[i], other.radius[i], other.material_id[i]);
+        count++;
+        pad();
+    }
+
+    // Overwrites sphere `i` with sphere `j` of another store.
+    void set(size_t i, const sphere_soa& other, size_t j) {
+        set(i, other.cx[j], other.cy[j], other.cz[j], other.mx[j], other.my[j], other.mz[j], other.radius[j], other.material_id[j]);
+    }
+
+    // Grows or shrinks the store to `n` spheres. New slots can never be hit until set() fills them,
+    // so bulk loaders can size the arrays once and write every column in place.
+    void resize(size_t n) {
+        size_t previous_count = count;
+        count = n;
+        pad(previous_count);
+    }
+
+    void set(size_t i, const point3& center, const vec3& motion, real r, uint32_t mat) {
+        set(i, center.x(), center.y(), center.z(), motion.x(), motion.y(), motion.z(), std::fmax(real(0), r), mat);
+    }
+
+    // Parameters of sphere `i`, as the sphere class stores them.
+    point3 start_center(size_t i) const { return point3(cx[i], cy[i], cz[i]); }
+    vec3 motion(size_t i) const { return vec3(mx[i], my[i], mz[i]); }
+    real get_radius(size_t i) const { return radius[i]; }
+    uint32_t get_material(size_t i) const { return material_id[i]; }
+
+    // Box around sphere `i` over the whole shutter interval.
+    aabb bounding_box(size_t i) const {
+        point3 c0 = start_center(i);
+        point3 c1 = c0 + motion(i);
+        vec3 rvec(radius[i], radius[i], radius[i]);
+        return aabb(aabb(c0 - rvec, c0 + rvec), aabb(c1 - rvec, c1 + rvec));
+    }
+
+    // Box around sphere `i` at one instant of the shutter interval.
+    aabb bounding_box(size_t i, real time) const {
+        point3 c = start_center(i) + time * motion(i);
+        vec3 rvec(radius[i], radius[i], radius[i]);
+        return aabb(c - rvec, c + rvec);
+    }
+
+    bool is_moving(size_t i) const { return mx[i] != 0 || my[i] != 0 || mz[i] != 0; }
+
+    // Intersects sphere `i` alone.
+    bool hit_one(size_t i, const ray& r, interval ray_t, hit_record& rec) const {
+        real t;
+        size_t index;
+        ORACLE_STAT(render_counters::local().sphere_tests++);
+        if (!closest_scalar(r, ray_t, i, i + 1, t, index))
+            return false;
+        resolve(r, t, index, rec);
+        return true;
+    }
+
+    // Forces a narrower kernel than the CPU supports (for benchmarks); wider requests are clamped.
+    void set_simd_level(simd_level requested) {
+        level = requested <= simd_support() ? requested : simd_support();
+    }
+
+    simd_level get_simd_level() const { return level; }
+
+    // Finds the nearest sphere in [begin, end) hit within ray_t. On success t_hit and index hold
+    // the winner; ties go to the lower index, as with a front-to-back scalar loop.
+    bool closest_hit(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        if (begin >= end)
+            return false;
+        ORACLE_STAT(render_counters::local().sphere_tests += end - begin);
+        // One or two spheres (typical of BVH leaves) are cheaper in scalar code than the vector
+        // kernels' broadcast setup and lane reduction.
+        if (end - begin < 3)
+            return closest_scalar(r, ray_t, begin, end, t_hit, index);
+        switch (level) {
+#if defined(ORACLE_SIMD_X86)
+        case simd_level::avx512: return closest_avx512(r, ray_t, begin, end, t_hit, index);
+        case simd_level::avx2:   return closest_avx2(r, ray_t, begin, end, t_hit, index);
+        case simd_level::sse2:   return closest_sse2(r, ray_t, begin, end, t_hit, index);
+#endif
+        default:                 return closest_scalar(r, ray_t, begin, end, t_hit, index);
+        }
+    }
+
+    // Fills in the hit record for sphere `index` hit at `t`.
+    void resolve(const ray& r, real t, size_t index, hit_record& rec) const {
+        ORACLE_STAT(render_counters::local().sphere_hits++);
+        real time = r.time();
+        point3 current_center(cx[index] + time * mx[index], cy[index] + time * my[index], cz[index] + time * mz[index]);
+        rec.t = t;
+        rec.p = r.at(t);
+        vec3 outward_normal = (rec.p - current_center) / radius[index];
+        rec.set_face_normal(r, outward_normal);
+        rec.material_id = material_id[index];
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+        real t;
+        size_t index;
+        if (!closest_hit(r, ray_t, 0, count, t, index))
+            return false;
+        resolve(r, t, index, rec);
+        return true;
+    }
+
+private:
+    using real_array = std::vector<real, aligned_allocator<real>>;
+
+    real_array cx, cy, cz;       // Center at time 0
+    real_array mx, my, mz;       // Center displacement from time 0 to time 1
+    real_array radius;
+    std::vector<uint32_t, aligned_allocator<uint32_t>> material_id;
+    size_t count = 0;
+    simd_level level;
+
+    void set(size_t i, real x, real y, real z, real dx, real dy, real dz, real r, uint32_t mat) {
+        cx[i] = x; cy[i] = y; cz[i] = z;
+        mx[i] = dx; my[i] = dy; mz[i] = dz;
+        radius[i] = r;
+        material_id[i] = mat;
+    }
+
+    // Fills [count, count + padding) with unhittable spheres. Slots the resize appends get those
+    // values from resize(), so only slots that held spheres before (below `previous_count`, when
+    // the store shrank) are overwritten.
+    void pad(size_t previous_count = 0) {
+        size_t n = count + padding;
+        const real nan = std::numeric_limits<real>::quiet_NaN();
+        for (auto* a : { &cx, &cy, &cz })
+            a->resize(n, nan);
+        for (auto* a : { &mx, &my, &mz, &radius })
+            a->resize(n, real(0));
+        material_id.resize(n, 0);
+        for (size_t i = count; i < std::min(previous_count, n); i++)
+            set(i, nan, nan, nan, 0, 0, 0, 0, 0);
+    }
+
+    bool closest_scalar(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        real time = r.time();
+        real a = d.length_squared();
+        // Compare a * t instead of t, so only the winner needs a division.
+        real scaled_min = ray_t.min * a;
+        real scaled_best = ray_t.max * a;
+        bool found = false;
+
+        for (size_t i = begin; i < end; i++) {
+            real ocx = cx[i] + time * mx[i] - o.x();
+            real ocy = cy[i] + time * my[i] - o.y();
+            real ocz = cz[i] + time * mz[i] - o.z();
+            real h = ocx * d.x() + ocy * d.y() + ocz * d.z();
+            real c = ocx * ocx + ocy * ocy + ocz * ocz - radius[i] * radius[i];
+            real discriminant = h * h - a * c;
+            if (!(discriminant >= 0))
+                continue;
+            real sqrtd = std::sqrt(discriminant);
+
+            real root = h - sqrtd;
+            if (!(scaled_min < root && root < scaled_best)) {
+                root = h + sqrtd;
+                if (!(scaled_min < root && root < scaled_best))
+                    continue;
+            }
+            scaled_best = root;
+            index = i;
+            found = true;
+        }
+        if (found)
+            t_hit = scaled_best / a;
+        return found;
+    }
+
+    // Picks the lane with the smallest t (lowest index on ties) after a vector kernel. The kernels
+    // track a * t, so the division by a happens here, once.
+    template <typename Lane, typename Index>
+    static bool reduce_lanes(const Lane* lane_t, const Index* lane_index, int lanes, real a, real& t_hit, size_t& index) {
+        int best = -1;
+        for (int k = 0; k < lanes; k++) {
+            if (lane_index[k] < 0)
+                continue;
+            if (best < 0 || lane_t[k] < lane_t[best] || (lane_t[k] == lane_t[best] && lane_index[k] < lane_index[best]))
+                best = k;
+        }
+        if (best < 0)
+            return false;
+        t_hit = lane_t[best] / a;
+        index = static_cast<size_t>(lane_index[best]);
+        return true;
+    }
+
+#if defined(ORACLE_SIMD_X86) && !defined(ORACLE_FLOAT)
+    bool closest_sse2(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()), oz = _mm_set1_pd(o.z());
+        const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()), dz = _mm_set1_pd(d.z());
+        const __m128d time = _mm_set1_pd(r.time());
+        const __m128d a = _mm_set1_pd(d.length_squared());
+        const __m128d t_min = _mm_set1_pd(ray_t.min * d.length_squared());
+        const __m128d last = _mm_set1_pd(static_cast<double>(end));
+        const __m128d lane = _mm_set_pd(1, 0);
+        const __m128d zero = _mm_setzero_pd();
+
+        __m128d best_t = _mm_set1_pd(ray_t.max * d.length_squared());
+        __m128d best_index = _mm_set1_pd(-1);
+
+        auto select = [](__m128d mask, __m128d a, __m128d b) {
+            return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+        };
+
+        for (size_t i = begin; i < end; i += 2) {
+            __m128d idx = _mm_add_pd(_mm_set1_pd(static_cast<double>(i)), lane);
+            __m128d ocx = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(&cx[i]), _mm_mul_pd(time, _mm_loadu_pd(&mx[i]))), ox);
+            __m128d ocy = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(&cy[i]), _mm_mul_pd(time, _mm_loadu_pd(&my[i]))), oy);
+            __m128d ocz = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(&cz[i]), _mm_mul_pd(time, _mm_loadu_pd(&mz[i]))), oz);
+            __m128d rad = _mm_loadu_pd(&radius[i]);
+
+            __m128d h = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, dx), _mm_mul_pd(ocy, dy)), _mm_mul_pd(ocz, dz));
+            __m128d c = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz)),
+                _mm_mul_pd(rad, rad));
+            __m128d discriminant = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(a, c));
+            __m128d valid = _mm_and_pd(_mm_cmpge_pd(discriminant, zero), _mm_cmplt_pd(idx, last));
+
+            __m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(discriminant, zero));
+            __m128d near_t = _mm_sub_pd(h, sqrtd);
+            __m128d far_t = _mm_add_pd(h, sqrtd);
+            __m128d near_ok = _mm_and_pd(_mm_cmpgt_pd(near_t, t_min), _mm_cmplt_pd(near_t, best_t));
+            __m128d far_ok = _mm_and_pd(_mm_cmpgt_pd(far_t, t_min), _mm_cmplt_pd(far_t, best_t));
+
+            __m128d t = select(near_ok, near_t, far_t);
+            __m128d take = _mm_and_pd(valid, _mm_or_pd(near_ok, far_ok));
+            best_t = select(take, t, best_t);
+            best_index = select(take, idx, best_index);
+        }
+
+        alignas(16) double lane_t[2], lane_index[2];
+        _mm_store_pd(lane_t, best_t);
+        _mm_store_pd(lane_index, best_index);
+        return reduce_lanes(lane_t, lane_index, 2, d.length_squared(), t_hit, index);
+    }
+
+    ORACLE_TARGET_AVX2
+    bool closest_avx2(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+        const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()), dz = _mm256_set1_pd(d.z());
+        const __m256d time = _mm256_set1_pd(r.time());
+        const __m256d a = _mm256_set1_pd(d.length_squared());
+        const __m256d t_min = _mm256_set1_pd(ray_t.min * d.length_squared());
+        const __m256d last = _mm256_set1_pd(static_cast<double>(end));
+        const __m256d lane = _mm256_set_pd(3, 2, 1, 0);
+        const __m256d zero = _mm256_setzero_pd();
+
+        __m256d best_t = _mm256_set1_pd(ray_t.max * d.length_squared());
+        __m256d best_index = _mm256_set1_pd(-1);
+
+        for (size_t i = begin; i < end; i += 4) {
+            __m256d idx = _mm256_add_pd(_mm256_set1_pd(static_cast<double>(i)), lane);
+            __m256d ocx = _mm256_sub_pd(_mm256_add_pd(_mm256_loadu_pd(&cx[i]), _mm256_mul_pd(time, _mm256_loadu_pd(&mx[i]))), ox);
+            __m256d ocy = _mm256_sub_pd(_mm256_add_pd(_mm256_loadu_pd(&cy[i]), _mm256_mul_pd(time, _mm256_loadu_pd(&my[i]))), oy);
+            __m256d ocz = _mm256_sub_pd(_mm256_add_pd(_mm256_loadu_pd(&cz[i]), _mm256_mul_pd(time, _mm256_loadu_pd(&mz[i]))), oz);
+            __m256d rad = _mm256_loadu_pd(&radius[i]);
+
+            __m256d h = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, dx), _mm256_mul_pd(ocy, dy)), _mm256_mul_pd(ocz, dz));
+            __m256d c = _mm256_sub_pd(
+                _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz)),
+                _mm256_mul_pd(rad, rad));
+            __m256d discriminant = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(a, c));
+            __m256d valid = _mm256_and_pd(_mm256_cmp_pd(discriminant, zero, _CMP_GE_OQ), _mm256_cmp_pd(idx, last, _CMP_LT_OQ));
+
+            __m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(discriminant, zero));
+            __m256d near_t = _mm256_sub_pd(h, sqrtd);
+            __m256d far_t = _mm256_add_pd(h, sqrtd);
+            __m256d near_ok = _mm256_and_pd(_mm256_cmp_pd(near_t, t_min, _CMP_GT_OQ), _mm256_cmp_pd(near_t, best_t, _CMP_LT_OQ));
+            __m256d far_ok = _mm256_and_pd(_mm256_cmp_pd(far_t, t_min, _CMP_GT_OQ), _mm256_cmp_pd(far_t, best_t, _CMP_LT_OQ));
+
+            __m256d t = _mm256_blendv_pd(far_t, near_t, near_ok);
+            __m256d take = _mm256_and_pd(valid, _mm256_or_pd(near_ok, far_ok));
+            best_t = _mm256_blendv_pd(best_t, t, take);
+            best_index = _mm256_blendv_pd(best_index, idx, take);
+        }
+
+        alignas(32) double lane_t[4], lane_index[4];
+        _mm256_store_pd(lane_t, best_t);
+        _mm256_store_pd(lane_index, best_index);
+        return reduce_lanes(lane_t, lane_index, 4, d.length_squared(), t_hit, index);
+    }
+
+ORACLE_AVX512_WARNINGS_BEGIN
+    ORACLE_TARGET_AVX512
+    bool closest_avx512(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m512d ox = _mm512_set1_pd(o.x()), oy = _mm512_set1_pd(o.y()), oz = _mm512_set1_pd(o.z());
+        const __m512d dx = _mm512_set1_pd(d.x()), dy = _mm512_set1_pd(d.y()), dz = _mm512_set1_pd(d.z());
+        const __m512d time = _mm512_set1_pd(r.time());
+        const __m512d a = _mm512_set1_pd(d.length_squared());
+        const __m512d t_min = _mm512_set1_pd(ray_t.min * d.length_squared());
+        const __m512d last = _mm512_set1_pd(static_cast<double>(end));
+        const __m512d lane = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m512d zero = _mm512_setzero_pd();
+
+        __m512d best_t = _mm512_set1_pd(ray_t.max * d.length_squared());
+        __m512d best_index = _mm512_set1_pd(-1);
+
+        for (size_t i = begin; i < end; i += 8) {
+            __m512d idx = _mm512_add_pd(_mm512_set1_pd(static_cast<double>(i)), lane);
+            __m512d ocx = _mm512_sub_pd(_mm512_add_pd(_mm512_loadu_pd(&cx[i]), _mm512_mul_pd(time, _mm512_loadu_pd(&mx[i]))), ox);
+            __m512d ocy = _mm512_sub_pd(_mm512_add_pd(_mm512_loadu_pd(&cy[i]), _mm512_mul_pd(time, _mm512_loadu_pd(&my[i]))), oy);
+            __m512d ocz = _mm512_sub_pd(_mm512_add_pd(_mm512_loadu_pd(&cz[i]), _mm512_mul_pd(time, _mm512_loadu_pd(&mz[i]))), oz);
+            __m512d rad = _mm512_loadu_pd(&radius[i]);
+
+            __m512d h = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ocx, dx), _mm512_mul_pd(ocy, dy)), _mm512_mul_pd(ocz, dz));
+            __m512d c = _mm512_sub_pd(
+                _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ocx, ocx), _mm512_mul_pd(ocy, ocy)), _mm512_mul_pd(ocz, ocz)),
+                _mm512_mul_pd(rad, rad));
+            __m512d discriminant = _mm512_sub_pd(_mm512_mul_pd(h, h), _mm512_mul_pd(a, c));
+            __mmask8 valid = _mm512_cmp_pd_mask(discriminant, zero, _CMP_GE_OQ) & _mm512_cmp_pd_mask(idx, last, _CMP_LT_OQ);
+
+            __m512d sqrtd = _mm512_sqrt_pd(_mm512_max_pd(discriminant, zero));
+            __m512d near_t = _mm512_sub_pd(h, sqrtd);
+            __m512d far_t = _mm512_add_pd(h, sqrtd);
+            __mmask8 near_ok = _mm512_cmp_pd_mask(near_t, t_min, _CMP_GT_OQ) & _mm512_cmp_pd_mask(near_t, best_t, _CMP_LT_OQ);
+            __mmask8 far_ok = _mm512_cmp_pd_mask(far_t, t_min, _CMP_GT_OQ) & _mm512_cmp_pd_mask(far_t, best_t, _CMP_LT_OQ);
+
+            __m512d t = _mm512_mask_blend_pd(near_ok, far_t, near_t);
+            __mmask8 take = valid & (near_ok | far_ok);
+            best_t = _mm512_mask_blend_pd(take, best_t, t);
+            best_index = _mm512_mask_blend_pd(take, best_index, idx);
+        }
+
+        alignas(64) double lane_t[8], lane_index[8];
+        _mm512_store_pd(lane_t, best_t);
+        _mm512_store_pd(lane_index, best_index);
+        return reduce_lanes(lane_t, lane_index, 8, d.length_squared(), t_hit, index);
+    }
+ORACLE_AVX512_WARNINGS_END
+#elif defined(ORACLE_SIMD_X86)
+    // Single-precision kernels: twice the lanes per register. Lane indices are tracked as 32-bit
+    // integers, which floats could not hold exactly past 2^24.
+    bool closest_sse2(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m128 ox = _mm_set1_ps(o.x()), oy = _mm_set1_ps(o.y()), oz = _mm_set1_ps(o.z());
+        const __m128 dx = _mm_set1_ps(d.x()), dy = _mm_set1_ps(d.y()), dz = _mm_set1_ps(d.z());
+        const __m128 time = _mm_set1_ps(r.time());
+        const __m128 a = _mm_set1_ps(d.length_squared());
+        const __m128 t_min = _mm_set1_ps(ray_t.min * d.length_squared());
+        const __m128i last = _mm_set1_epi32(static_cast<int32_t>(end));
+        const __m128i lane = _mm_set_epi32(3, 2, 1, 0);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 best_t = _mm_set1_ps(ray_t.max * d.length_squared());
+        __m128i best_index = _mm_set1_epi32(-1);
+
+        auto select = [](__m128 mask, __m128 a, __m128 b) {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        };
+
+        for (size_t i = begin; i < end; i += 4) {
+            __m128i idx = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(i)), lane);
+            __m128 ocx = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&cx[i]), _mm_mul_ps(time, _mm_loadu_ps(&mx[i]))), ox);
+            __m128 ocy = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&cy[i]), _mm_mul_ps(time, _mm_loadu_ps(&my[i]))), oy);
+            __m128 ocz = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&cz[i]), _mm_mul_ps(time, _mm_loadu_ps(&mz[i]))), oz);
+            __m128 rad = _mm_loadu_ps(&radius[i]);
+
+            __m128 h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+                _mm_mul_ps(rad, rad));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(h, h), _mm_mul_ps(a, c));
+            __m128 valid = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_castsi128_ps(_mm_cmplt_epi32(idx, last)));
+
+            __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+            __m128 near_t = _mm_sub_ps(h, sqrtd);
+            __m128 far_t = _mm_add_ps(h, sqrtd);
+            __m128 near_ok = _mm_and_ps(_mm_cmpgt_ps(near_t, t_min), _mm_cmplt_ps(near_t, best_t));
+            __m128 far_ok = _mm_and_ps(_mm_cmpgt_ps(far_t, t_min), _mm_cmplt_ps(far_t, best_t));
+
+            __m128 t = select(near_ok, near_t, far_t);
+            __m128 take = _mm_and_ps(valid, _mm_or_ps(near_ok, far_ok));
+            best_t = select(take, t, best_t);
+            best_index = _mm_castps_si128(select(take, _mm_castsi128_ps(idx), _mm_castsi128_ps(best_index)));
+        }
+
+        alignas(16) float lane_t[4];
+        alignas(16) int32_t lane_index[4];
+        _mm_store_ps(lane_t, best_t);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lane_index), best_index);
+        return reduce_lanes(lane_t, lane_index, 4, d.length_squared(), t_hit, index);
+    }
+
+    ORACLE_TARGET_AVX2
+    bool closest_avx2(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m256 ox = _mm256_set1_ps(o.x()), oy = _mm256_set1_ps(o.y()), oz = _mm256_set1_ps(o.z());
+        const __m256 dx = _mm256_set1_ps(d.x()), dy = _mm256_set1_ps(d.y()), dz = _mm256_set1_ps(d.z());
+        const __m256 time = _mm256_set1_ps(r.time());
+        const __m256 a = _mm256_set1_ps(d.length_squared());
+        const __m256 t_min = _mm256_set1_ps(ray_t.min * d.length_squared());
+        const __m256i last = _mm256_set1_epi32(static_cast<int32_t>(end));
+        const __m256i lane = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 best_t = _mm256_set1_ps(ray_t.max * d.length_squared());
+        __m256i best_index = _mm256_set1_epi32(-1);
+
+        for (size_t i = begin; i < end; i += 8) {
+            __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(i)), lane);
+            __m256 ocx = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&cx[i]), _mm256_mul_ps(time, _mm256_loadu_ps(&mx[i]))), ox);
+            __m256 ocy = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&cy[i]), _mm256_mul_ps(time, _mm256_loadu_ps(&my[i]))), oy);
+            __m256 ocz = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&cz[i]), _mm256_mul_ps(time, _mm256_loadu_ps(&mz[i]))), oz);
+            __m256 rad = _mm256_loadu_ps(&radius[i]);
+
+            __m256 h = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+            __m256 c = _mm256_sub_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)),
+                _mm256_mul_ps(rad, rad));
+            __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(a, c));
+            __m256 valid = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ),
+                _mm256_castsi256_ps(_mm256_cmpgt_epi32(last, idx)));
+
+            __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+            __m256 near_t = _mm256_sub_ps(h, sqrtd);
+            __m256 far_t = _mm256_add_ps(h, sqrtd);
+            __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(near_t, t_min, _CMP_GT_OQ), _mm256_cmp_ps(near_t, best_t, _CMP_LT_OQ));
+            __m256 far_ok = _mm256_and_ps(_mm256_cmp_ps(far_t, t_min, _CMP_GT_OQ), _mm256_cmp_ps(far_t, best_t, _CMP_LT_OQ));
+
+            __m256 t = _mm256_blendv_ps(far_t, near_t, near_ok);
+            __m256 take = _mm256_and_ps(valid, _mm256_or_ps(near_ok, far_ok));
+            best_t = _mm256_blendv_ps(best_t, t, take);
+            best_index = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_index), _mm256_castsi256_ps(idx), take));
+        }
+
+        alignas(32) float lane_t[8];
+        alignas(32) int32_t lane_index[8];
+        _mm256_store_ps(lane_t, best_t);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), best_index);
+        return reduce_lanes(lane_t, lane_index, 8, d.length_squared(), t_hit, index);
+    }
+
+ORACLE_AVX512_WARNINGS_BEGIN
+    ORACLE_TARGET_AVX512
+    bool closest_avx512(const ray& r, interval ray_t, size_t begin, size_t end, real& t_hit, size_t& index) const {
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+        const __m512 ox = _mm512_set1_ps(o.x()), oy = _mm512_set1_ps(o.y()), oz = _mm512_set1_ps(o.z());
+        const __m512 dx = _mm512_set1_ps(d.x()), dy = _mm512_set1_ps(d.y()), dz = _mm512_set1_ps(d.z());
+        const __m512 time = _mm512_set1_ps(r.time());
+        const __m512 a = _mm512_set1_ps(d.length_squared());
+        const __m512 t_min = _mm512_set1_ps(ray_t.min * d.length_squared());
+        const __m512i last = _mm512_set1_epi32(static_cast<int32_t>(end));
+        const __m512i lane = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        const __m512 zero = _mm512_setzero_ps();
+
+        __m512 best_t = _mm512_set1_ps(ray_t.max * d.length_squared());
+        __m512i best_index = _mm512_set1_epi32(-1);
+
+        for (size_t i = begin; i < end; i += 16) {
+            __m512i idx = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(i)), lane);
+            __m512 ocx = _mm512_sub_ps(_mm512_add_ps(_mm512_loadu_ps(&cx[i]), _mm512_mul_ps(time, _mm512_loadu_ps(&mx[i]))), ox);
+            __m512 ocy = _mm512_sub_ps(_mm512_add_ps(_mm512_loadu_ps(&cy[i]), _mm512_mul_ps(time, _mm512_loadu_ps(&my[i]))), oy);
+            __m512 ocz = _mm512_sub_ps(_mm512_add_ps(_mm512_loadu_ps(&cz[i]), _mm512_mul_ps(time, _mm512_loadu_ps(&mz[i]))), oz);
+            __m512 rad = _mm512_loadu_ps(&radius[i]);
+
+            __m512 h = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ocx, dx), _mm512_mul_ps(ocy, dy)), _mm512_mul_ps(ocz, dz));
+            __m512 c = _mm512_sub_ps(
+                _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ocx, ocx), _mm512_mul_ps(ocy, ocy)), _mm512_mul_ps(ocz, ocz)),
+                _mm512_mul_ps(rad, rad));
+            __m512 discriminant = _mm512_sub_ps(_mm512_mul_ps(h, h), _mm512_mul_ps(a, c));
+            __mmask16 valid = _mm512_cmp_ps_mask(discriminant, zero, _CMP_GE_OQ) & _mm512_cmplt_epi32_mask(idx, last);
+
+            __m512 sqrtd = _mm512_sqrt_ps(_mm512_max_ps(discriminant, zero));
+            __m512 near_t = _mm512_sub_ps(h, sqrtd);
+            __m512 far_t = _mm512_add_ps(h, sqrtd);
+            __mmask16 near_ok = _mm512_cmp_ps_mask(near_t, t_min, _CMP_GT_OQ) & _mm512_cmp_ps_mask(near_t, best_t, _CMP_LT_OQ);
+            __mmask16 far_ok = _mm512_cmp_ps_mask(far_t, t_min, _CMP_GT_OQ) & _mm512_cmp_ps_mask(far_t, best_t, _CMP_LT_OQ);
+
+            __m512 t = _mm512_mask_blend_ps(near_ok, far_t, near_t);
+            __mmask16 take = valid & (near_ok | far_ok);
+            best_t = _mm512_mask_blend_ps(take, best_t, t);
+            best_index = _mm512_mask_blend_epi32(take, best_index, idx);
+        }
+
+        alignas(64) float lane_t[16];
+        alignas(64) int32_t lane_index[16];
+        _mm512_store_ps(lane_t, best_t);
+        _mm512_store_si512(lane_index, best_index);
+        return reduce_lanes(lane_t, lane_index, 16, d.length_squared(), t_hit, index);
+    }
+ORACLE_AVX512_WARNINGS_END
+#endif
+};
+
+#endif
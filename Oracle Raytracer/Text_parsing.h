@@ -0,0 +1,98 @@
+#ifndef TEXT_PARSING_H
+#define TEXT_PARSING_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Number parsing shared by the text file formats (scene files, OBJ meshes). Every routine works on
+// a [begin, end) range of a mapped file, so nothing is copied or null-terminated on the fast path.
+
+namespace text_parsing {
+
+// Locale-independent and inlinable, unlike isdigit() and isspace().
+inline bool is_digit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'; }
+
+// Parses the number in [p, end). Plain decimals with at most 2^53 as their digits and a power of
+// ten up to 22 are converted exactly with one multiplication or division (both operands are
+// exact doubles, so the result is correctly rounded); anything else goes through strtod.
+inline bool parse_double(const char* p, const char* end, double& value) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool exact = true;
+    for (; p < end && is_digit(*p); p++, digits++) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+        else exact = false;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++, digits++) {
+            if (mantissa < 100000000000000000ull) { mantissa = mantissa * 10 + (*p - '0'); exponent--; }
+            else exact = false;
+        }
+    }
+    if (digits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative_exponent = *q++ == '-';
+        int e = 0;
+        const char* first_digit = q;
+        for (; q < end && is_digit(*q); q++)
+            e = e < 10000 ? e * 10 + (*q - '0') : e;
+        if (q > first_digit) {
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+
+    if (digits > 0 && p == end && exact && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double m = static_cast<double>(mantissa);
+        value = exponent < 0 ? m / powers[-exponent] : m * powers[exponent];
+        if (negative)
+            value = -value;
+        return true;
+    }
+
+    // Long mantissas, large exponents, inf and nan.
+    char buffer[64];
+    size_t n = static_cast<size_t>(end - start);
+    if (n == 0 || n >= sizeof(buffer))
+        return false;
+    std::memcpy(buffer, start, n);
+    buffer[n] = '\0';
+    char* parsed_end = nullptr;
+    value = std::strtod(buffer, &parsed_end);
+    return parsed_end == buffer + n;
+}
+
+// Parses the decimal integer in [p, end), with an optional sign.
+inline bool parse_int(const char* p, const char* end, int64_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end)
+        return false;
+    int64_t v = 0;
+    for (; p < end; p++) {
+        if (!is_digit(*p) || v > (INT64_MAX - 9) / 10)
+            return false;
+        v = v * 10 + (*p - '0');
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+}  // namespace text_parsing
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque of tasks. A worker pops its own newest task first (LIFO, so it stays
+// on warm data), and when its deque runs dry it steals the oldest task of another worker (FIFO,
+// so thieves take the biggest remaining chunks of work).
+
+class thread_pool {
+public:
+    // thread_count <= 0 uses every hardware thread.
+    explicit thread_pool(int thread_count = 0) {
+        if (thread_count <= 0)
+            thread_count = static_cast<int>(std::thread::hardware_concurrency());
+        if (thread_count <= 0)
+            thread_count = 1;
+
+        for (int i = 0; i < thread_count; i++)
+            queues.push_back(std::make_unique<task_queue>());
+        for (int i = 0; i < thread_count; i++)
+            workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void submit(std::function<void()> task) {
+        // Tasks spawned from a worker go to its own deque; outside submissions are spread round-robin.
+        size_t index = (current_pool == this && current_worker >= 0)
+            ? static_cast<size_t>(current_worker)
+            : next_queue++ % queues.size();
+
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+            queued++;
+        }
+        // A worker that found nothing to do holds wake_mutex from checking `queued` until it
+        // sleeps; passing through the mutex here means it either sees the task or gets the notify.
+        { std::lock_guard<std::mutex> lock(wake_mutex); }
+        wake.notify_one();
+    }
+
+    // Runs one queued task on the calling thread, if there is one.
+    bool run_pending_task() {
+        std::function<void()> task;
+        if (!take_task(current_pool == this ? current_worker : -1, task))
+            return false;
+        task();
+        pending--;
+        return true;
+    }
+
+    // Blocks until every submitted task has finished. The calling thread helps out meanwhile.
+    void wait_idle() {
+        while (pending.load() > 0) {
+            if (!run_pending_task())
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending{ 0 };   // Submitted and not yet finished
+    std::atomic<size_t> queued{ 0 };    // Waiting in a deque; changed only under that deque's mutex
+    std::atomic<size_t> next_queue{ 0 };
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static thread_local thread_pool* current_pool;
+    static thread_local int current_worker;
+
+    bool take_task(int self, std::function<void()>& task) {
+        if (self >= 0) {
+            auto& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+
+        // Steal, starting from the neighbour so thieves don't all hammer queue 0.
+        size_t count = queues.size();
+        size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+        for (size_t k = 0; k < count; k++) {
+            auto& victim = *queues[(start + k) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(int index) {
+        current_pool = this;
+        current_worker = index;
+
+        while (true) {
+            if (run_pending_task())
+                continue;
+
+            // Idle workers sleep until there is work or the pool stops, without polling.
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+
+// Fork-join helper on top of a thread_pool: run() spawns tasks, wait() blocks until they are all
+// done while executing queued work itself, so tasks may safely wait on tasks they spawned.
+// A task that throws doesn't stop the others; once all have finished, wait() rethrows the first
+// exception. (Tasks submitted to the pool directly must not throw.)
+class task_group {
+public:
+    explicit task_group(thread_pool& pool) : pool(pool) {}
+
+    ~task_group() { drain(); }
+
+    void run(std::function<void()> task) {
+        outstanding++;
+        pool.submit([this, task = std::move(task)] {
+            try {
+                task();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+            outstanding--;
+        });
+    }
+
+    void wait() {
+        drain();
+        std::exception_ptr first;
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            std::swap(first, error);
+        }
+        if (first)
+            std::rethrow_exception(first);
+    }
+
+private:
+    thread_pool& pool;
+    std::atomic<int> outstanding{ 0 };
+    std::mutex error_mutex;
+    std::exception_ptr error;   // First exception a task threw
+
+    void drain() {
+        while (outstanding.load() > 0) {
+            if (!pool.run_pending_task())
+                std::this_thread::yield();
+        }
+    }
+};
+
+thread_local thread_pool* thread_pool::current_pool = nullptr;
+thread_local int thread_pool::current_worker = -1;
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "AABB.h"
+#include "Utilities.h"
+#include "Vector.h"
+
+#include <cmath>
+
+// Affine transforms: a 3x3 linear part and a translation, stored as the top three rows of a 4x4
+// matrix. Composition reads like function application: (a * b) applies b first, then a.
+
+class transform {
+public:
+    transform() {
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 4; col++)
+                m[row][col] = row == col ? 1 : 0;
+        }
+    }
+
+    static transform translate(const vec3& offset) {
+        transform t;
+        for (int row = 0; row < 3; row++)
+            t.m[row][3] = offset[row];
+        return t;
+    }
+
+    static transform scale(const vec3& factors) {
+        transform t;
+        for (int row = 0; row < 3; row++)
+            t.m[row][row] = factors[row];
+        return t;
+    }
+
+    static transform scale(real factor) { return scale(vec3(factor, factor, factor)); }
+
+    // Counterclockwise rotation about `axis` when looking down the axis toward the origin.
+    static transform rotate(const vec3& axis, double degrees) {
+        vec3 a = unit_vector(axis);
+        double theta = degrees_to_radians(degrees);
+        double c = std::cos(theta), s = std::sin(theta), k = 1 - c;
+        double x = a.x(), y = a.y(), z = a.z();
+        transform t;
+        t.m[0][0] = real(c + x * x * k);     t.m[0][1] = real(x * y * k - z * s); t.m[0][2] = real(x * z * k + y * s);
+        t.m[1][0] = real(y * x * k + z * s); t.m[1][1] = real(c + y * y * k);     t.m[1][2] = real(y * z * k - x * s);
+        t.m[2][0] = real(z * x * k - y * s); t.m[2][1] = real(z * y * k + x * s); t.m[2][2] = real(c + z * z * k);
+        return t;
+    }
+
+    transform operator*(const transform& b) const {
+        transform t;
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 4; col++) {
+                real v = col == 3 ? m[row][3] : 0;
+                for (int k = 0; k < 3; k++)
+                    v += m[row][k] * b.m[k][col];
+                t.m[row][col] = v;
+            }
+        }
+        return t;
+    }
+
+    // The inverse, by the adjugate of the linear part. Singular transforms (a zero scale) have none;
+    // their inverse comes out infinite or NaN.
+    transform inverse() const {
+        double a[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++)
+                a[row][col] = m[row][col];
+        }
+        double adj[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                int r0 = (col + 1) % 3, r1 = (col + 2) % 3, c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+                adj[row][col] = a[r0][c0] * a[r1][c1] - a[r0][c1] * a[r1][c0];
+            }
+        }
+        double det = a[0][0] * adj[0][0] + a[0][1] * adj[1][0] + a[0][2] * adj[2][0];
+
+        transform t;
+        for (int row = 0; row < 3; row++) {
+            double offset = 0;
+            for (int col = 0; col < 3; col++) {
+                double v = adj[row][col] / det;
+                t.m[row][col] = real(v);
+                offset -= v * m[col][3];
+            }
+            t.m[row][3] = real(offset);
+        }
+        return t;
+    }
+
+    point3 point(const point3& p) const {
+        return point3(
+            m[0][0] * p.x() + m[0][1] * p.y() + m[0][2] * p.z() + m[0][3],
+            m[1][0] * p.x() + m[1][1] * p.y() + m[1][2] * p.z() + m[1][3],
+            m[2][0] * p.x() + m[2][1] * p.y() + m[2][2] * p.z() + m[2][3]);
+    }
+
+    vec3 vector(const vec3& v) const {
+        return vec3(
+            m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z(),
+            m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z(),
+            m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z());
+    }
+
+    // Multiplies by the transpose of the linear part. Normals transform by the inverse transpose,
+    // so the inverse of a transform maps normals the other way with this.
+    vec3 transpose_vector(const vec3& v) const {
+        return vec3(
+            m[0][0] * v.x() + m[1][0] * v.y() + m[2][0] * v.z(),
+            m[0][1] * v.x() + m[1][1] * v.y() + m[2][1] * v.z(),
+            m[0][2] * v.x() + m[1][2] * v.y() + m[2][2] * v.z());
+    }
+
+    // The box around the transformed box (Arvo, Graphics Gems 1990): each output axis takes the
+    // smaller and the larger product of every input axis.
+    aabb box(const aabb& b) const {
+        interval out[3];
+        for (int row = 0; row < 3; row++) {
+            real lo = m[row][3], hi = m[row][3];
+            for (int col = 0; col < 3; col++) {
+                const interval& extent = b.axis_interval(col);
+                real e0 = m[row][col] * extent.min, e1 = m[row][col] * extent.max;
+                lo += std::fmin(e0, e1);
+                hi += std::fmax(e0, e1);
+            }
+            out[row] = interval(lo, hi);
+        }
+        return aabb(out[0], out[1], out[2]);
+    }
+
+private:
+    real m[3][4];
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "AABB.h"
+#include "Hittable.h"
+#include "Render_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Indexed triangle storage.
+// Triangles are triples of 32-bit indices into a vertex buffer plus a material id each, so a
+// closed mesh costs about 16 bytes per triangle on top of its vertices (roughly half a vertex per
+// triangle). The vertex buffer is reference-counted: acceleration structures that mirror the
+// triangles in their own order share it instead of copying it. Vertices are only ever appended,
+// so indices into a shared buffer stay valid.
+//
+// Intersection is the watertight test of Woop, Benthin and Wald (JCGT 2013): the ray is sheared so
+// it runs along +z, and the edge functions of the projected triangle decide the hit. Rays through
+// an edge or a vertex shared by two triangles hit at least one of them, so there are no cracks
+// in closed meshes.
+
+struct mesh_vertices {
+    std::vector<point3> positions;
+    std::vector<vec3> normals;   // Empty, or one unit shading normal per position
+};
+
+// Per-ray setup of the watertight test, shared by every triangle the ray is tested against.
+struct triangle_ray {
+    int kx, ky, kz;      // Axis permutation: kz is the largest component of the direction
+    real sx, sy, sz;     // Shear that maps the direction to +z
+
+    triangle_ray() = default;
+
+    explicit triangle_ray(const ray& r) {
+        const vec3& d = r.direction();
+        vec3 a(std::abs(d.x()), std::abs(d.y()), std::abs(d.z()));
+        kz = a.x() > a.y() ? (a.x() > a.z() ? 0 : 2) : (a.y() > a.z() ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        // Keep the winding of the projected triangle.
+        if (d[kz] < 0)
+            std::swap(kx, ky);
+        sz = 1 / d[kz];
+        sx = d[kx] * sz;
+        sy = d[ky] * sz;
+    }
+};
+
+class triangle_mesh {
+public:
+    triangle_mesh() : vertices(std::make_shared<mesh_vertices>()) {}
+
+    size_t size() const { return material_id.size(); }
+    size_t vertex_count() const { return vertices->positions.size(); }
+    bool has_normals() const { return !vertices->normals.empty(); }
+
+    void reserve(size_t vertex_count, size_t triangle_count, bool with_normals = false) {
+        vertices->positions.reserve(vertex_count);
+        if (with_normals || has_normals())
+            vertices->normals.reserve(vertex_count);
+        indices.reserve(3 * triangle_count);
+        material_id.reserve(triangle_count);
+    }
+
+    uint32_t add_vertex(const point3& p) {
+        if (has_normals())
+            vertices->normals.emplace_back(0, 0, 0);
+        vertices->positions.push_back(p);
+        return static_cast<uint32_t>(vertices->positions.size() - 1);
+    }
+
+    // Adds a vertex with a shading normal. A buffer either has a normal for every vertex or none;
+    // vertices added earlier without one get the zero vector, which falls back to flat shading.
+    uint32_t add_vertex(const point3& p, const vec3& n) {
+        vertices->normals.resize(vertices->positions.size());
+        vertices->normals.push_back(n);
+        vertices->positions.push_back(p);
+        return static_cast<uint32_t>(vertices->positions.size() - 1);
+    }
+
+    void add_triangle(uint32_t a, uint32_t b, uint32_t c, uint32_t material) {
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+        material_id.push_back(material);
+    }
+
+    // Makes this an empty triangle list over the vertex buffer of `other`.
+    void share_vertices(const triangle_mesh& other) {
+        vertices = other.vertices;
+        indices.clear();
+        material_id.clear();
+    }
+
+    // Appends triangle `i` of `other`, which must share this mesh's vertex buffer.
+    void add(const triangle_mesh& other, size_t i) {
+        add_triangle(other.indices[3 * i], other.indices[3 * i + 1], other.indices[3 * i + 2], other.material_id[i]);
+    }
+
+    // Overwrites triangle `i` with triangle `j` of `other`, which must share this mesh's vertex buffer.
+    void set(size_t i, const triangle_mesh& other, size_t j) {
+        for (int corner = 0; corner < 3; corner++)
+            indices[3 * i + corner] = other.indices[3 * j + corner];
+        material_id[i] = other.material_id[j];
+    }
+
+    bool shares_vertices(const triangle_mesh& other) const { return vertices == other.vertices; }
+
+    void clear() {
+        // Meshes that share the old buffer keep it.
+        vertices = std::make_shared<mesh_vertices>();
+        indices.clear();
+        material_id.clear();
+    }
+
+    const point3& vertex(size_t i, int corner) const { return vertices->positions[indices[3 * i + corner]]; }
+    uint32_t vertex_index(size_t i, int corner) const { return indices[3 * i + corner]; }
+    uint32_t get_material(size_t i) const { return material_id[i]; }
+    const mesh_vertices& vertex_buffer() const { return *vertices; }
+
+    // Heap bytes of the index and material arrays, and of the (possibly shared) vertex buffer.
+    size_t triangle_bytes() const {
+        return indices.capacity() * sizeof(uint32_t) + material_id.capacity() * sizeof(uint32_t);
+    }
+    size_t vertex_bytes() const {
+        return vertices->positions.capacity() * sizeof(point3) + vertices->normals.capacity() * sizeof(vec3);
+    }
+
+    // The box is grown on every axis by far more than the rounding error of a slab test. A ray
+    // through a shared vertex or edge only touches the exact boxes of the triangles around it and
+    // could miss all of them in the BVH before the watertight test ever runs; this also gives
+    // axis-aligned triangles a box of nonzero width.
+    aabb bounding_box(size_t i) const {
+        const point3& a = vertex(i, 0);
+        const point3& b = vertex(i, 1);
+        const point3& c = vertex(i, 2);
+        aabb box(aabb(a, b), aabb(c, c));
+        real magnitude = 1;
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& extent = box.axis_interval(axis);
+            magnitude = std::max(magnitude, std::max(std::abs(extent.min), std::abs(extent.max)));
+        }
+        real margin = magnitude * 1024 * std::numeric_limits<real>::epsilon();
+        return aabb(box.x.expand(margin), box.y.expand(margin), box.z.expand(margin));
+    }
+
+    bool hit_one(size_t i, const ray& r, interval ray_t, hit_record& rec) const {
+        return hit(i, r, triangle_ray(r), ray_t, rec);
+    }
+
+    // Intersects triangle `i`; on a hit within ray_t fills `rec`.
+    bool hit(size_t i, const ray& r, const triangle_ray& s, interval ray_t, hit_record& rec) const {
+        ORACLE_STAT(render_counters::local().triangle_tests++);
+        const point3& o = r.origin();
+        const point3& p0 = vertex(i, 0);
+        const point3& p1 = vertex(i, 1);
+        const point3& p2 = vertex(i, 2);
+        vec3 a = p0 - o, b = p1 - o, c = p2 - o;
+
+        real ax = a[s.kx] - s.sx * a[s.kz], ay = a[s.ky] - s.sy * a[s.kz];
+        real bx = b[s.kx] - s.sx * b[s.kz], by = b[s.ky] - s.sy * b[s.kz];
+        real cx = c[s.kx] - s.sx * c[s.kz], cy = c[s.ky] - s.sy * c[s.kz];
+
+        real u = cx * by - cy * bx;
+        real v = ax * cy - ay * cx;
+        real w = bx * ay - by * ax;
+
+        // An edge function of exactly zero is where single precision would leave a crack between
+        // neighbours; redo all three in double, as the paper does.
+        if (std::is_same<real, float>::value && (u == 0 || v == 0 || w == 0)) {
+            u = static_cast<real>(double(cx) * double(by) - double(cy) * double(bx));
+            v = static_cast<real>(double(ax) * double(cy) - double(ay) * double(cx));
+            w = static_cast<real>(double(bx) * double(ay) - double(by) * double(ax));
+        }
+
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+            return false;
+        real det = u + v + w;
+        if (det == 0)
+            return false;
+
+        real t_scaled = u * (s.sz * a[s.kz]) + v * (s.sz * b[s.kz]) + w * (s.sz * c[s.kz]);
+        real t = t_scaled / det;
+        if (!ray_t.surrounds(t))
+            return false;
+
+        rec.t = t;
+        rec.p = r.at(t);
+        vec3 geometric = cross(p1 - p0, p2 - p0);
+        rec.front_face = dot(r.direction(), geometric) < 0;
+        vec3 shading = geometric;
+        if (has_normals()) {
+            const auto& normals = vertices->normals;
+            vec3 n = u * normals[indices[3 * i]] + v * normals[indices[3 * i + 1]] + w * normals[indices[3 * i + 2]];
+            // det only scales n, and its sign is that of every nonzero edge function.
+            if (n.length_squared() > 0)
+                shading = det > 0 ? n : -n;
+        }
+        shading = unit_vector(shading);
+        rec.normal = rec.front_face ? shading : -shading;
+        rec.material_id = material_id[i];
+        ORACLE_STAT(render_counters::local().triangle_hits++);
+        return true;
+    }
+
+private:
+    std::shared_ptr<mesh_vertices> vertices;
+    std::vector<uint32_t> indices;       // Three per triangle
+    std::vector<uint32_t> material_id;   // One per triangle
+};
+
+#endif
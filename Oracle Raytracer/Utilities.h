@@ -4,6 +4,7 @@
 #include <limits>
 #include <memory>
 #include <cstdlib>
+#include "Random.h"
 
 // Usings
 
@@ -13,8 +14,8 @@ using std::make_shared;
 // Utility Functions
 
 double random_double() {
-    // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    // Returns a random real in [0,1) from the calling thread's generator (see Random.h).
+    return thread_rng().next_double();
 }
 
 double random_double(double min, double max) {
@@ -39,7 +40,7 @@ inline double degrees_to_radians(double degrees) {
 
 // Headers 
 
-#include "ray.h"
-#include "interval.h"
+#include "Ray.h"
+#include "Interval.h"
 
 #endif
\ No newline at end of file
@@ -5,116 +5,155 @@
 #include <iostream>
 #include <cstdlib>
 #include "Interval.h"
+#include "Precision.h"
 #include "Utilities.h"
 
 using std::sqrt;
 
 
 
-class vec3 {
+// Three-component vector over scalar type T (see Precision.h). Operators that take a scalar take
+// it as T through the `scalar` typedef, which keeps it out of template argument deduction, so
+// double literals work with float vectors too.
+template <typename T>
+class vec3_t {
 public:
-    vec3() : e{ 0,0,0 } {}
-    vec3(double e0, double e1, double e2) : e{ e0, e1, e2 } {}
+    using scalar = T;
 
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    vec3_t() : e{ 0,0,0 } {}
+    vec3_t(T e0, T e1, T e2) : e{ e0, e1, e2 } {}
 
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-    double operator[](int i) const { return e[i]; }
-    double& operator[](int i) { return e[i]; }
+    // Converts between precisions.
+    template <typename U>
+    explicit vec3_t(const vec3_t<U>& v) : e{ T(v.e[0]), T(v.e[1]), T(v.e[2]) } {}
 
-    vec3& operator+=(const vec3& v) {
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
+
+    vec3_t operator-() const { return vec3_t(-e[0], -e[1], -e[2]); }
+    T operator[](int i) const { return e[i]; }
+    T& operator[](int i) { return e[i]; }
+
+    vec3_t& operator+=(const vec3_t& v) {
         e[0] += v.e[0];
         e[1] += v.e[1];
         e[2] += v.e[2];
         return *this;
     }
 
-    vec3& operator*=(const double t) {
+    vec3_t& operator*=(const T t) {
         e[0] *= t;
         e[1] *= t;
         e[2] *= t;
         return *this;
     }
 
-    vec3& operator/=(const double t) {
+    vec3_t& operator/=(const T t) {
         return *this *= 1 / t;
     }
 
-    double length() const {
-        return sqrt(length_squared());
+    T length() const {
+        return std::sqrt(length_squared());
     }
 
-    double length_squared() const {
+    T length_squared() const {
         return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
     }
 
-    static vec3 random() {
-        return vec3(random_double(), random_double(), random_double());
+    static vec3_t random() {
+        return vec3_t(T(random_double()), T(random_double()), T(random_double()));
     }
 
-    static vec3 random(double min, double max) {
-        return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    static vec3_t random(double min, double max) {
+        return vec3_t(T(random_double(min, max)), T(random_double(min, max)), T(random_double(min, max)));
     }
 
     bool near_zero() const {
         // Return true if the vector is close to zero in all dimensions.
-        auto s = 1e-8;
-        return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
+        const T s = precision<T>::near_zero;
+        return (std::abs(e[0]) < s) && (std::abs(e[1]) < s) && (std::abs(e[2]) < s);
     }
 
 public:
-    double e[3];
+    T e[3];
 };
 
 
 
 
-std::ostream& operator<<(std::ostream& out, const vec3& v) {
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const vec3_t<T>& v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline vec3_t<T> operator+(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
 
-vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T>
+inline vec3_t<T> operator-(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
 }
 
-vec3 operator*(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-vec3 operator*(double t, const vec3& v) {
-    return vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(typename vec3_t<T>::scalar t, const vec3_t<T>& v) {
+    return vec3_t<T>(t * v.e[0], t * v.e[1], t * v.e[2]);
 }
 
-vec3 operator*(const vec3& v, double t) {
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& v, typename vec3_t<T>::scalar t) {
     return t * v;
 }
 
-vec3 operator/(vec3 v, double t) {
+template <typename T>
+inline vec3_t<T> operator/(vec3_t<T> v, typename vec3_t<T>::scalar t) {
     return (1 / t) * v;
 }
 
-double dot(const vec3& u, const vec3& v) {
+template <typename T>
+inline T dot(const vec3_t<T>& u, const vec3_t<T>& v) {
     return u.e[0] * v.e[0]
         + u.e[1] * v.e[1]
         + u.e[2] * v.e[2];
 }
 
-vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+template <typename T>
+inline vec3_t<T> cross(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
         u.e[2] * v.e[0] - u.e[0] * v.e[2],
         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-vec3 unit_vector(vec3 v) {
+template <typename T>
+inline vec3_t<T> unit_vector(vec3_t<T> v) {
     return v / v.length();
 }
 
+template <typename T>
+inline vec3_t<T> reflect(const vec3_t<T>& v, const vec3_t<T>& n) {
+    return v - 2 * dot(v, n) * n;
+}
+
+template <typename T>
+inline vec3_t<T> refract(const vec3_t<T>& uv, const vec3_t<T>& n, typename vec3_t<T>::scalar etai_over_etat) {
+    auto cos_theta = std::fmin(dot(-uv, n), T(1));
+    vec3_t<T> r_out_perp = etai_over_etat * (uv + cos_theta * n);
+    vec3_t<T> r_out_parallel = -std::sqrt((1 - r_out_perp.length_squared())) * n;
+    return r_out_perp + r_out_parallel;
+}
+
+// Type aliases for vec3
+using vec3 = vec3_t<real>;
+using point3 = vec3;   // 3D point
+using color = vec3;    // RGB color
+
 vec3 random_in_unit_sphere() {
     while (true) {
         auto p = vec3::random(-1, 1);
@@ -135,17 +174,6 @@ vec3 random_on_hemisphere(const vec3& normal) {
         return -on_unit_sphere;
 }
 
-vec3 reflect(const vec3& v, const vec3& n) {
-    return v - 2 * dot(v, n) * n;
-}
-
-inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
-    auto cos_theta = fmin(dot(-uv, n), 1.0);
-    vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
-    vec3 r_out_parallel = -sqrt((1.0 - r_out_perp.length_squared())) * n;
-    return r_out_perp + r_out_parallel;
-}
-
 inline vec3 random_in_unit_disk() {
     while (true) {
         auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
@@ -154,8 +182,4 @@ inline vec3 random_in_unit_disk() {
     }
 }
 
-// Type aliases for vec3
-using point3 = vec3;   // 3D point
-using color = vec3;    // RGB color
-
 #endif
\ No newline at end of file